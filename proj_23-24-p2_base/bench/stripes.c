@@ -0,0 +1,111 @@
+// Reservations per second by stripe count: threads reserve 8 seats at a time on one 64x4096 event, each thread in
+// rows of its own, with the state access delay at 0 and no store or log
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "server/operations.h"
+
+#define ROWS 64
+#define COLS 4096
+#define SEATS 8
+#define MAX_THREADS 32
+
+struct Worker {
+  pthread_t id;
+  size_t first_row;
+  size_t num_rows;
+  size_t reserved;
+};
+
+static uint64_t now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Fills the worker's rows, a group of adjacent seats at a time
+static void* reserve(void* arg) {
+  struct Worker* worker = arg;
+  for (size_t row = worker->first_row; row < worker->first_row + worker->num_rows; row++) {
+    for (size_t col = 1; col + SEATS - 1 <= COLS; col += SEATS) {
+      size_t xs[SEATS], ys[SEATS];
+      for (size_t i = 0; i < SEATS; i++) {
+        xs[i] = row;
+        ys[i] = col + i;
+      }
+      worker->reserved += ems_reserve(1, SEATS, xs, ys) == 0;
+    }
+  }
+  return NULL;
+}
+
+// Reservations per second filling the event with the given number of threads, negative if one of them failed
+static double run(size_t n_stripes, int num_threads) {
+  struct EmsConfig config = {.delay_us = 0,
+                             .n_shards = DEFAULT_SHARD_COUNT,
+                             .n_stripes = n_stripes,
+                             .wal_flush_us = DEFAULT_WAL_FLUSH_US,
+                             .wal_batch_size = DEFAULT_WAL_BATCH_SIZE};
+  if (ems_init(&config) != 0 || ems_create(1, ROWS, COLS) != 0) return -1;
+
+  struct Worker workers[MAX_THREADS];
+  uint64_t start = now_ns();
+  for (int i = 0; i < num_threads; i++) {
+    size_t rows = ROWS / (size_t)num_threads;
+    workers[i] = (struct Worker){.first_row = 1 + (size_t)i * rows, .num_rows = rows, .reserved = 0};
+    if (pthread_create(&workers[i].id, NULL, reserve, &workers[i]) != 0) return -1;
+  }
+
+  size_t reserved = 0;
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(workers[i].id, NULL);
+    reserved += workers[i].reserved;
+  }
+  double seconds = (double)(now_ns() - start) / 1e9;
+  return reserved == ROWS * (COLS / SEATS) ? (double)reserved / seconds : -1;
+}
+
+// Runs the benchmark in a child process, since the state can only be initialized once per process
+static double run_in_child(size_t n_stripes, int num_threads) {
+  int result_pipe[2];
+  if (pipe(result_pipe) != 0) return -1;
+
+  pid_t pid = fork();
+  if (pid < 0) return -1;
+  if (pid == 0) {
+    double result = run(n_stripes, num_threads);
+    _exit(write(result_pipe[1], &result, sizeof(result)) == sizeof(result) ? 0 : 1);
+  }
+
+  close(result_pipe[1]);
+  double result;
+  if (read(result_pipe[0], &result, sizeof(result)) != sizeof(result)) result = -1;
+  close(result_pipe[0]);
+  waitpid(pid, NULL, 0);
+  return result;
+}
+
+int main(void) {
+  static const int threads[] = {1, 8, 32};
+  printf("stripes: thousands of reservations per second of %d seats on a %dx%d event, delay 0\n", SEATS, ROWS, COLS);
+  printf("%10s %10s %10s %10s\n", "stripes", "1 thread", "8", "32");
+
+  for (size_t n_stripes = 1; n_stripes <= ROWS; n_stripes *= 4) {
+    double results[3];
+    for (int i = 0; i < 3; i++) {
+      results[i] = run_in_child(n_stripes, threads[i]);
+      if (results[i] < 0) {
+        fprintf(stderr, "stripes: reservations failed with %zu stripes and %d threads\n", n_stripes, threads[i]);
+        return 1;
+      }
+    }
+    printf("%10zu %10.1f %10.1f %10.1f\n", n_stripes, results[0] / 1e3, results[1] / 1e3, results[2] / 1e3);
+  }
+  return 0;
+}
@@ -12,6 +12,7 @@
 #include "api.h"
 #include "parser.h"
 #include "common/constants.h"
+#include "common/io.h"
 
 int cur_session_id;
 int req_pipe;
@@ -182,6 +183,105 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
   return success;
 }
 
+// send hold request to the server (through the request pipe) and wait for the id of the hold
+int ems_hold(unsigned int event_id, unsigned int ttl_s, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id) {
+  char* request_message = malloc(HOLD_REQUEST_LEN);
+
+  if (request_message == NULL) {
+    return 1;
+  }
+
+  // creates the request message
+  memcpy(request_message, "OP_CODE=9", OP_CODE_LEN);
+  memcpy(request_message + OP_CODE_LEN, &event_id, EVENT_ID_LEN);
+  memcpy(request_message + OP_CODE_LEN + EVENT_ID_LEN, &ttl_s, HOLD_TTL_LEN);
+  memcpy(request_message + OP_CODE_LEN + EVENT_ID_LEN + HOLD_TTL_LEN, &num_seats, SEATS_LEN);
+  memcpy(request_message + OP_CODE_LEN + EVENT_ID_LEN + HOLD_TTL_LEN + SEATS_LEN, xs, num_seats * SEATS_LEN);
+  memcpy(request_message + OP_CODE_LEN + EVENT_ID_LEN + HOLD_TTL_LEN + SEATS_LEN + num_seats * SEATS_LEN, ys,
+         num_seats * SEATS_LEN);
+
+  // sends the request message
+  if (write(req_pipe, request_message, HOLD_REQUEST_LEN) < 0) {
+    free(request_message);
+    return 1;
+  }
+
+  free(request_message);
+  int success;
+  // reads the result of the operation and the hold id from the result pipe
+  if (read(resp_pipe, &success, sizeof(int)) <= 0 || read(resp_pipe, hold_id, HOLD_ID_LEN) <= 0) return 1;
+
+  return success;
+}
+
+// send confirm request to the server (through the request pipe) and wait for the response (through the response pipe)
+int ems_confirm(unsigned int event_id, unsigned int hold_id) {
+  char request_message[CONFIRM_REQUEST_LEN];
+
+  // creates the request message, the codes past 9 are hexadecimal
+  memcpy(request_message, "OP_CODE=A", OP_CODE_LEN);
+  memcpy(request_message + OP_CODE_LEN, &event_id, EVENT_ID_LEN);
+  memcpy(request_message + OP_CODE_LEN + EVENT_ID_LEN, &hold_id, HOLD_ID_LEN);
+
+  // sends the request message
+  if (write(req_pipe, request_message, CONFIRM_REQUEST_LEN) < 0) {
+    return 1;
+  }
+
+  int success;
+  // reads the result of the operation from the result pipe
+  if (read(resp_pipe, &success, sizeof(int)) <= 0) return 1;
+
+  return success;
+}
+
+// send cancel request to the server (through the request pipe) and wait for the response (through the response pipe)
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+  char request_message[CANCEL_REQUEST_LEN];
+
+  // creates the request message
+  memcpy(request_message, "OP_CODE=B", OP_CODE_LEN);
+  memcpy(request_message + OP_CODE_LEN, &event_id, EVENT_ID_LEN);
+  memcpy(request_message + OP_CODE_LEN + EVENT_ID_LEN, &reservation_id, RESERVATION_ID_LEN);
+
+  // sends the request message
+  if (write(req_pipe, request_message, CANCEL_REQUEST_LEN) < 0) {
+    return 1;
+  }
+
+  int success;
+  // reads the result of the operation from the result pipe
+  if (read(resp_pipe, &success, sizeof(int)) <= 0) return 1;
+
+  return success;
+}
+
+// send reserve best request to the server (through the request pipe) and wait for the seats it picked
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* row, size_t* col) {
+  char request_message[RESERVE_BEST_REQUEST_LEN];
+
+  // creates the request message
+  memcpy(request_message, "OP_CODE=7", OP_CODE_LEN);
+  memcpy(request_message + OP_CODE_LEN, &event_id, EVENT_ID_LEN);
+  memcpy(request_message + OP_CODE_LEN + EVENT_ID_LEN, &num_seats, SEATS_LEN);
+
+  // sends the request message
+  if (write(req_pipe, request_message, RESERVE_BEST_REQUEST_LEN) < 0) {
+    return 1;
+  }
+
+  int success;
+  // reads the result of the operation and the first seat of the run from the result pipe
+  if (read(resp_pipe, &success, sizeof(int)) <= 0 ||
+      read(resp_pipe, row, ROW_COL_LEN) <= 0 ||
+      read(resp_pipe, col, ROW_COL_LEN) <= 0) {
+    return 1;
+  }
+
+  return success;
+}
+
 // send show request to the server (through the request pipe) and wait for the response (through the response pipe)
 int ems_show(int out_fd, unsigned int event_id) {
   char *request_message;
@@ -232,22 +332,60 @@ int ems_show(int out_fd, unsigned int event_id) {
   }
 
   // Write the matrix to the specified output file descriptor
-  for (size_t i = 0; i < rows; i++) {
-    for (size_t j = 0; j < cols; j++) {
-      char buffer[16];
-      sprintf(buffer, "%u", matrix[i * cols + j]);
+  print_rows(out_fd, matrix, rows, cols);
+
+  // Clean up allocated memory
+  free(matrix);
+  return success;
+}
 
-      write(out_fd, buffer, strlen(buffer));
+// send available request to the server (through the request pipe) and print the counts it answers with
+int ems_available(int out_fd, unsigned int event_id) {
+  char request_message[AVAILABLE_REQUEST_LEN];
 
-      if (j < cols - 1) {
-        write(out_fd, " ", sizeof(char));
-      }
+  // creates the request message
+  memcpy(request_message, "OP_CODE=8", OP_CODE_LEN);
+  memcpy(request_message + OP_CODE_LEN, &event_id, EVENT_ID_LEN);
+
+  // sends the request message
+  if (write(req_pipe, request_message, AVAILABLE_REQUEST_LEN) < 0) {
+    return 1;
+  }
+
+  int success;
+  size_t rows, cols, free_seats;
+
+  // Read the response from the pipe, the seats themselves are never sent
+  if (read(resp_pipe, &success, sizeof(int)) <= 0 ||
+      read(resp_pipe, &rows, ROW_COL_LEN) <= 0 ||
+      read(resp_pipe, &cols, ROW_COL_LEN) <= 0 ||
+      read(resp_pipe, &free_seats, SEATS_LEN) <= 0) {
+    return 1;
+  }
+
+  // An event without rows sends no counters
+  size_t *row_free = NULL;
+  if (rows > 0 && (row_free = malloc(rows * SEATS_LEN)) == NULL) {
+    return 1;
+  }
+
+  if (rows > 0 && read(resp_pipe, row_free, rows * SEATS_LEN) <= 0) {
+    free(row_free);
+    return 1;
+  }
+
+  if (success == 0) {
+    char line[128];
+    sprintf(line, "Event: %u\nFree: %zu/%zu\nRows:", event_id, free_seats, rows * cols);
+    write(out_fd, line, strlen(line));
+    for (size_t i = 0; i < rows; i++) {
+      sprintf(line, " %zu", row_free[i]);
+      write(out_fd, line, strlen(line));
     }
     write(out_fd, "\n", sizeof(char));
   }
 
-  // Clean up allocated memory
-  free(matrix);
+  free(row_free);
   return success;
 }
 
@@ -284,6 +422,13 @@ int ems_list_events(int out_fd) {
     return 1;
   }
 
+  // An empty list is answered with no ids at all
+  if (n_events == 0) {
+    char buff[] = "No events\n";
+    write(out_fd, buff, sizeof(buff) - 1);
+    return success;
+  }
+
   unsigned int id_list[n_events];
 
   // Read the event IDs from the pipe
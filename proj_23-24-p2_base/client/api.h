@@ -7,6 +7,11 @@
 #define RESERVE_REQUEST_LEN OP_CODE_LEN + EVENT_ID_LEN + SEATS_LEN + 2 * num_seats * SEATS_LEN
 #define SHOW_REQUEST_LEN OP_CODE_LEN + EVENT_ID_LEN
 #define LIST_REQUEST_LEN OP_CODE_LEN
+#define RESERVE_BEST_REQUEST_LEN OP_CODE_LEN + EVENT_ID_LEN + SEATS_LEN
+#define AVAILABLE_REQUEST_LEN OP_CODE_LEN + EVENT_ID_LEN
+#define HOLD_REQUEST_LEN OP_CODE_LEN + EVENT_ID_LEN + HOLD_TTL_LEN + SEATS_LEN + 2 * num_seats * SEATS_LEN
+#define CONFIRM_REQUEST_LEN OP_CODE_LEN + EVENT_ID_LEN + HOLD_ID_LEN
+#define CANCEL_REQUEST_LEN OP_CODE_LEN + EVENT_ID_LEN + RESERVATION_ID_LEN
 
 
 
@@ -42,12 +47,49 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
 
+/// Holds seats in an event for a limited time, they are released unless the hold is confirmed before.
+/// @param event_id Id of the event to hold seats of.
+/// @param ttl_s Number of seconds the seats are held for.
+/// @param num_seats Number of seats to hold.
+/// @param xs Array of rows of the seats to hold.
+/// @param ys Array of columns of the seats to hold.
+/// @param hold_id Receives the id to confirm the hold with.
+/// @return 0 if the seats were held successfully, 1 otherwise.
+int ems_hold(unsigned int event_id, unsigned int ttl_s, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id);
+
+/// Turns a hold that has not expired into a reservation.
+/// @param event_id Id of the event the hold belongs to.
+/// @param hold_id Id given by ems_hold.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_confirm(unsigned int event_id, unsigned int hold_id);
+
+/// Cancels a reservation, freeing its seats.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id the reservation's seats hold, as shown by SHOW.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Reserves the first num_seats adjacent free seats in a row of the given event.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of adjacent seats to reserve.
+/// @param row Receives the row of the first reserved seat.
+/// @param col Receives the column of the first reserved seat.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* row, size_t* col);
+
 /// Prints the given event to the given file.
 /// @param out_fd File descriptor to print the event to.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
 int ems_show(int out_fd, unsigned int event_id);
 
+/// Prints the number of free seats of the given event and of each of its rows to the given file.
+/// @param out_fd File descriptor to print the counts to.
+/// @param event_id Id of the event to count.
+/// @return 0 if the counts were printed successfully, 1 otherwise.
+int ems_available(int out_fd, unsigned int event_id);
+
 /// Prints all the events to the given file.
 /// @param out_fd File descriptor to print the events to.
 /// @return 0 if the events were printed successfully, 1 otherwise.
@@ -41,6 +41,13 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  // reads the input through a buffer, so parsing costs no system call per character
+  struct Reader* input = create_reader(in_fd);
+  if (input == NULL) {
+    fprintf(stderr, "Failed to allocate memory for input buffer\n");
+    return 1;
+  }
+
   // opens the output fd
   int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
   if (out_fd == -1) {
@@ -49,14 +56,14 @@ int main(int argc, char* argv[]) {
   }
 
   while (1) {
-    unsigned int event_id;
+    unsigned int event_id, ttl_s, hold_id, reservation_id;
     size_t num_rows, num_columns, num_coords;
     unsigned int delay = 0;
     size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
 
-    switch (get_next(in_fd)) {
+    switch (get_next(input)) {
       case CMD_CREATE:
-        if (parse_create(in_fd, &event_id, &num_rows, &num_columns) != 0) {
+        if (parse_create(input, &event_id, &num_rows, &num_columns) != 0) {
           fprintf(stderr, "Invalid command. See HELP for usage\n");
           continue;
         }
@@ -65,7 +72,7 @@ int main(int argc, char* argv[]) {
         break;
 
       case CMD_RESERVE:
-        num_coords = parse_reserve(in_fd, MAX_RESERVATION_SIZE, &event_id, xs, ys);
+        num_coords = parse_reserve(input, MAX_RESERVATION_SIZE, &event_id, xs, ys);
 
         if (num_coords == 0) {
           fprintf(stderr, "Invalid command. See HELP for usage\n");
@@ -75,8 +82,53 @@ int main(int argc, char* argv[]) {
         if (ems_reserve(event_id, num_coords, xs, ys)) fprintf(stderr, "Failed to reserve seats\n");
         break;
 
+      case CMD_HOLD:
+        num_coords = parse_hold(input, MAX_RESERVATION_SIZE, &event_id, &ttl_s, xs, ys);
+
+        if (num_coords == 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        // the hold id is printed, since it is needed to confirm the hold
+        if (ems_hold(event_id, ttl_s, num_coords, xs, ys, &hold_id)) {
+          fprintf(stderr, "Failed to hold seats\n");
+        } else {
+          char line[32];
+          sprintf(line, "Hold: %u\n", hold_id);
+          write(out_fd, line, strlen(line));
+        }
+        break;
+
+      case CMD_CONFIRM:
+        if (parse_confirm(input, &event_id, &hold_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_confirm(event_id, hold_id)) fprintf(stderr, "Failed to confirm hold\n");
+        break;
+
+      case CMD_CANCEL:
+        if (parse_cancel(input, &event_id, &reservation_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_cancel(event_id, reservation_id)) fprintf(stderr, "Failed to cancel reservation\n");
+        break;
+
+      case CMD_RESERVE_BEST:
+        if (parse_reserve_best(input, &event_id, &num_coords) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_reserve_best(event_id, num_coords, &xs[0], &ys[0])) fprintf(stderr, "Failed to reserve seats\n");
+        break;
+
       case CMD_SHOW:
-        if (parse_show(in_fd, &event_id) != 0) {
+        if (parse_show(input, &event_id) != 0) {
           fprintf(stderr, "Invalid command. See HELP for usage\n");
           continue;
         }
@@ -84,12 +136,22 @@ int main(int argc, char* argv[]) {
         if (ems_show(out_fd, event_id)) fprintf(stderr, "Failed to show event\n");
         break;
 
+      case CMD_AVAILABLE:
+        // takes the same argument as SHOW
+        if (parse_show(input, &event_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_available(out_fd, event_id)) fprintf(stderr, "Failed to count free seats\n");
+        break;
+
       case CMD_LIST_EVENTS:
         if (ems_list_events(out_fd)) fprintf(stderr, "Failed to list events\n");
         break;
 
       case CMD_WAIT:
-        if (parse_wait(in_fd, &delay, NULL) == -1) {
+        if (parse_wait(input, &delay, NULL) == -1) {
             fprintf(stderr, "Invalid command. See HELP for usage\n");
             continue;
         }
@@ -109,7 +171,12 @@ int main(int argc, char* argv[]) {
             "Available commands:\n"
             "  CREATE <event_id> <num_rows> <num_columns>\n"
             "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  RESERVE_BEST <event_id> <num_seats>\n"
+            "  HOLD <event_id> <seconds> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  CONFIRM <event_id> <hold_id>\n"
+            "  CANCEL <event_id> <reservation_id>\n"
             "  SHOW <event_id>\n"
+            "  AVAILABLE <event_id>\n"
             "  LIST\n"
             "  WAIT <delay_ms>\n"
             "  HELP\n");
@@ -120,6 +187,7 @@ int main(int argc, char* argv[]) {
         break;
 
       case EOC:
+        free_reader(input);
         close(in_fd);
         close(out_fd);
         ems_quit();
@@ -3,113 +3,154 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
 #include "common/constants.h"
 #include "common/io.h"
 
-static void cleanup(int fd) {
-  char ch;
-  while (read(fd, &ch, 1) == 1 && ch != '\n')
-    ;
-}
+static void cleanup(struct Reader *reader) { reader_skip_line(reader); }
 
-enum Command get_next(int fd) {
+enum Command get_next(struct Reader *reader) {
   char buf[16];
-  if (read(fd, buf, 1) != 1) {
+  int first = reader_getc(reader);
+  if (first == -1) {
     return EOC;
   }
+  buf[0] = (char)first;
 
   switch (buf[0]) {
     case 'C':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "CREATE ", 7) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 6) != 6) {
+        cleanup(reader);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "CREATE ", 7) == 0) {
+        return CMD_CREATE;
+      }
+
+      if (strncmp(buf, "CANCEL ", 7) == 0) {
+        return CMD_CANCEL;
+      }
+
+      if (strncmp(buf, "CONFIRM", 7) != 0 || reader_read(reader, buf + 7, 1) != 1 || buf[7] != ' ') {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      return CMD_CREATE;
+      return CMD_CONFIRM;
 
     case 'R':
-      if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE ", 8) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 7) != 7 || strncmp(buf, "RESERVE", 7) != 0) {
+        cleanup(reader);
+        return CMD_INVALID;
+      }
+
+      if (buf[7] == ' ') {
+        return CMD_RESERVE;
+      }
+
+      if (buf[7] != '_' || reader_read(reader, buf + 8, 5) != 5 || strncmp(buf, "RESERVE_BEST ", 13) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      return CMD_RESERVE;
+      return CMD_RESERVE_BEST;
 
     case 'S':
-      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_SHOW;
 
+    case 'A':
+      if (reader_read(reader, buf + 1, 9) != 9 || strncmp(buf, "AVAILABLE ", 10) != 0) {
+        cleanup(reader);
+        return CMD_INVALID;
+      }
+
+      return CMD_AVAILABLE;
+
     case 'L':
-      if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      if (read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
-        cleanup(fd);
+      if (reader_read(reader, buf + 4, 1) != 0 && buf[4] != '\n') {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_LIST_EVENTS;
 
     case 'W':
-      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "WAIT ", 5) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 4) != 4 || strncmp(buf, "WAIT ", 5) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_WAIT;
 
     case 'H':
-      if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "HELP", 4) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 3) != 3) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      if (read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
-        cleanup(fd);
+      if (strncmp(buf, "HOLD", 4) == 0) {
+        if (reader_read(reader, buf + 4, 1) != 1 || buf[4] != ' ') {
+          cleanup(reader);
+          return CMD_INVALID;
+        }
+
+        return CMD_HOLD;
+      }
+
+      if (strncmp(buf, "HELP", 4) != 0) {
+        cleanup(reader);
+        return CMD_INVALID;
+      }
+
+      if (reader_read(reader, buf + 4, 1) != 0 && buf[4] != '\n') {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_HELP;
 
     case '#':
-      cleanup(fd);
+      cleanup(reader);
       return CMD_EMPTY;
 
     case '\n':
       return CMD_EMPTY;
 
     default:
-      cleanup(fd);
+      cleanup(reader);
       return CMD_INVALID;
   }
 }
 
-int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols) {
+int parse_create(struct Reader *reader, unsigned int *event_id, size_t *num_rows, size_t *num_cols) {
   char ch;
 
-  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
-    cleanup(fd);
+  if (parse_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
     return 1;
   }
 
   unsigned int u_num_rows;
-  if (parse_uint(fd, &u_num_rows, &ch) != 0 || ch != ' ') {
-    cleanup(fd);
+  if (parse_uint(reader, &u_num_rows, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
     return 1;
   }
   *num_rows = (size_t)u_num_rows;
 
   unsigned int u_num_cols;
-  if (parse_uint(fd, &u_num_cols, &ch) != 0 || (ch != '\n' && ch != '\0')) {
-    cleanup(fd);
+  if (parse_uint(reader, &u_num_cols, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
     return 1;
   }
   *num_cols = (size_t)u_num_cols;
@@ -117,44 +158,40 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
   return 0;
 }
 
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+// Parses a list of seats up to the end of the line, shared by RESERVE and HOLD
+static size_t parse_seats(struct Reader *reader, size_t max, size_t *xs, size_t *ys) {
   char ch;
 
-  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
-    cleanup(fd);
-    return 0;
-  }
-
-  if (read(fd, &ch, 1) != 1 || ch != '[') {
-    cleanup(fd);
+  if (reader_read(reader, &ch, 1) != 1 || ch != '[') {
+    cleanup(reader);
     return 0;
   }
 
   size_t num_coords = 0;
   while (num_coords < max) {
-    if (read(fd, &ch, 1) != 1 || ch != '(') {
-      cleanup(fd);
+    if (reader_read(reader, &ch, 1) != 1 || ch != '(') {
+      cleanup(reader);
       return 0;
     }
 
     unsigned int x;
-    if (parse_uint(fd, &x, &ch) != 0 || ch != ',') {
-      cleanup(fd);
+    if (parse_uint(reader, &x, &ch) != 0 || ch != ',') {
+      cleanup(reader);
       return 0;
     }
     xs[num_coords] = (size_t)x;
 
     unsigned int y;
-    if (parse_uint(fd, &y, &ch) != 0 || ch != ')') {
-      cleanup(fd);
+    if (parse_uint(reader, &y, &ch) != 0 || ch != ')') {
+      cleanup(reader);
       return 0;
     }
     ys[num_coords] = (size_t)y;
 
     num_coords++;
 
-    if (read(fd, &ch, 1) != 1 || (ch != ' ' && ch != ']')) {
-      cleanup(fd);
+    if (reader_read(reader, &ch, 1) != 1 || (ch != ' ' && ch != ']')) {
+      cleanup(reader);
       return 0;
     }
 
@@ -164,45 +201,122 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
   }
 
   if (num_coords == max) {
-    cleanup(fd);
+    cleanup(reader);
     return 0;
   }
 
-  if (read(fd, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
-    cleanup(fd);
+  if (reader_read(reader, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
     return 0;
   }
 
   return num_coords;
 }
 
-int parse_show(int fd, unsigned int *event_id) {
+size_t parse_reserve(struct Reader *reader, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 0;
+  }
+
+  return parse_seats(reader, max, xs, ys);
+}
+
+size_t parse_hold(struct Reader *reader, size_t max, unsigned int *event_id, unsigned int *ttl_s, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 0;
+  }
+
+  if (parse_uint(reader, ttl_s, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 0;
+  }
+
+  return parse_seats(reader, max, xs, ys);
+}
+
+int parse_confirm(struct Reader *reader, unsigned int *event_id, unsigned int *hold_id) {
+  char ch;
+
+  if (parse_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 1;
+  }
+
+  if (parse_uint(reader, hold_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
+    return 1;
+  }
+
+  return 0;
+}
+
+int parse_cancel(struct Reader *reader, unsigned int *event_id, unsigned int *reservation_id) {
+  char ch;
+
+  if (parse_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 1;
+  }
+
+  if (parse_uint(reader, reservation_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
+    return 1;
+  }
+
+  return 0;
+}
+
+int parse_reserve_best(struct Reader *reader, unsigned int *event_id, size_t *num_seats) {
+  char ch;
+
+  if (parse_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 1;
+  }
+
+  unsigned int u_num_seats;
+  if (parse_uint(reader, &u_num_seats, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
+    return 1;
+  }
+  *num_seats = (size_t)u_num_seats;
+
+  return 0;
+}
+
+int parse_show(struct Reader *reader, unsigned int *event_id) {
   char ch;
 
-  if (parse_uint(fd, event_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
-    cleanup(fd);
+  if (parse_uint(reader, event_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
     return 1;
   }
 
   return 0;
 }
 
-int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
+int parse_wait(struct Reader *reader, unsigned int *delay, unsigned int *thread_id) {
   char ch;
 
-  if (parse_uint(fd, delay, &ch) != 0) {
-    cleanup(fd);
+  if (parse_uint(reader, delay, &ch) != 0) {
+    cleanup(reader);
     return -1;
   }
 
   if (ch == ' ') {
     if (thread_id == NULL) {
-      cleanup(fd);
+      cleanup(reader);
       return 0;
     }
 
-    if (parse_uint(fd, thread_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
-      cleanup(fd);
+    if (parse_uint(reader, thread_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+      cleanup(reader);
       return -1;
     }
 
@@ -210,7 +324,7 @@ int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
   } else if (ch == '\n' || ch == '\0') {
     return 0;
   } else {
-    cleanup(fd);
+    cleanup(reader);
     return -1;
   }
 }
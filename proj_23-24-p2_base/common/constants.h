@@ -2,9 +2,24 @@
 #define STATE_ACCESS_DELAY_US 500000  // 500ms
 #define MAX_JOB_FILE_NAME_SIZE 256
 #define MAX_SESSION_COUNT 8
+#define MAX_WORKER_SESSIONS 8  // Sessions a worker serves at once, their requests overlap their state accesses
+#define SESSION_POLL_MS 10     // Longest time a busy worker takes to notice a waiting session or the server stopping
+#define RESPONSE_BUFFER_SIZE 4096  // Initial room for the responses a session has not read yet
+#define DEFAULT_SHARD_COUNT 16
+#define MAX_SHARD_COUNT 4096
+#define DEFAULT_STRIPE_COUNT 1
+#define MAX_STRIPE_COUNT 1024
+#define DEFAULT_WAL_FLUSH_US 1000
+#define MAX_WAL_FLUSH_US 1000000
+#define DEFAULT_WAL_BATCH_SIZE MAX_SESSION_COUNT  // Every session has at most one request waiting for the log
+#define MAX_WAL_BATCH_SIZE 65536
 #define MAX_PIPE_PATH_NAME 40
 #define OP_CODE_LEN 9
 #define EVENT_ID_LEN sizeof(unsigned int)
 #define ROW_COL_LEN sizeof(size_t)
 #define SEATS_LEN sizeof(size_t)
 
+#define HOLD_TICK_MS 10  // Resolution of the hold timers
+#define HOLD_TTL_LEN sizeof(unsigned int)
+#define HOLD_ID_LEN sizeof(unsigned int)
+#define RESERVATION_ID_LEN sizeof(unsigned int)
@@ -5,28 +5,31 @@
 #include <string.h>
 #include <unistd.h>
 
-int parse_uint(int fd, unsigned int *value, char *next) {
+int parse_uint(struct Reader *reader, unsigned int *value, char *next) {
   char buf[16];
 
   int i = 0;
   while (1) {
-    ssize_t read_bytes = read(fd, buf + i, 1);
-    if (read_bytes == -1) {
-      return 1;
-    } else if (read_bytes == 0) {
+    int ch = reader_getc(reader);
+    if (ch == -1) {
       *next = '\0';
       break;
     }
 
-    *next = buf[i];
+    *next = (char)ch;
 
-    if (buf[i] > '9' || buf[i] < '0') {
-      buf[i] = '\0';
+    if (ch > '9' || ch < '0') {
       break;
     }
 
-    i++;
+    // More digits than fit the buffer are always too large
+    if (i == 15) {
+      return 1;
+    }
+
+    buf[i++] = (char)ch;
   }
+  buf[i] = '\0';
 
   unsigned long ul = strtoul(buf, NULL, 10);
 
@@ -39,41 +42,106 @@ int parse_uint(int fd, unsigned int *value, char *next) {
   return 0;
 }
 
-int print_uint(int fd, unsigned int value) {
-  char buffer[16];
-  size_t i = 16;
+#define UINT_TEXT_SIZE 10  // Digits of the largest unsigned int
 
-  for (; value > 0; value /= 10) {
-    buffer[--i] = '0' + (char)(value % 10);
-  }
+// "00" to "99", so two digits take one division and one copy
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354"
+    "555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+#define ZEROS_8 "0 0 0 0 0 0 0 0 "
+#define ZEROS_64 ZEROS_8 ZEROS_8 ZEROS_8 ZEROS_8 ZEROS_8 ZEROS_8 ZEROS_8 ZEROS_8
+
+// A run of zeros, each with the space after it
+static const char zeros[] = ZEROS_64 ZEROS_64;
+
+// Formats a value at p, returning the end of its digits
+static char *format_uint(char *p, unsigned int value) {
+  char digits[UINT_TEXT_SIZE];
+  char *first = digits + UINT_TEXT_SIZE;
 
-  if (i == 16) {
-    buffer[--i] = '0';
+  while (value >= 100) {
+    unsigned int pair = value % 100;
+    value /= 100;
+    first -= 2;
+    memcpy(first, digit_pairs + pair * 2, 2);
   }
+  if (value >= 10) {
+    first -= 2;
+    memcpy(first, digit_pairs + value * 2, 2);
+  } else {
+    *--first = (char)('0' + value);
+  }
+
+  size_t len = (size_t)(digits + UINT_TEXT_SIZE - first);
+  memcpy(p, first, len);
+  return p + len;
+}
 
-  while (i < 16) {
-    ssize_t written = write(fd, buffer + i, 16 - i);
+static int write_all(int fd, const char *bytes, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(fd, bytes, len);
     if (written == -1) {
       return 1;
     }
 
-    i += (size_t)written;
+    bytes += (size_t)written;
+    len -= (size_t)written;
   }
 
   return 0;
 }
 
-int print_str(int fd, const char *str) {
-  size_t len = strlen(str);
-  while (len > 0) {
-    ssize_t written = write(fd, str, len);
-    if (written == -1) {
-      return 1;
+int print_uint(int fd, unsigned int value) {
+  char buffer[UINT_TEXT_SIZE];
+  return write_all(fd, buffer, (size_t)(format_uint(buffer, value) - buffer));
+}
+
+size_t format_row(char *buffer, const unsigned int *values, size_t n) {
+  char *p = buffer;
+  size_t i = 0;
+  while (i < n) {
+    if (values[i] != 0) {
+      p = format_uint(p, values[i++]);
+      *p++ = ' ';
+      continue;
     }
 
-    str += (size_t)written;
-    len -= (size_t)written;
+    size_t run = 1;
+    while (i + run < n && values[i + run] == 0) {
+      run++;
+    }
+    i += run;
+
+    for (size_t bytes = run * 2; bytes > 0;) {
+      size_t chunk = bytes < sizeof(zeros) - 1 ? bytes : sizeof(zeros) - 1;
+      memcpy(p, zeros, chunk);
+      p += chunk;
+      bytes -= chunk;
+    }
   }
 
+  // The space after the last value becomes the newline
+  if (p > buffer) p--;
+  *p++ = '\n';
+  return (size_t)(p - buffer);
+}
+
+int print_rows(int fd, const unsigned int *values, size_t rows, size_t cols) {
+  char *buffer = malloc(ROW_TEXT_SIZE(cols));
+  if (buffer == NULL) {
+    return 1;
+  }
+
+  for (size_t i = 0; i < rows; i++) {
+    if (write_all(fd, buffer, format_row(buffer, values + i * cols, cols))) {
+      free(buffer);
+      return 1;
+    }
+  }
+
+  free(buffer);
   return 0;
 }
+
+int print_str(int fd, const char *str) { return write_all(fd, str, strlen(str)); }
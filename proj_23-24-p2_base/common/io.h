@@ -1,12 +1,19 @@
 #ifndef COMMON_IO_H
 #define COMMON_IO_H
 
-/// Parses an unsigned integer from the given file descriptor.
-/// @param fd The file descriptor to read from.
+#include <stddef.h>
+
+#include "reader.h"
+
+/// Bytes format_row may use for a row of n values.
+#define ROW_TEXT_SIZE(n) ((n) * 11 + 1)
+
+/// Parses an unsigned integer from the given reader.
+/// @param reader The reader to parse from.
 /// @param value Pointer to the variable to store the value in.
 /// @param next Pointer to the variable to store the next character in.
 /// @return 0 if the integer was read successfully, 1 otherwise.
-int parse_uint(int fd, unsigned int *value, char *next);
+int parse_uint(struct Reader *reader, unsigned int *value, char *next);
 
 /// Prints an unsigned integer to the given file descriptor.
 /// @param fd The file descriptor to write to.
@@ -14,6 +21,22 @@ int parse_uint(int fd, unsigned int *value, char *next);
 /// @return 0 if the integer was written successfully, 1 otherwise.
 int print_uint(int fd, unsigned int value);
 
+/// Formats a row of unsigned integers, separated by spaces and ended by a newline.
+/// @note Values are formatted two digits at a time from a table, and runs of zeros are copied whole.
+/// @param buffer The buffer to format into, at least ROW_TEXT_SIZE(n) bytes.
+/// @param values The values to format.
+/// @param n The number of values.
+/// @return The number of bytes written to the buffer.
+size_t format_row(char *buffer, const unsigned int *values, size_t n);
+
+/// Prints a matrix of unsigned integers to the given file descriptor, one formatted row per write.
+/// @param fd The file descriptor to write to.
+/// @param values The values, row after row.
+/// @param rows The number of rows.
+/// @param cols The number of values in each row.
+/// @return 0 if the matrix was written successfully, 1 otherwise.
+int print_rows(int fd, const unsigned int *values, size_t rows, size_t cols);
+
 /// Writes a string to the given file descriptor.
 /// @param fd The file descriptor to write to.
 /// @param str The string to write.
@@ -0,0 +1,68 @@
+#include "reader.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct Reader* create_reader(int fd) {
+  struct Reader* reader = (struct Reader*)malloc(sizeof(struct Reader));
+  if (!reader) return NULL;
+
+  reader->fd = fd;
+  reader->pos = 0;
+  reader->len = 0;
+  reader->eof = 0;
+  return reader;
+}
+
+void free_reader(struct Reader* reader) { free(reader); }
+
+size_t reader_fill(struct Reader* reader) {
+  if (reader->pos < reader->len) return reader->len - reader->pos;
+  if (reader->eof) return 0;
+
+  ssize_t read_bytes;
+  do {
+    read_bytes = read(reader->fd, reader->buffer, READER_BUFFER_SIZE);
+  } while (read_bytes == -1 && errno == EINTR);
+
+  // An error ends the input like the end of the file does
+  reader->pos = 0;
+  reader->len = read_bytes > 0 ? (size_t)read_bytes : 0;
+  if (read_bytes <= 0) reader->eof = 1;
+  return reader->len;
+}
+
+int reader_peek(struct Reader* reader) {
+  if (reader->pos == reader->len && reader_fill(reader) == 0) return -1;
+  return (unsigned char)reader->buffer[reader->pos];
+}
+
+int reader_getc(struct Reader* reader) {
+  if (reader->pos == reader->len && reader_fill(reader) == 0) return -1;
+  return (unsigned char)reader->buffer[reader->pos++];
+}
+
+size_t reader_read(struct Reader* reader, char* buf, size_t n) {
+  size_t copied = 0;
+  while (copied < n && reader_fill(reader) > 0) {
+    size_t chunk = reader->len - reader->pos;
+    if (chunk > n - copied) chunk = n - copied;
+    memcpy(buf + copied, reader->buffer + reader->pos, chunk);
+    reader->pos += chunk;
+    copied += chunk;
+  }
+  return copied;
+}
+
+void reader_skip_line(struct Reader* reader) {
+  while (reader_fill(reader) > 0) {
+    char* newline = memchr(reader->buffer + reader->pos, '\n', reader->len - reader->pos);
+    if (newline) {
+      reader->pos = (size_t)(newline - reader->buffer) + 1;
+      return;
+    }
+    reader->pos = reader->len;
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef COMMON_READER_H
+#define COMMON_READER_H
+
+#include <stddef.h>
+
+#define READER_BUFFER_SIZE 65536  // Bytes read from the file at once
+
+// Buffered reader over a file descriptor, so parsing a command costs no system call per character
+struct Reader {
+  int fd;
+  size_t pos;  // Next byte to be consumed
+  size_t len;  // Number of valid bytes in the buffer
+  int eof;     // Set once the file has no bytes left
+  char buffer[READER_BUFFER_SIZE];
+};
+
+/// Creates a reader over a file descriptor.
+/// @param fd File descriptor to read from, still owned by the caller.
+/// @return Newly created reader, NULL on failure.
+struct Reader* create_reader(int fd);
+
+/// Frees a reader without closing its file descriptor.
+/// @param reader Reader to be freed.
+void free_reader(struct Reader* reader);
+
+/// Refills the buffer once every byte in it was consumed.
+/// @param reader Reader to be refilled.
+/// @return Number of bytes ready to be consumed, 0 at the end of the file or on error.
+size_t reader_fill(struct Reader* reader);
+
+/// Gets the next byte without consuming it.
+/// @param reader Reader to get the byte from.
+/// @return The byte, -1 at the end of the file.
+int reader_peek(struct Reader* reader);
+
+/// Consumes the next byte.
+/// @param reader Reader to get the byte from.
+/// @return The byte, -1 at the end of the file.
+int reader_getc(struct Reader* reader);
+
+/// Consumes up to n bytes, like read but refilling the buffer as many times as needed.
+/// @param reader Reader to get the bytes from.
+/// @param buf Buffer to store the bytes in.
+/// @param n Number of bytes to get.
+/// @return Number of bytes stored, less than n only at the end of the file.
+size_t reader_read(struct Reader* reader, char* buf, size_t n);
+
+/// Moves the cursor past the next newline, or to the end of the file if there is none.
+/// @param reader Reader to be moved.
+void reader_skip_line(struct Reader* reader);
+
+#endif  // COMMON_READER_H
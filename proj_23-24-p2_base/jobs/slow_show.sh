@@ -0,0 +1,100 @@
+#!/bin/bash
+# RESERVE latency on an event while SHOWs of that event are stalled: sessions ask for a SHOW too large for their
+# response pipe and do not read it, so the server is left with the rest of each answer to write. There is one such
+# session per worker, and one more that never opens its pipes, so the reserving client shares its worker with them.
+# It reserves seats of the same event one at a time, and its mean latency must stay within twice the one of a run
+# without the stalled readers (plus 100us of noise).
+# Usage: jobs/slow_show.sh, with RESERVES and STALLED taken from the environment
+set -e
+cd "$(dirname "$0")/.."
+make -s server/ems client/client
+
+RESERVES=${RESERVES:-2000}
+STALLED=${STALLED:-8}  # MAX_SESSION_COUNT, the number of workers
+ROWS=400
+COLS=400  # The SHOW answer holds ROWS * COLS seats of 4 bytes, ten times what a pipe buffers
+dir=$(mktemp -d)
+server=
+trap '[ -n "$server" ] && { kill -9 $server; wait $server || true; } 2>/dev/null; rm -rf "$dir"' EXIT
+
+echo "CREATE 1 $ROWS $COLS" > "$dir/create.jobs"
+# Each run reserves seats of its own, starting at the given row
+write_reserves() {
+  for ((i = 0; i < RESERVES; i++)); do
+    echo "RESERVE 1 [($((i / COLS + $2)),$((i % COLS + 1)))]"
+  done > "$dir/$1.jobs"
+}
+write_reserves idle 1
+write_reserves stalled $((RESERVES / COLS + 2))
+
+rm -f "$dir/server"
+server/ems "$dir/server" 0 > "$dir/server.log" 2>&1 &
+server=$!
+while [ ! -p "$dir/server" ]; do sleep 0.01; done
+
+# Runs a jobs file through the client, printing the mean time of its requests in microseconds
+run_client() {
+  local start
+  start=$(date +%s%N)
+  timeout 60 client/client "$dir/req_$1" "$dir/resp_$1" "$dir/server" "$dir/$1.jobs" 2>> "$dir/client.log" ||
+    { echo "the $1 client failed or timed out" >&2; exit 1; }
+  echo $((($(date +%s%N) - start) / 1000 / ${2:-1}))
+}
+
+run_client create > /dev/null
+idle=$(run_client idle "$RESERVES")
+
+# The stalled sessions speak the protocol themselves: a setup request with both pipe paths padded to
+# MAX_PIPE_PATH_NAME (40) bytes, then a SHOW of event 1, whose answer is not read
+setup() {
+  mkfifo "$dir/req_$1" "$dir/resp_$1"
+  {
+    printf 'OP_CODE=1%s' "$dir/req_$1"
+    head -c $((40 - ${#dir} - 5 - ${#1})) /dev/zero
+    printf '%s' "$dir/resp_$1"
+    head -c $((40 - ${#dir} - 6 - ${#1})) /dev/zero
+  } > "$dir/setup"
+  # Sent with a single write, the server reads the request as it comes
+  cat "$dir/setup" > "$dir/server"
+}
+
+# This one never opens its pipes. The server reads one setup request each time it opens its pipe, so the next one is
+# only sent once it had the time to read this one
+setup silent
+sleep 0.2
+
+# Opening both ends of the pipes does not wait for the server, which may never get to the session
+req=()
+resp=()
+for ((k = 0; k < STALLED; k++)); do
+  setup "slow$k"
+  exec {r}<> "$dir/req_slow$k" {w}<> "$dir/resp_slow$k"
+  req+=("$r")
+  resp+=("$w")
+  timeout 10 head -c 4 <&"$w" > /dev/null || { echo "FAIL: stalled session $k was not started" >&2; exit 1; }
+  printf 'OP_CODE=5\x01\x00\x00\x00' >&"$r"
+done
+sleep 0.2
+
+stalled=$(run_client stalled "$RESERVES")
+
+# Only now are the answers read, they must be complete, so the server was still writing them during the run
+answer=0
+for ((k = 0; k < STALLED; k++)); do
+  answer=$((answer + $(timeout 10 head -c $((20 + ROWS * COLS * 4)) <&"${resp[k]}" | wc -c)))
+  printf 'OP_CODE=2' >&"${req[k]}"
+done
+
+echo "slow_show: mean RESERVE latency in us on a ${ROWS}x${COLS} event, $RESERVES reservations, delay 0"
+printf '%-24s%s\n' "without a SHOW reader:" "$idle" "with $STALLED stalled SHOWs:" "$stalled"
+
+if [ "$answer" -ne $((STALLED * (20 + ROWS * COLS * 4))) ] || [ -s "$dir/client.log" ]; then
+  echo "FAIL: the SHOW answers were $answer bytes"
+  cat "$dir/client.log"
+  exit 1
+fi
+if [ "$stalled" -gt $((2 * idle + 100)) ]; then
+  echo "FAIL: the stalled SHOWs slowed RESERVE down"
+  exit 1
+fi
+echo ok
@@ -0,0 +1,128 @@
+#!/bin/bash
+# Reservation throughput of the server under different write-ahead log flush policies, driven by the client: CLIENTS
+# clients at once each create an event and reserve its seats one request at a time. Every run with a log also kills
+# the server and starts it again from the log, the events must come back the same as in the run without a log. A last
+# run with a store is stopped cleanly instead, which must leave the log empty and the events in the store.
+# Usage: jobs/wal.sh, with CLIENTS, RESERVES and WAL_DIR (where the logs are written, a disk for the syncs to count)
+# taken from the environment
+set -e
+cd "$(dirname "$0")/.."
+make -s server/ems client/client
+
+CLIENTS=${CLIENTS:-8}
+RESERVES=${RESERVES:-2000}
+dir=$(mktemp -d)
+WAL_DIR=${WAL_DIR:-$dir}
+server=
+trap '[ -n "$server" ] && kill -9 $server 2>/dev/null; rm -rf "$dir"' EXIT
+
+# Every client fills an event of its own, 100 seats per row
+for ((c = 1; c <= CLIENTS; c++)); do
+  {
+    echo "CREATE $c $(((RESERVES + 99) / 100)) 100"
+    for ((i = 0; i < RESERVES; i++)); do
+      echo "RESERVE $c [($((i / 100 + 1)),$((i % 100 + 1)))]"
+    done
+  } > "$dir/client$c.jobs"
+  echo "SHOW $c" >> "$dir/show.jobs"
+done
+
+start_server() {
+  rm -f "$dir/server"
+  server/ems "$@" "$dir/server" 0 >> "$dir/server.log" 2>&1 &
+  server=$!
+  while [ ! -p "$dir/server" ]; do sleep 0.01; done
+}
+
+stop_server() {
+  kill -9 $server
+  wait $server 2>/dev/null || true
+  server=
+}
+
+# Stops the server with SIGTERM and waits for it to close the state, failing if it does not exit cleanly
+close_server() {
+  kill -TERM $server
+  wait $server || { echo "the server did not stop cleanly, see the server log"; exit 1; }
+  server=
+}
+
+# Runs the show jobs, the events as the server holds them end up in the given file
+show_events() {
+  client/client "$dir/show_req" "$dir/show_resp" "$dir/server" "$dir/show.jobs" 2>> "$dir/clients.log"
+  mv "$dir/show.out" "$1"
+}
+
+# Runs every client at once, printing the reservations per second
+run_clients() {
+  local start pids=()
+  start=$(date +%s%N)
+  for ((c = 1; c <= CLIENTS; c++)); do
+    client/client "$dir/req$c" "$dir/resp$c" "$dir/server" "$dir/client$c.jobs" 2>> "$dir/clients.log" &
+    pids+=($!)
+  done
+  for pid in "${pids[@]}"; do
+    wait "$pid" || { echo "a client failed, see the server and client logs"; exit 1; }
+  done
+  echo $((CLIENTS * RESERVES * 1000000000 / ($(date +%s%N) - start)))
+}
+
+echo "wal: reservations per second, $CLIENTS clients with $RESERVES reservations each, delay 0"
+echo "log on $(df -T "$WAL_DIR" | awk 'NR == 2 { print $2 }') at $WAL_DIR"
+printf "%-24s %12s %10s\n" "policy" "reserves/s" "replay"
+
+for policy in "" "-i 0 -b 1" "-i 0 -b 8" "-i 1000 -b 8" "-i 1000 -b 64" "-i 10000 -b 256"; do
+  if [ -z "$policy" ]; then
+    start_server
+    rate=$(run_clients)
+    show_events "$dir/expected.out"
+    stop_server
+    printf "%-24s %12s %10s\n" "no log" "$rate" "-"
+    [ -s "$dir/expected.out" ] || exit 1
+    continue
+  fi
+
+  wal="$WAL_DIR/wal_test.log"
+  rm -f "$wal"
+  # shellcheck disable=SC2086
+  start_server -w "$wal" $policy
+  rate=$(run_clients)
+  show_events "$dir/before.out"
+  stop_server
+
+  # shellcheck disable=SC2086
+  start_server -w "$wal" $policy
+  show_events "$dir/after.out"
+  stop_server
+  rm -f "$wal"
+
+  replay=ok
+  cmp -s "$dir/before.out" "$dir/expected.out" && cmp -s "$dir/after.out" "$dir/expected.out" || replay=DIFF
+  printf "%-24s %12s %10s\n" "-w $policy" "$rate" "$replay"
+  [ "$replay" = ok ] || exit 1
+done
+
+# A clean stop syncs the store and empties the log, the next server starts from the store without replaying anything
+store="$WAL_DIR/wal_test.store"
+wal="$WAL_DIR/wal_test.log"
+rm -f "$store" "$wal"
+start_server -f "$store" -w "$wal"
+rate=$(run_clients)
+close_server
+logged=$(stat -c %s "$wal")
+
+start_server -f "$store" -w "$wal"
+show_events "$dir/after.out"
+stop_server
+rm -f "$store" "$wal"
+
+replay=ok
+[ "$logged" -eq 0 ] && cmp -s "$dir/after.out" "$dir/expected.out" || replay=DIFF
+printf "%-24s %12s %10s\n" "-f -w, clean stop" "$rate" "$replay"
+[ "$replay" = ok ] || { echo "the log held $logged bytes after the clean stop"; exit 1; }
+
+# A reservation the server refused would show up here
+if [ -s "$dir/clients.log" ]; then
+  cat "$dir/clients.log"
+  exit 1
+fi
@@ -0,0 +1,165 @@
+#include "epoch.h"
+
+#include <stdlib.h>
+
+// States of a record, an orphaned record still belongs to its thread but no longer to any domain
+enum { RECORD_FREE, RECORD_OWNED, RECORD_ORPHANED };
+
+// Record of the calling thread, cached together with the generation of the domain it belongs to
+static _Thread_local unsigned long local_generation = 0;
+static _Thread_local struct EpochRecord* local_record = NULL;
+
+// Generation of the next domain, 0 is never given so it can stand for no domain
+static atomic_ulong next_generation = 1;
+
+static pthread_key_t record_key;
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+
+// Gives the record back to its domain when the thread exits or moves on, or frees it if the domain is gone
+static void release_record(void* record) {
+  struct EpochRecord* released = record;
+  if (atomic_exchange(&released->in_use, RECORD_FREE) == RECORD_ORPHANED) free(released);
+}
+
+static void create_record_key(void) { pthread_key_create(&record_key, release_record); }
+
+int epoch_init(struct EpochDomain* domain) {
+  if (pthread_mutex_init(&domain->retire_lock, NULL) != 0) return 1;
+  atomic_init(&domain->global, 1);
+  atomic_init(&domain->records, NULL);
+  domain->retired = NULL;
+  domain->generation = atomic_fetch_add(&next_generation, 1);
+  pthread_once(&record_key_once, create_record_key);
+  return 0;
+}
+
+void epoch_destroy(struct EpochDomain* domain) {
+  struct EpochRetired* retired = domain->retired;
+  while (retired) {
+    struct EpochRetired* temp = retired;
+    retired = retired->next;
+    free(temp->ptr);
+    free(temp);
+  }
+  domain->retired = NULL;
+
+  // Records still owned by a live thread are handed to it, release_record frees them once the thread lets go
+  struct EpochRecord* record = atomic_load(&domain->records);
+  while (record) {
+    struct EpochRecord* temp = record;
+    record = record->next;
+    int expected = RECORD_OWNED;
+    if (!atomic_compare_exchange_strong(&temp->in_use, &expected, RECORD_ORPHANED)) free(temp);
+  }
+  atomic_store(&domain->records, NULL);
+
+  pthread_mutex_destroy(&domain->retire_lock);
+}
+
+// Finds the record of the calling thread, reusing one left by an exited thread if possible
+static struct EpochRecord* get_record(struct EpochDomain* domain) {
+  // A domain created where a destroyed one was has another generation, so a stale record is never returned
+  if (local_record && local_generation == domain->generation) return local_record;
+
+  // The thread keeps a single record, the one of the domain it used before is given back first
+  if (local_record) {
+    release_record(local_record);
+    pthread_setspecific(record_key, NULL);
+    local_record = NULL;
+  }
+
+  struct EpochRecord* record = NULL;
+  for (struct EpochRecord* current = atomic_load(&domain->records); current; current = current->next) {
+    int expected = RECORD_FREE;
+    if (atomic_compare_exchange_strong(&current->in_use, &expected, RECORD_OWNED)) {
+      record = current;
+      break;
+    }
+  }
+
+  if (!record) {
+    record = aligned_alloc(_Alignof(struct EpochRecord), sizeof(struct EpochRecord));
+    if (!record) return NULL;
+    atomic_init(&record->epoch, 0);
+    atomic_init(&record->in_use, RECORD_OWNED);
+    record->next = atomic_load(&domain->records);
+    while (!atomic_compare_exchange_weak(&domain->records, &record->next, record))
+      ;
+  }
+
+  pthread_setspecific(record_key, record);
+  local_generation = domain->generation;
+  local_record = record;
+  return record;
+}
+
+void epoch_enter(struct EpochDomain* domain) {
+  struct EpochRecord* record = get_record(domain);
+  // Without a record the thread is never announced, so the domain must not free anything it reads
+  if (!record) abort();
+
+  atomic_store(&record->epoch, atomic_load(&domain->global));
+  // The announcement must be visible before any shared pointer is loaded
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+void epoch_exit(struct EpochDomain* domain) {
+  (void)domain;
+  atomic_store_explicit(&local_record->epoch, 0, memory_order_release);
+}
+
+int epoch_retire(struct EpochDomain* domain, void* ptr) {
+  struct EpochRetired* retired = malloc(sizeof(struct EpochRetired));
+  if (!retired) return 1;
+
+  retired->ptr = ptr;
+
+  pthread_mutex_lock(&domain->retire_lock);
+  retired->epoch = atomic_load(&domain->global);
+  retired->next = domain->retired;
+  domain->retired = retired;
+  pthread_mutex_unlock(&domain->retire_lock);
+
+  epoch_collect(domain);
+  return 0;
+}
+
+void epoch_collect(struct EpochDomain* domain) {
+  pthread_mutex_lock(&domain->retire_lock);
+  if (!domain->retired) {
+    pthread_mutex_unlock(&domain->retire_lock);
+    return;
+  }
+
+  atomic_thread_fence(memory_order_seq_cst);
+  unsigned long global = atomic_load(&domain->global);
+
+  // The epoch only moves on once every reader inside a critical section has observed it
+  int quiescent = 1;
+  for (struct EpochRecord* record = atomic_load(&domain->records); record; record = record->next) {
+    unsigned long epoch = atomic_load(&record->epoch);
+    if (epoch != 0 && epoch != global) {
+      quiescent = 0;
+      break;
+    }
+  }
+
+  if (quiescent) {
+    atomic_store(&domain->global, ++global);
+  }
+
+  // Anything retired two epochs ago can no longer be reached by a reader
+  struct EpochRetired** current = &domain->retired;
+  while (*current) {
+    struct EpochRetired* retired = *current;
+    if (retired->epoch + 2 <= global) {
+      *current = retired->next;
+      free(retired->ptr);
+      free(retired);
+    } else {
+      current = &retired->next;
+    }
+  }
+
+  pthread_mutex_unlock(&domain->retire_lock);
+}
@@ -1,28 +1,733 @@
 #include "eventlist.h"
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "common/constants.h"
+
+#define INITIAL_BUCKETS 64
+#define CACHE_LINE 64
+#define ARENA_CHUNK_SIZE (1 << 20)  // Events bigger than a quarter of a chunk get a chunk of their own
+
+// Rounds a size up to a whole number of cache lines
+static size_t align_up(size_t size) { return (size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1); }
+
+// Spreads consecutive event ids over the shards and buckets
+static unsigned int hash_id(unsigned int event_id) { return event_id * 2654435761u; }
+
+// The shard is picked from the high bits of the hash, leaving the low bits to the buckets
+static struct EventShard* get_shard(struct EventList* list, unsigned int event_id) {
+  return &list->shards[((uint64_t)hash_id(event_id) * list->n_shards) >> 32];
+}
+
+// Allocates a table with its entry pool in the same block
+static struct BucketTable* create_table(size_t n_buckets) {
+  struct BucketTable* table = (struct BucketTable*)malloc(sizeof(struct BucketTable) +
+                                                          n_buckets * sizeof(_Atomic(struct BucketEntry*)) +
+                                                          n_buckets * sizeof(struct BucketEntry));
+  if (!table) return NULL;
+  table->n_buckets = n_buckets;
+  table->used = 0;
+  table->entries = (struct BucketEntry*)(table->buckets + n_buckets);
+  for (size_t i = 0; i < n_buckets; i++) {
+    atomic_init(&table->buckets[i], NULL);
+  }
+  return table;
+}
+
+// Links a node into the table, the release store publishes it to the readers
+static void insert_entry(struct BucketTable* table, struct ListNode* node) {
+  struct BucketEntry* entry = &table->entries[table->used++];
+  size_t bucket = hash_id(node->event->id) & (table->n_buckets - 1);
+  entry->node = node;
+  atomic_init(&entry->next, atomic_load_explicit(&table->buckets[bucket], memory_order_relaxed));
+  atomic_store_explicit(&table->buckets[bucket], entry, memory_order_release);
+}
+
+// Frees the first n_shards shards, used when the list is destroyed or fails to be created
+static void free_shards(struct EventList* list, size_t n_shards) {
+  for (size_t i = 0; i < n_shards; i++) {
+    // The events and their nodes live in the arena, so freeing its chunks releases all of them at once
+    struct ArenaChunk* chunk = list->shards[i].chunks;
+    while (chunk) {
+      struct ArenaChunk* temp = chunk;
+      chunk = chunk->next;
+      free(temp);
+    }
+
+    pthread_mutex_destroy(&list->shards[i].mutex);
+    free(atomic_load(&list->shards[i].table));
+  }
+  free(list->shards);
+}
+
+// Allocates a zeroed chunk with the given usable size
+static struct ArenaChunk* create_chunk(size_t size) {
+  // calloc leaves big chunks to the kernel's zero pages, so untouched seats never become resident
+  struct ArenaChunk* chunk = (struct ArenaChunk*)calloc(1, sizeof(struct ArenaChunk) + CACHE_LINE + size);
+  if (!chunk) return NULL;
+  chunk->data = (unsigned char*)align_up((uintptr_t)(chunk + 1));
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->next = NULL;
+  return chunk;
+}
+
+struct EventList* create_list(size_t n_shards, size_t n_stripes) {
+  if (n_shards == 0 || n_stripes == 0) return NULL;
 
-struct EventList* create_list() {
   struct EventList* list = (struct EventList*)malloc(sizeof(struct EventList));
   if (!list) return NULL;
   if (pthread_rwlock_init(&list->rwl, NULL) != 0) {
     free(list);
     return NULL;
   }
+  if (epoch_init(&list->epoch) != 0) {
+    pthread_rwlock_destroy(&list->rwl);
+    free(list);
+    return NULL;
+  }
+
+  list->shards = (struct EventShard*)malloc(n_shards * sizeof(struct EventShard));
+  if (!list->shards) {
+    epoch_destroy(&list->epoch);
+    pthread_rwlock_destroy(&list->rwl);
+    free(list);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < n_shards; i++) {
+    struct BucketTable* table = create_table(INITIAL_BUCKETS);
+    if (!table || pthread_mutex_init(&list->shards[i].mutex, NULL) != 0) {
+      free(table);
+      free_shards(list, i);
+      epoch_destroy(&list->epoch);
+      pthread_rwlock_destroy(&list->rwl);
+      free(list);
+      return NULL;
+    }
+    atomic_init(&list->shards[i].table, table);
+    list->shards[i].chunks = NULL;
+  }
+
+  list->n_shards = n_shards;
+  list->n_stripes = n_stripes;
+  list->store = NULL;
   list->head = NULL;
   list->tail = NULL;
   return list;
 }
 
-int append_to_list(struct EventList* list, struct Event* event) {
-  if (!list) return 1;
+int lock_shard(struct EventList* list, unsigned int event_id) {
+  return pthread_mutex_lock(&get_shard(list, event_id)->mutex) != 0;
+}
+
+void unlock_shard(struct EventList* list, unsigned int event_id) {
+  pthread_mutex_unlock(&get_shard(list, event_id)->mutex);
+}
+
+// Size of the slab holding an event followed by its seats, bitmap and row counters, 0 if it cannot be addressed
+static size_t slab_size(size_t num_rows, size_t num_cols) {
+  if (num_cols != 0 && num_rows > SIZE_MAX / sizeof(unsigned int) / num_cols) return 0;
+  if (num_rows > SIZE_MAX / 4 / sizeof(size_t)) return 0;
+  size_t seats_size = num_rows * num_cols * sizeof(unsigned int);
+  size_t header_size = align_up(sizeof(struct Event));
+  size_t bitmap_size = (num_rows * num_cols + 63) / 64 * sizeof(uint64_t);
+  size_t counters_size = num_rows * sizeof(size_t);
+  if (seats_size > SIZE_MAX - 4 * CACHE_LINE - header_size - bitmap_size - counters_size) return 0;
+  return header_size + align_up(seats_size) + align_up(bitmap_size) + align_up(counters_size);
+}
+
+// Points an event at the seats, bitmap and row counters following it in its slab, none of the pointers is kept in
+// the store
+static void link_slab(struct Event* event) {
+  size_t n_seats = event->rows * event->cols;
+  event->data = (unsigned char*)event + align_up(sizeof(struct Event));
+  event->occupied = (_Atomic(uint64_t)*)((unsigned char*)event->data + align_up(n_seats * sizeof(unsigned int)));
+  event->row_taken =
+      (_Atomic(size_t)*)((unsigned char*)event->occupied + align_up((n_seats + 63) / 64 * sizeof(uint64_t)));
+  event->snapshot = NULL;
+  event->free_runs = NULL;
+  for (size_t i = 0; i < RESERVATION_SEGMENTS; i++) {
+    atomic_init(&event->reservation_index[i], NULL);
+  }
+  event->node.event = event;
+  event->node.next = NULL;
+}
+
+// Carves a zeroed slab from the arena of the event's shard
+static void* arena_alloc(struct EventShard* shard, size_t size) {
+  struct ArenaChunk* chunk = shard->chunks;
+  if (size > ARENA_CHUNK_SIZE / 4) {
+    // A dedicated chunk goes behind the current one, which keeps being filled
+    chunk = create_chunk(size);
+    if (chunk && shard->chunks) {
+      chunk->next = shard->chunks->next;
+      shard->chunks->next = chunk;
+    } else if (chunk) {
+      shard->chunks = chunk;
+    }
+  } else if (!chunk || chunk->size - chunk->used < size) {
+    chunk = create_chunk(ARENA_CHUNK_SIZE);
+    if (chunk) {
+      chunk->next = shard->chunks;
+      shard->chunks = chunk;
+    }
+  }
+
+  if (!chunk) return NULL;
+
+  void* ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  return ptr;
+}
+
+// Allocates the stripe locks of an event from its shard's arena, they are never kept in the store
+static pthread_mutex_t* create_stripes(struct EventList* list, unsigned int event_id, size_t num_rows,
+                                       size_t* n_stripes) {
+  *n_stripes = num_rows < list->n_stripes ? num_rows : list->n_stripes;
+  if (*n_stripes == 0) *n_stripes = 1;
+
+  pthread_mutex_t* stripes =
+      arena_alloc(get_shard(list, event_id), align_up(*n_stripes * sizeof(pthread_mutex_t)));
+  if (!stripes) return NULL;
+  for (size_t i = 0; i < *n_stripes; i++) {
+    if (pthread_mutex_init(&stripes[i], NULL) != 0) return NULL;
+  }
+  return stripes;
+}
+
+struct Event* create_event(struct EventList* list, unsigned int event_id, size_t num_rows, size_t num_cols) {
+  if (!list) return NULL;
+
+  size_t size = slab_size(num_rows, num_cols);
+  if (size == 0) return NULL;
+
+  // Created before the slab, which cannot be given back to the store once reserved
+  size_t n_stripes;
+  pthread_mutex_t* stripes = create_stripes(list, event_id, num_rows, &n_stripes);
+  if (!stripes) return NULL;
+
+  struct Event* event = list->store ? store_reserve(list->store, size) : arena_alloc(get_shard(list, event_id), size);
+  if (!event) return NULL;
+
+  // The slab is zeroed, so every seat starts free and unmarked and every row without reserved seats
+  event->id = event_id;
+  event->rows = num_rows;
+  event->cols = num_cols;
+  event->reservations = 0;
+  event->taken_seats = 0;
+  event->seat_width = sizeof(uint8_t);
+  event->widen_width = 0;
+  link_slab(event);
+  event->stripes = stripes;
+  event->n_stripes = n_stripes;
+
+  if (list->store) store_publish(list->store, size);
+  return event;
+}
+
+// Reads a seat stored with the given width
+static unsigned int load_seat(const void* data, unsigned char seat_width, size_t index) {
+  switch (seat_width) {
+    case sizeof(uint8_t):
+      return ((const uint8_t*)data)[index];
+    case sizeof(uint16_t):
+      return ((const uint16_t*)data)[index];
+    default:
+      return ((const unsigned int*)data)[index];
+  }
+}
+
+// Writes a seat with the given width, the reservation id must fit in it
+static void store_seat(void* data, unsigned char seat_width, size_t index, unsigned int reservation_id) {
+  switch (seat_width) {
+    case sizeof(uint8_t):
+      ((uint8_t*)data)[index] = (uint8_t)reservation_id;
+      break;
+    case sizeof(uint16_t):
+      ((uint16_t*)data)[index] = (uint16_t)reservation_id;
+      break;
+    default:
+      ((unsigned int*)data)[index] = reservation_id;
+      break;
+  }
+}
+
+unsigned int get_seat(const struct Event* event, size_t index) { return load_seat(event->data, event->seat_width, index); }
+
+// Widens the seats below widen_next in place, starting from the last one so no seat is overwritten before it is read.
+// The progress is kept in the event, so a widening cut short by a crash is finished when the store is reopened
+static void widen_seats(struct Event* event) {
+  while (event->widen_next > 0) {
+    size_t i = event->widen_next - 1;
+    store_seat(event->data, event->widen_width, i, load_seat(event->data, event->seat_width, i));
+    atomic_signal_fence(memory_order_seq_cst);
+    event->widen_next = i;
+  }
+  event->seat_width = event->widen_width;
+  atomic_signal_fence(memory_order_seq_cst);
+  event->widen_width = 0;
+}
+
+static void start_widening(struct Event* event, unsigned char seat_width) {
+  event->widen_next = event->rows * event->cols;
+  event->widen_width = seat_width;
+  atomic_signal_fence(memory_order_seq_cst);
+  widen_seats(event);
+}
+
+void set_seat(struct Event* event, size_t index, unsigned int reservation_id) {
+  if (reservation_id > UINT16_MAX && event->seat_width < sizeof(unsigned int)) {
+    start_widening(event, sizeof(unsigned int));
+  } else if (reservation_id > UINT8_MAX && event->seat_width < sizeof(uint16_t)) {
+    start_widening(event, sizeof(uint16_t));
+  }
+  store_seat(event->data, event->seat_width, index, reservation_id);
+  atomic_fetch_add_explicit(&event->version, 1, memory_order_relaxed);
+}
+
+void copy_seats(const struct Event* event, unsigned int* seats) {
+  size_t n_seats = event->rows * event->cols;
+  switch (event->seat_width) {
+    case sizeof(uint8_t):
+      for (size_t i = 0; i < n_seats; i++) seats[i] = ((const uint8_t*)event->data)[i];
+      break;
+    case sizeof(uint16_t):
+      for (size_t i = 0; i < n_seats; i++) seats[i] = ((const uint16_t*)event->data)[i];
+      break;
+    default:
+      memcpy(seats, event->data, n_seats * sizeof(unsigned int));
+      break;
+  }
+}
+
+struct SeatSnapshot* snapshot_seats(struct Event* event) {
+  struct SeatSnapshot* snapshot = event->snapshot;
+  unsigned long version = atomic_load_explicit(&event->version, memory_order_relaxed);
+  if (snapshot == NULL || snapshot->version != version) {
+    // Only the copy is made under the lock, formatting and writing it is left to the readers
+    snapshot = (struct SeatSnapshot*)malloc(sizeof(struct SeatSnapshot) +
+                                            event->rows * event->cols * sizeof(unsigned int));
+    if (!snapshot) return NULL;
+    atomic_init(&snapshot->refs, 1);
+    snapshot->version = version;
+    snapshot->rows = event->rows;
+    snapshot->cols = event->cols;
+    copy_seats(event, snapshot->seats);
+
+    if (event->snapshot) release_snapshot(event->snapshot);
+    event->snapshot = snapshot;
+  }
+
+  atomic_fetch_add_explicit(&snapshot->refs, 1, memory_order_relaxed);
+  return snapshot;
+}
+
+void release_snapshot(struct SeatSnapshot* snapshot) {
+  if (atomic_fetch_sub_explicit(&snapshot->refs, 1, memory_order_acq_rel) == 1) free(snapshot);
+}
+
+int needs_widening(const struct Event* event, unsigned int reservation_id) {
+  return (reservation_id > UINT16_MAX && event->seat_width < sizeof(unsigned int)) ||
+         (reservation_id > UINT8_MAX && event->seat_width < sizeof(uint16_t));
+}
+
+// Rows are split in n_stripes bands of consecutive rows
+static size_t stripe_of(const struct Event* event, size_t index) {
+  return index / event->cols * event->n_stripes / event->rows;
+}
+
+size_t find_stripes(const struct Event* event, size_t num_seats, const size_t* indexes, size_t* stripes) {
+  size_t n_stripes = 0;
+  for (size_t i = 0; i < num_seats; i++) {
+    // Insertion into the sorted prefix, a reservation only spans a few stripes
+    size_t stripe = stripe_of(event, indexes[i]);
+    size_t j = n_stripes;
+    while (j > 0 && stripes[j - 1] > stripe) j--;
+    if (j > 0 && stripes[j - 1] == stripe) continue;
+    memmove(&stripes[j + 1], &stripes[j], (n_stripes - j) * sizeof(size_t));
+    stripes[j] = stripe;
+    n_stripes++;
+  }
+  return n_stripes;
+}
+
+int lock_stripes(struct Event* event, size_t n_stripes, const size_t* stripes) {
+  for (size_t i = 0; i < n_stripes; i++) {
+    if (pthread_mutex_lock(&event->stripes[stripes[i]]) != 0) {
+      unlock_stripes(event, i, stripes);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void unlock_stripes(struct Event* event, size_t n_stripes, const size_t* stripes) {
+  for (size_t i = n_stripes; i > 0; i--) {
+    pthread_mutex_unlock(&event->stripes[stripes[i - 1]]);
+  }
+}
+
+int lock_event(struct Event* event) {
+  for (size_t i = 0; i < event->n_stripes; i++) {
+    if (pthread_mutex_lock(&event->stripes[i]) != 0) {
+      while (i > 0) pthread_mutex_unlock(&event->stripes[--i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void unlock_event(struct Event* event) {
+  for (size_t i = event->n_stripes; i > 0; i--) {
+    pthread_mutex_unlock(&event->stripes[i - 1]);
+  }
+}
+
+// Smallest power of two that is at least size
+static size_t round_pow2(size_t size) {
+  size_t pow2 = 1;
+  while (pow2 < size) pow2 *= 2;
+  return pow2;
+}
+
+// Joins the runs of two adjacent ranges of len seats each
+static struct FreeRun join_runs(struct FreeRun left, struct FreeRun right, unsigned int len) {
+  struct FreeRun run;
+  run.prefix = left.prefix == len ? len + right.prefix : left.prefix;
+  run.suffix = right.suffix == len ? len + left.suffix : right.suffix;
+  run.best = left.suffix + right.prefix;
+  if (left.best > run.best) run.best = left.best;
+  if (right.best > run.best) run.best = right.best;
+  return run;
+}
+
+// Recomputes the longest run of the rows above a row after its tree changed
+static void update_row(struct FreeRunIndex* index, size_t row) {
+  pthread_mutex_lock(&index->row_lock);
+  size_t node = index->row_width + row;
+  index->row_best[node] = index->runs[row * 2 * index->width + 1].best;
+  for (node /= 2; node > 0; node /= 2) {
+    unsigned int left = index->row_best[2 * node], right = index->row_best[2 * node + 1];
+    index->row_best[node] = left > right ? left : right;
+  }
+  pthread_mutex_unlock(&index->row_lock);
+}
+
+// Whether a seat is free according to the bitmap
+static unsigned int seat_is_free(const struct Event* event, size_t index) {
+  return !(atomic_load_explicit(&event->occupied[index / 64], memory_order_relaxed) & ((uint64_t)1 << (index % 64)));
+}
+
+// Copies the state of the given seats from the bitmap into the index
+static void refresh_runs(struct FreeRunIndex* index, const struct Event* event, size_t num_seats,
+                         const size_t* indexes) {
+  for (size_t i = 0; i < num_seats; i++) {
+    size_t row = indexes[i] / event->cols;
+    struct FreeRun* tree = &index->runs[row * 2 * index->width];
+    unsigned int is_free = seat_is_free(event, indexes[i]);
+
+    size_t node = index->width + indexes[i] % event->cols;
+    tree[node] = (struct FreeRun){is_free, is_free, is_free};
+    for (unsigned int len = 1; node > 1; len *= 2) {
+      node /= 2;
+      tree[node] = join_runs(tree[2 * node], tree[2 * node + 1], len);
+    }
+
+    // The rows only need the longest run once every seat of the row is in
+    if (i + 1 == num_seats || indexes[i + 1] / event->cols != row) update_row(index, row);
+  }
+}
+
+// Builds the index of an event from its bitmap, every stripe of the event must be held
+static struct FreeRunIndex* create_free_runs(struct EventList* list, struct Event* event) {
+  size_t width = round_pow2(event->cols);
+  size_t row_width = round_pow2(event->rows);
+  if (event->rows > SIZE_MAX / sizeof(struct FreeRun) / 2 / width) return NULL;
+
+  // Kept out of the store like the stripes, the shard's arena is protected by its lock
+  if (lock_shard(list, event->id) != 0) return NULL;
+  struct FreeRunIndex* index = arena_alloc(get_shard(list, event->id),
+                                           align_up(sizeof(struct FreeRunIndex)) +
+                                               align_up(event->rows * 2 * width * sizeof(struct FreeRun)) +
+                                               align_up(2 * row_width * sizeof(unsigned int)));
+  unlock_shard(list, event->id);
+  if (!index || pthread_mutex_init(&index->row_lock, NULL) != 0) return NULL;
+
+  index->width = width;
+  index->row_width = row_width;
+  index->runs = (struct FreeRun*)((unsigned char*)index + align_up(sizeof(struct FreeRunIndex)));
+  index->row_best =
+      (unsigned int*)((unsigned char*)index->runs + align_up(event->rows * 2 * width * sizeof(struct FreeRun)));
+
+  for (size_t row = 0; row < event->rows; row++) {
+    struct FreeRun* tree = &index->runs[row * 2 * width];
+    for (size_t col = 0; col < event->cols; col++) {
+      unsigned int is_free = seat_is_free(event, row * event->cols + col);
+      tree[width + col] = (struct FreeRun){is_free, is_free, is_free};
+    }
+
+    // Every level is built from the one below, the zeroed leaves past the last column stay taken
+    for (size_t level = width / 2, len = 1; level > 0; level /= 2, len *= 2) {
+      for (size_t node = level; node < 2 * level; node++) {
+        tree[node] = join_runs(tree[2 * node], tree[2 * node + 1], (unsigned int)len);
+      }
+    }
+    update_row(index, row);
+  }
 
-  struct ListNode* new_node = (struct ListNode*)malloc(sizeof(struct ListNode));
-  if (!new_node) return 1;
+  event->free_runs = index;
+  return index;
+}
+
+// Finds the first row with num_seats adjacent free seats and the first column they start at
+static int find_free_run(const struct FreeRunIndex* index, unsigned int num_seats, size_t* row, size_t* col) {
+  if (index->row_best[1] < num_seats) return 1;
+
+  size_t node = 1;
+  while (node < index->row_width) {
+    node = index->row_best[2 * node] >= num_seats ? 2 * node : 2 * node + 1;
+  }
+  *row = node - index->row_width;
+
+  // The leftmost run is either inside the left half, across the middle or inside the right half
+  const struct FreeRun* tree = &index->runs[*row * 2 * index->width];
+  size_t start = 0;
+  node = 1;
+  for (size_t len = index->width; node < index->width; len /= 2) {
+    const struct FreeRun* left = &tree[2 * node];
+    const struct FreeRun* right = &tree[2 * node + 1];
+    if (left->best >= num_seats) {
+      node = 2 * node;
+    } else if (left->suffix + right->prefix >= num_seats) {
+      *col = start + len / 2 - left->suffix;
+      return 0;
+    } else {
+      node = 2 * node + 1;
+      start += len / 2;
+    }
+  }
+  *col = start;
+  return 0;
+}
+
+int claim_free_run(struct EventList* list, struct Event* event, size_t num_seats, size_t* indexes) {
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE || num_seats > event->cols) return 1;
+
+  struct FreeRunIndex* index = event->free_runs ? event->free_runs : create_free_runs(list, event);
+  size_t row, col;
+  if (!index || find_free_run(index, (unsigned int)num_seats, &row, &col) != 0) return 1;
+
+  // Every stripe is held, so the index matches the bitmap and the run found is free
+  for (size_t i = 0; i < num_seats; i++) {
+    indexes[i] = row * event->cols + col + i;
+  }
+  if (claim_seats(event, num_seats, indexes) != 0) return 1;
+  refresh_runs(index, event, num_seats, indexes);
+  return 0;
+}
+
+void update_free_runs(struct Event* event, size_t num_seats, const size_t* indexes) {
+  if (event->free_runs) refresh_runs(event->free_runs, event, num_seats, indexes);
+}
+
+int claim_seats(struct Event* event, size_t num_seats, const size_t* indexes) {
+  if (num_seats > MAX_RESERVATION_SIZE) return 1;
+
+  size_t words[MAX_RESERVATION_SIZE];
+  uint64_t masks[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < num_seats; i++) {
+    words[i] = indexes[i] / 64;
+    masks[i] = (uint64_t)1 << (indexes[i] % 64);
+  }
+
+  // The common case of a taken seat is rejected without branches or writes
+  uint64_t taken = 0;
+  for (size_t i = 0; i < num_seats; i++) {
+    taken |= atomic_load_explicit(&event->occupied[words[i]], memory_order_relaxed) & masks[i];
+  }
+  if (taken) return 1;
+
+  // The seats are held through their stripes, so a bit found set here was set by a repeated seat of this request.
+  // A word may also hold seats of other stripes, which is why the bits are set atomically
+  for (size_t i = 0; i < num_seats; i++) {
+    if (atomic_fetch_or_explicit(&event->occupied[words[i]], masks[i], memory_order_relaxed) & masks[i]) {
+      for (size_t j = 0; j < i; j++) {
+        atomic_fetch_and_explicit(&event->occupied[words[j]], ~masks[j], memory_order_relaxed);
+      }
+      return 1;
+    }
+  }
+
+  // A row belongs to a single stripe, but the counters are read without locks by AVAILABLE
+  for (size_t i = 0; i < num_seats; i++) {
+    atomic_fetch_add_explicit(&event->row_taken[indexes[i] / event->cols], 1, memory_order_relaxed);
+  }
+  atomic_fetch_add_explicit(&event->taken_seats, num_seats, memory_order_relaxed);
+  return 0;
+}
+
+void release_seats(struct Event* event, size_t num_seats, const size_t* indexes) {
+  for (size_t i = 0; i < num_seats; i++) {
+    atomic_fetch_and_explicit(&event->occupied[indexes[i] / 64], ~((uint64_t)1 << (indexes[i] % 64)),
+                              memory_order_relaxed);
+    atomic_fetch_sub_explicit(&event->row_taken[indexes[i] / event->cols], 1, memory_order_relaxed);
+  }
+  atomic_fetch_sub_explicit(&event->taken_seats, num_seats, memory_order_relaxed);
+}
+
+// Segment of the reverse index holding a reservation id and the id's position in it
+static size_t segment_of(unsigned int reservation_id, size_t* offset) {
+  size_t segment = (size_t)(31 - __builtin_clz(reservation_id));
+  *offset = reservation_id - ((size_t)1 << segment);
+  return segment;
+}
+
+struct ReservationSeats* prepare_reservation(struct Event* event, unsigned int reservation_id, size_t num_seats,
+                                             const size_t* indexes) {
+  if (reservation_id == 0) return NULL;
+
+  size_t offset;
+  size_t segment = segment_of(reservation_id, &offset);
+  if (!atomic_load_explicit(&event->reservation_index[segment], memory_order_acquire)) {
+    _Atomic(struct ReservationSeats*)* slots = calloc((size_t)1 << segment, sizeof(_Atomic(struct ReservationSeats*)));
+    if (!slots) return NULL;
+    _Atomic(struct ReservationSeats*)* expected = NULL;
+    if (!atomic_compare_exchange_strong_explicit(&event->reservation_index[segment], &expected, slots,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+      free(slots);
+    }
+  }
+
+  struct ReservationSeats* seats = malloc(sizeof(struct ReservationSeats) + num_seats * sizeof(size_t));
+  if (!seats) return NULL;
+  seats->num_seats = indexes ? num_seats : 0;
+  for (size_t i = 0; indexes && i < num_seats; i++) {
+    seats->seats[i] = indexes[i];
+  }
+  return seats;
+}
+
+void index_reservation(struct Event* event, unsigned int reservation_id, struct ReservationSeats* seats) {
+  size_t offset;
+  size_t segment = segment_of(reservation_id, &offset);
+  _Atomic(struct ReservationSeats*)* slots =
+      atomic_load_explicit(&event->reservation_index[segment], memory_order_acquire);
+
+  struct ReservationSeats* expected = NULL;
+  if (!atomic_compare_exchange_strong_explicit(&slots[offset], &expected, seats, memory_order_release,
+                                               memory_order_relaxed)) {
+    free(seats);
+  }
+}
+
+struct ReservationSeats* take_reservation(struct Event* event, unsigned int reservation_id) {
+  if (reservation_id == 0) return NULL;
+
+  size_t offset;
+  size_t segment = segment_of(reservation_id, &offset);
+  _Atomic(struct ReservationSeats*)* slots =
+      atomic_load_explicit(&event->reservation_index[segment], memory_order_acquire);
+  if (!slots) return NULL;
+  return atomic_exchange_explicit(&slots[offset], NULL, memory_order_acquire);
+}
+
+// Rebuilds the reverse index of a stored event from its seats, in two passes so every record is allocated once. The
+// counts are sized by the largest id in the seats rather than by the stored counter, which only bounds them
+static int index_stored_reservations(struct Event* event) {
+  size_t n_seats = event->rows * event->cols;
+  unsigned int max_id = 0;
+  for (size_t i = 0; i < n_seats; i++) {
+    unsigned int id = get_seat(event, i);
+    if (id > max_id) max_id = id;
+  }
+  if (max_id == 0) return 0;
 
-  new_node->event = event;
-  new_node->next = NULL;
+  size_t n_ids = (size_t)max_id + 1;
+  struct ReservationSeats** found = calloc(n_ids, sizeof(struct ReservationSeats*));
+  size_t* counts = calloc(n_ids, sizeof(size_t));
+  int failed = !found || !counts;
+
+  for (size_t i = 0; !failed && i < n_seats; i++) {
+    unsigned int id = get_seat(event, i);
+    if (id != 0) counts[id]++;
+  }
+
+  for (unsigned int id = 1; !failed && id < n_ids; id++) {
+    if (counts[id] == 0) continue;
+    found[id] = prepare_reservation(event, id, counts[id], NULL);
+    if (!found[id]) failed = 1;
+  }
+
+  for (size_t i = 0; !failed && i < n_seats; i++) {
+    unsigned int id = get_seat(event, i);
+    if (id != 0) found[id]->seats[found[id]->num_seats++] = i;
+  }
+
+  for (unsigned int id = 1; id < n_ids && found; id++) {
+    if (!found[id]) continue;
+    if (failed) free(found[id]);
+    else index_reservation(event, id, found[id]);
+  }
+  free(found);
+  free(counts);
+  return failed;
+}
+
+// Frees the reverse index of an event, which lives outside the arena and the store
+static void free_reservation_index(struct Event* event) {
+  for (size_t segment = 0; segment < RESERVATION_SEGMENTS; segment++) {
+    _Atomic(struct ReservationSeats*)* slots = atomic_load(&event->reservation_index[segment]);
+    if (!slots) continue;
+    for (size_t i = 0; i < ((size_t)1 << segment); i++) {
+      free(atomic_load(&slots[i]));
+    }
+    free(slots);
+    atomic_store(&event->reservation_index[segment], NULL);
+  }
+}
+
+size_t count_free_seats(const struct Event* event, size_t* row_free) {
+  if (row_free) {
+    for (size_t row = 0; row < event->rows; row++) {
+      row_free[row] = event->cols - atomic_load_explicit(&event->row_taken[row], memory_order_relaxed);
+    }
+  }
+  return event->rows * event->cols - atomic_load_explicit(&event->taken_seats, memory_order_relaxed);
+}
+
+// Replaces the shard's table with one twice the size, rebuilding it from the previous one
+static int grow_table(struct EventList* list, struct EventShard* shard) {
+  struct BucketTable* old_table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+  struct BucketTable* table = create_table(old_table->n_buckets * 2);
+  if (!table) return 1;
+
+  for (size_t i = 0; i < old_table->used; i++) {
+    insert_entry(table, old_table->entries[i].node);
+  }
+
+  // Readers may still be walking the old table, it is only freed once they are all gone
+  atomic_store_explicit(&shard->table, table, memory_order_release);
+  return epoch_retire(&list->epoch, old_table);
+}
+
+// Grows the shard's table until it has room for n more entries
+static int reserve_entries(struct EventList* list, struct EventShard* shard, size_t n) {
+  struct BucketTable* table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+  while (table->used + n > table->n_buckets) {
+    if (grow_table(list, shard) != 0) return 1;
+    table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+  }
+  return 0;
+}
+
+// Links an event into the append order and its shard's table, which must already have room for it
+static void link_event(struct EventList* list, struct Event* event) {
+  struct ListNode* new_node = &event->node;
 
   if (list->head == NULL) {
     list->head = new_node;
@@ -32,43 +737,225 @@ int append_to_list(struct EventList* list, struct Event* event) {
     list->tail = new_node;
   }
 
+  insert_entry(atomic_load_explicit(&get_shard(list, event->id)->table, memory_order_relaxed), new_node);
+}
+
+int append_to_list(struct EventList* list, struct Event* event) {
+  if (!list) return 1;
+
+  // Keeps at most one event per bucket on average
+  struct EventShard* shard = get_shard(list, event->id);
+  if (reserve_entries(list, shard, 1) != 0) return 1;
+
+  // Only the link into the append order is shared between the shards
+  if (pthread_rwlock_wrlock(&list->rwl) != 0) return 1;
+  link_event(list, event);
+  pthread_rwlock_unlock(&list->rwl);
+
+  epoch_collect(&list->epoch);
   return 0;
 }
 
-static void free_event(struct Event* event) {
-  if (!event) return;
-  free(event->data);
-  free(event);
+static int compare_ids(const void* a, const void* b) {
+  unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+  return (x > y) - (x < y);
+}
+
+// Seat of a stored event that may be halfway through a widening, read without writing to the store
+static unsigned int stored_seat(const struct Event* event, const void* data, size_t index) {
+  unsigned char width = event->widen_width != 0 && index >= event->widen_next ? event->widen_width : event->seat_width;
+  return load_seat(data, width, index);
 }
 
-void free_list(struct EventList* list) {
-  if (!list) return;
+// Checks a stored event without writing to the store, returns its slab size or 0 if it is not consistent
+static size_t check_event(const struct Event* event, size_t available) {
+  if (available < align_up(sizeof(struct Event))) return 0;
 
-  struct ListNode* current = list->head;
-  while (current) {
-    struct ListNode* temp = current;
-    current = current->next;
+  size_t size = slab_size(event->rows, event->cols);
+  if (size == 0 || size > available) return 0;
+  if (event->seat_width != sizeof(uint8_t) && event->seat_width != sizeof(uint16_t) &&
+      event->seat_width != sizeof(unsigned int))
+    return 0;
+  if (event->widen_width != 0 && (event->widen_width <= event->seat_width || event->widen_width > sizeof(unsigned int) ||
+                                  event->widen_next > event->rows * event->cols))
+    return 0;
 
-    free_event(temp->event);
-    free(temp);
+  // Every seat holds a reservation the counter already handed out, otherwise a new one would reuse its id
+  const void* data = (const unsigned char*)event + align_up(sizeof(struct Event));
+  unsigned int reservations = event->reservations;
+  for (size_t i = 0; i < event->rows * event->cols; i++) {
+    if (stored_seat(event, data, i) > reservations) return 0;
   }
+  return size;
+}
 
-  free(list);
+// Repairs what an unclean exit may have left behind in a stored event, once the whole store was accepted
+static void repair_event(struct Event* event, int was_clean) {
+  link_slab(event);
+  if (event->widen_width != 0) widen_seats(event);
+
+  // A reservation may have claimed its seats without writing them, the bitmap and counters are rebuilt from the seats
+  if (!was_clean) {
+    size_t n_seats = event->rows * event->cols;
+    for (size_t i = 0; i < (n_seats + 63) / 64; i++) {
+      atomic_store_explicit(&event->occupied[i], 0, memory_order_relaxed);
+    }
+    for (size_t row = 0; row < event->rows; row++) {
+      atomic_store_explicit(&event->row_taken[row], 0, memory_order_relaxed);
+    }
+    size_t taken = 0;
+    for (size_t i = 0; i < n_seats; i++) {
+      if (get_seat(event, i) != 0) {
+        atomic_fetch_or_explicit(&event->occupied[i / 64], (uint64_t)1 << (i % 64), memory_order_relaxed);
+        atomic_fetch_add_explicit(&event->row_taken[i / event->cols], 1, memory_order_relaxed);
+        taken++;
+      }
+    }
+    atomic_store_explicit(&event->taken_seats, taken, memory_order_relaxed);
+  }
 }
 
-struct Event* get_event(struct EventList* list, unsigned int event_id, struct ListNode* from, struct ListNode* to) {
-  if (!list || !from || !to) return NULL;
-  struct ListNode* current = from;
+int open_store(struct EventList* list, const char* path) {
+  if (!list || list->head) return 1;
+
+  struct EventStore* store = (struct EventStore*)malloc(sizeof(struct EventStore));
+  if (!store) return 1;
+  if (store_open(store, path, sizeof(struct Event)) != 0) {
+    free(store);
+    return 1;
+  }
 
-  while (1) {
-    if (current->event->id == event_id) {
-      return current->event;
+  // Every record is checked before the first one is linked, so a corrupted store is rejected as a whole
+  size_t used = store->header->used;
+  size_t n_events = 0;
+  size_t capacity = 64;
+  unsigned int* ids = (unsigned int*)malloc(capacity * sizeof(unsigned int));
+  int corrupted = ids == NULL;
+  for (size_t offset = 0; !corrupted && offset < used; n_events++) {
+    struct Event* event = (struct Event*)(store->data + offset);
+    size_t size = check_event(event, used - offset);
+    if (size == 0) {
+      corrupted = 1;
+      break;
     }
 
-    if (current == to) {
-      return NULL;
+    if (n_events == capacity) {
+      capacity *= 2;
+      unsigned int* new_ids = (unsigned int*)realloc(ids, capacity * sizeof(unsigned int));
+      if (!new_ids) {
+        corrupted = 1;
+        break;
+      }
+      ids = new_ids;
     }
+    ids[n_events] = event->id;
+    offset += size;
+  }
 
-    current = current->next;
+  if (!corrupted) {
+    qsort(ids, n_events, sizeof(unsigned int), compare_ids);
+    for (size_t i = 1; i < n_events; i++) {
+      if (ids[i] == ids[i - 1]) corrupted = 1;
+    }
   }
+  free(ids);
+
+  if (corrupted) {
+    store_discard(store);
+    free(store);
+    return 1;
+  }
+
+  // Only a store accepted as a whole is written to
+  for (size_t offset = 0; offset < used;) {
+    struct Event* event = (struct Event*)(store->data + offset);
+    repair_event(event, store->was_clean);
+    offset += slab_size(event->rows, event->cols);
+  }
+
+  // Everything the events need outside the store is built before the first one is linked, so a failure leaves the
+  // list empty
+  size_t* shard_events = (size_t*)calloc(list->n_shards, sizeof(size_t));
+  int failed = shard_events == NULL;
+  size_t built = 0;  // end of the events whose stripes and index were built, or were being built
+  while (!failed && built < used) {
+    struct Event* event = (struct Event*)(store->data + built);
+    built += slab_size(event->rows, event->cols);
+    if (lock_shard(list, event->id) != 0) {
+      failed = 1;
+      break;
+    }
+    event->stripes = create_stripes(list, event->id, event->rows, &event->n_stripes);
+    unlock_shard(list, event->id);
+    failed = event->stripes == NULL || index_stored_reservations(event) != 0;
+    shard_events[get_shard(list, event->id) - list->shards]++;
+  }
+
+  for (size_t i = 0; !failed && i < list->n_shards; i++) {
+    failed = reserve_entries(list, &list->shards[i], shard_events[i]) != 0;
+  }
+  free(shard_events);
+
+  if (failed) {
+    // The event being built when the failure happened may hold part of its index too
+    for (size_t offset = 0; offset < built;) {
+      struct Event* event = (struct Event*)(store->data + offset);
+      free_reservation_index(event);
+      offset += slab_size(event->rows, event->cols);
+    }
+    store_discard(store);
+    free(store);
+    return 1;
+  }
+
+  list->store = store;
+  for (size_t offset = 0; offset < used;) {
+    struct Event* event = (struct Event*)(store->data + offset);
+    link_event(list, event);
+    offset += slab_size(event->rows, event->cols);
+  }
+  return 0;
+}
+
+int free_list(struct EventList* list) {
+  if (!list) return 0;
+
+  for (struct ListNode* node = list->head; node; node = node->next) {
+    struct Event* event = node->event;
+    if (event->snapshot) release_snapshot(event->snapshot);
+    free_reservation_index(event);
+  }
+
+  epoch_destroy(&list->epoch);
+  free_shards(list, list->n_shards);
+  int failed = 0;
+  if (list->store) {
+    failed = store_close(list->store);
+    free(list->store);
+  }
+  free(list);
+  return failed;
+}
+
+struct Event* get_event(struct EventList* list, unsigned int event_id) {
+  if (!list) return NULL;
+
+  struct Event* event = NULL;
+
+  // Readers only announce themselves in their own epoch record, the locks are left to the writers
+  epoch_enter(&list->epoch);
+  struct BucketTable* table = atomic_load_explicit(&get_shard(list, event_id)->table, memory_order_acquire);
+  struct BucketEntry* current =
+      atomic_load_explicit(&table->buckets[hash_id(event_id) & (table->n_buckets - 1)], memory_order_acquire);
+  while (current) {
+    if (current->node->event->id == event_id) {
+      event = current->node->event;
+      break;
+    }
+
+    current = atomic_load_explicit(&current->next, memory_order_acquire);
+  }
+  epoch_exit(&list->epoch);
+
+  return event;
 }
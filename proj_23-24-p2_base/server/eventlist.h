@@ -3,53 +3,306 @@
 
 #include <pthread.h>
 #include <stddef.h>
+#include <stdint.h>
 
+#include "epoch.h"
+#include "store.h"
 
 
+
+struct ListNode {
+  struct Event* event;
+  struct ListNode* next;
+};
+
+// Immutable copy of the seats of an event, shared by every reader of the same version
+struct SeatSnapshot {
+  _Atomic size_t refs;  // References held by the readers and by the event while it is the latest one
+  unsigned long version;
+  size_t rows;
+  size_t cols;
+  unsigned int seats[];  // Reservation id of each seat, widened to unsigned int
+};
+
+// Free seats at both ends of a range of seats in a row and the longest run of free seats inside it
+struct FreeRun {
+  unsigned int prefix;
+  unsigned int suffix;
+  unsigned int best;
+};
+
+// Segment trees over the free seats of every row and over the longest free run of each row.
+// Node 1 is the root and node i has children 2i and 2i+1, the leaves come last
+struct FreeRunIndex {
+  size_t width;              // Leaves of a row tree, the number of columns rounded up to a power of two
+  size_t row_width;          // Leaves of the tree over the rows, the number of rows rounded up to a power of two
+  struct FreeRun* runs;      // One tree of 2 * width nodes per row, protected by the stripe of the row
+  unsigned int* row_best;    // Tree of 2 * row_width nodes with the longest free run in the rows below each node
+  pthread_mutex_t row_lock;  // Protects row_best, which is shared by every stripe
+};
+
+#define RESERVATION_SEGMENTS 32  // Segment k of the reverse index holds the reservation ids from 2^k to 2^(k+1) - 1
+
+// Seats of a reservation, kept so it can be cancelled without scanning the event
+struct ReservationSeats {
+  size_t num_seats;
+  size_t seats[];
+};
+
+// Allocated from its shard's arena or the store together with its seats, which start at the next cache line.
+// Room for 4 byte seats is always reserved, so widening never moves them and untouched pages stay unmapped.
+// The rows are split in bands with a lock each, a reservation only locks the bands of its seats
 struct Event {
-  unsigned int id;            /// Event id
-  unsigned int reservations;  /// Number of reservations for the event.
+  unsigned int id;                     /// Event id
+  _Atomic(unsigned int) reservations;  /// Number of reservations for the event.
 
   size_t cols;  /// Number of columns.
   size_t rows;  /// Number of rows.
 
-  unsigned int* data;     /// Array of size rows * cols with the reservations for each seat.
-  pthread_mutex_t mutex;  // Mutex to protect the event
+  void* data;                      /// Array of size rows * cols with the reservations for each seat, see get_seat.
+  unsigned char seat_width;        /// Bytes per seat in data, 1, 2 or 4, widened as the reservation ids grow.
+  unsigned char widen_width;       // Width the seats are being widened to, 0 when no widening is in progress
+  size_t widen_next;               // Seats from this index on already have widen_width
+  _Atomic(uint64_t)* occupied;     /// Bitmap of size rows * cols with a bit set for every reserved seat.
+  _Atomic(size_t)* row_taken;      /// Number of reserved seats in each row, stored after the bitmap.
+  _Atomic(size_t) taken_seats;     /// Number of reserved seats, the free ones are rows * cols minus these.
+  struct FreeRunIndex* free_runs;  // Free runs of every row, NULL until RESERVE_BEST needs it, not kept in the store
+  _Atomic(unsigned long) version;  // Bumped by every seat write, tells whether the cached snapshot is still current
+  struct SeatSnapshot* snapshot;   // Latest snapshot taken, not kept in the store
+  pthread_mutex_t* stripes;        // Locks of the row bands, taken in increasing order, not kept in the store
+  size_t n_stripes;                // Number of row bands, at most the number of rows
+
+  // Reverse index from reservation id to its seats, not kept in the store but rebuilt from the seats when loaded
+  _Atomic(_Atomic(struct ReservationSeats*)*) reservation_index[RESERVATION_SEGMENTS];
+
+  struct ListNode node;  // Node linking the event into the list
 };
 
-struct ListNode {
-  struct Event* event;
-  struct ListNode* next;
+// Chunk of memory the events are carved from, only freed together with the list
+struct ArenaChunk {
+  struct ArenaChunk* next;
+  unsigned char* data;  // Cache line aligned start of the usable memory
+  size_t size;          // Number of usable bytes
+  size_t used;          // Number of bytes already handed out
+};
+
+// Entry of a bucket chain, owned by the bucket table it was inserted in
+struct BucketEntry {
+  struct ListNode* node;
+  _Atomic(struct BucketEntry*) next;
+};
+
+// Hash index of the nodes by event id, replaced as a whole when it grows
+struct BucketTable {
+  size_t n_buckets;             // Number of buckets, always a power of two
+  size_t used;                  // Number of entries in use, at most n_buckets
+  struct BucketEntry* entries;  // Entry pool, stored right after the buckets
+  _Atomic(struct BucketEntry*) buckets[];
 };
 
-// Linked list structure
+// Partition of the event id space with its own index and lock
+struct EventShard {
+  _Atomic(struct BucketTable*) table;  // Read without locks, old tables are reclaimed through the epoch domain
+  pthread_mutex_t mutex;               // Serializes the creation of events in the shard
+  struct ArenaChunk* chunks;           // Arena holding the events of the shard, protected by the mutex
+};
+
+// Linked list structure, indexed by event id
 struct EventList {
   struct ListNode* head;  // Head of the list
   struct ListNode* tail;  // Tail of the list
-  pthread_rwlock_t rwl;   // Mutex to protect the list
+
+  struct EventShard* shards;  // Events are spread over the shards by a hash of their id
+  size_t n_shards;
+  struct EpochDomain epoch;
+
+  pthread_rwlock_t rwl;  // Taken as a writer to link a new node and as a reader to iterate
+
+  struct EventStore* store;  // File the events are allocated from, NULL when they live in the shard arenas
+  size_t n_stripes;          // Number of row bands the events are locked by
 };
 
 /// Creates a new event list.
+/// @param n_shards Number of shards the events are spread over.
+/// @param n_stripes Number of row bands every event is locked by, events with fewer rows get one per row.
 /// @return Newly created event list, NULL on failure
-struct EventList* create_list();
+struct EventList* create_list(size_t n_shards, size_t n_stripes);
+
+/// Backs the list with a store file, loading the events it already holds.
+/// @note Must be called on an empty list, before any other thread uses it. The list is left empty on failure.
+/// @param list Event list to be backed by the store.
+/// @param path Path of the store file, created if it does not exist.
+/// @return 0 if the store was opened and every stored event is consistent, 1 otherwise.
+int open_store(struct EventList* list, const char* path);
+
+/// Locks the shard an event id belongs to.
+/// @param list Event list the shard belongs to.
+/// @param event_id Event id.
+/// @return 0 if the shard was locked successfully, 1 otherwise.
+int lock_shard(struct EventList* list, unsigned int event_id);
+
+/// Unlocks the shard an event id belongs to.
+/// @param list Event list the shard belongs to.
+/// @param event_id Event id.
+void unlock_shard(struct EventList* list, unsigned int event_id);
+
+/// Allocates an event with every seat free from the store, or from the arena of its shard without one.
+/// @note The caller must hold the lock of the event's shard. The event and its stripe locks are released together
+/// with the list.
+/// @param list Event list whose arena the event is carved from.
+/// @param event_id Event id.
+/// @param num_rows Number of rows of the event.
+/// @param num_cols Number of columns of the event.
+/// @return Newly created event, NULL on failure
+struct Event* create_event(struct EventList* list, unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Reads the reservation id of a seat.
+/// @param event Event the seat belongs to.
+/// @param index Index of the seat.
+/// @return Reservation id of the seat, 0 if it is free.
+unsigned int get_seat(const struct Event* event, size_t index);
+
+/// Writes the reservation id of a seat, widening every seat of the event first if the id does not fit.
+/// @note The caller must hold the stripe of the seat, or every stripe if the id needs widening.
+/// @param event Event the seat belongs to.
+/// @param index Index of the seat.
+/// @param reservation_id Reservation id to be stored.
+void set_seat(struct Event* event, size_t index, unsigned int reservation_id);
+
+/// Copies the reservation ids of every seat, widened to unsigned int.
+/// @note The caller must hold every stripe of the event.
+/// @param event Event to be copied.
+/// @param seats Array of size rows * cols that receives the reservation ids.
+void copy_seats(const struct Event* event, unsigned int* seats);
+
+/// Takes a snapshot of the seats, reusing the latest one if no seat changed since it was taken.
+/// @note The caller must hold every stripe of the event, they can be released before the snapshot is read.
+/// @param event Event to be copied.
+/// @return Snapshot to be released with release_snapshot, NULL on failure.
+struct SeatSnapshot* snapshot_seats(struct Event* event);
+
+/// Drops a reference to a snapshot, freeing it once no reader or event holds it.
+/// @param snapshot Snapshot returned by snapshot_seats.
+void release_snapshot(struct SeatSnapshot* snapshot);
+
+/// Tells whether a reservation id is too wide for the seats of an event.
+/// @note The caller must hold at least one stripe of the event.
+/// @param event Event the id would be written to.
+/// @param reservation_id Reservation id.
+/// @return 1 if writing the id widens every seat of the event, 0 otherwise.
+int needs_widening(const struct Event* event, unsigned int reservation_id);
+
+/// Allocates the record of a reservation's seats and the segment of the reverse index it goes in.
+/// @note Lock free, a segment allocated by two reservations at once is kept by the first one.
+/// @param event Event the reservation belongs to.
+/// @param reservation_id Id of the reservation.
+/// @param num_seats Number of seats of the reservation.
+/// @param indexes Array of seat indexes, NULL to leave the record empty with room for num_seats seats.
+/// @return Record to be published with index_reservation, NULL on failure.
+struct ReservationSeats* prepare_reservation(struct Event* event, unsigned int reservation_id, size_t num_seats,
+                                             const size_t* indexes);
+
+/// Publishes the seats of a reservation in the reverse index, where cancel finds them.
+/// @note Must be called once every seat holds the id. A reservation that is already indexed keeps its record.
+/// @param event Event the reservation belongs to.
+/// @param reservation_id Id of the reservation.
+/// @param seats Record returned by prepare_reservation, owned by the index from now on.
+void index_reservation(struct Event* event, unsigned int reservation_id, struct ReservationSeats* seats);
+
+/// Removes a reservation from the reverse index.
+/// @note Lock free, only one of several concurrent calls for the same id gets the record.
+/// @param event Event the reservation belongs to.
+/// @param reservation_id Id of the reservation.
+/// @return Record of the reservation's seats to be freed by the caller, NULL if it is not indexed.
+struct ReservationSeats* take_reservation(struct Event* event, unsigned int reservation_id);
+
+/// Counts the free seats of an event and of each of its rows.
+/// @note Lock free and without reading any seat, a reservation being claimed may be counted in some rows only.
+/// @param event Event to be counted.
+/// @param row_free Array of size event->rows that receives the free seats of each row, NULL to skip the rows.
+/// @return Number of free seats in the event.
+size_t count_free_seats(const struct Event* event, size_t* row_free);
+
+/// Finds the stripes holding the given seats.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats, at most MAX_RESERVATION_SIZE.
+/// @param indexes Array of seat indexes.
+/// @param stripes Array of size num_seats that receives the stripes, sorted and without repetitions.
+/// @return Number of stripes written to the array.
+size_t find_stripes(const struct Event* event, size_t num_seats, const size_t* indexes, size_t* stripes);
+
+/// Locks the given stripes in increasing order.
+/// @param event Event the stripes belong to.
+/// @param n_stripes Number of stripes.
+/// @param stripes Sorted array of stripes, as returned by find_stripes.
+/// @return 0 if every stripe was locked, 1 if none was.
+int lock_stripes(struct Event* event, size_t n_stripes, const size_t* stripes);
+
+/// Unlocks the given stripes.
+/// @param event Event the stripes belong to.
+/// @param n_stripes Number of stripes.
+/// @param stripes Array of stripes locked by lock_stripes.
+void unlock_stripes(struct Event* event, size_t n_stripes, const size_t* stripes);
+
+/// Locks every stripe of an event in increasing order, excluding every writer.
+/// @param event Event to be locked.
+/// @return 0 if the event was locked, 1 otherwise.
+int lock_event(struct Event* event);
+
+/// Unlocks every stripe of an event.
+/// @param event Event locked by lock_event.
+void unlock_event(struct Event* event);
+
+/// Finds and claims the first num_seats adjacent free seats in a row, trying the rows and columns in order.
+/// @note The caller must hold every stripe of the event. The free-run index is built on first use from the arena of
+/// the event's shard, the reservations made afterwards keep it up to date.
+/// @param list Event list the event belongs to.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of adjacent seats to claim, at most MAX_RESERVATION_SIZE.
+/// @param indexes Array of size num_seats that receives the indexes of the claimed seats.
+/// @return 0 if the seats were claimed, 1 if no row has enough adjacent free seats or the index could not be built.
+int claim_free_run(struct EventList* list, struct Event* event, size_t num_seats, size_t* indexes);
+
+/// Brings the free-run index up to date after the given seats were claimed.
+/// @note The caller must hold the stripes of the seats. Does nothing until the index is built.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats.
+/// @param indexes Array of seat indexes.
+void update_free_runs(struct Event* event, size_t num_seats, const size_t* indexes);
+
+/// Marks the given seats as occupied if all of them are free and no seat is repeated.
+/// @note The caller must hold the stripes of the seats, the bitmap words shared with other stripes are updated
+/// atomically. Counts the seats as taken.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats to claim, at most MAX_RESERVATION_SIZE.
+/// @param indexes Array of seat indexes.
+/// @return 0 if every seat was claimed, 1 if nothing was claimed because a seat was taken or repeated.
+int claim_seats(struct Event* event, size_t num_seats, const size_t* indexes);
+
+/// Gives back seats claimed by claim_seats that were never written.
+/// @note The caller must hold the stripes of the seats. Counts the seats as free again.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats to release.
+/// @param indexes Array of seat indexes.
+void release_seats(struct Event* event, size_t num_seats, const size_t* indexes);
 
 /// Appends a new node to the list.
 /// @param list Event list to be modified.
-/// @param data Event to be stored in the new node.
+/// @param data Event to be stored in the new node, created by create_event.
+/// @note The caller must hold the lock of the event's shard.
 /// @return 0 if the node was appended successfully, 1 otherwise.
 int append_to_list(struct EventList* list, struct Event* data);
 
-/// Removes a node from the list.
-/// @param list Event list to be modified.
-/// @return 0 if the node was removed successfully, 1 otherwise.
-void free_list(struct EventList* list);
+/// Frees the list and its events, closing the store they live in.
+/// @param list Event list to be freed.
+/// @return 0 if the list was freed and its store, if any, was synced, 1 if the store could not be synced.
+int free_list(struct EventList* list);
 
 /// Retrieves an event in the list.
+/// @note Lock free, may run concurrently with append_to_list.
 /// @param list Event list to be searched
 /// @param event_id Event id.
-/// @param from First node to be searched.
-/// @param to Last node to be searched.
 /// @return Pointer to the event if found, NULL otherwise.
-struct Event* get_event(struct EventList* list, unsigned int event_id, struct ListNode* from, struct ListNode* to);
+struct Event* get_event(struct EventList* list, unsigned int event_id);
 
 #endif  // SERVER_EVENT_LIST_H
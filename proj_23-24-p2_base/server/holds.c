@@ -0,0 +1,196 @@
+#include "holds.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common/constants.h"
+
+#define INITIAL_HOLD_BUCKETS 64
+
+// Ticks elapsed since the table was opened
+static uint64_t current_tick(const struct HoldTable* table) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t ms = (int64_t)(now.tv_sec - table->start.tv_sec) * 1000 + (now.tv_nsec - table->start.tv_nsec) / 1000000;
+  return ms < 0 ? 0 : (uint64_t)ms / HOLD_TICK_MS;
+}
+
+// Monotonic time at which the given tick starts
+static struct timespec tick_time(const struct HoldTable* table, uint64_t tick) {
+  struct timespec time = table->start;
+  uint64_t ms = tick * HOLD_TICK_MS;
+  time.tv_sec += (time_t)(ms / 1000);
+  time.tv_nsec += (long)(ms % 1000) * 1000000;
+  if (time.tv_nsec >= 1000000000) {
+    time.tv_sec++;
+    time.tv_nsec -= 1000000000;
+  }
+  return time;
+}
+
+static size_t bucket_of(const struct HoldTable* table, unsigned int hold_id) {
+  return (size_t)(hold_id * 2654435761u) & (table->n_buckets - 1);
+}
+
+// Unlinks a hold from its bucket, must be called with the table's lock held
+static void unlink_hold(struct HoldTable* table, struct Hold* hold) {
+  struct Hold** link = &table->buckets[bucket_of(table, hold->id)];
+  while (*link != hold) link = &(*link)->next;
+  *link = hold->next;
+  table->n_holds--;
+}
+
+// Doubles the number of buckets, must be called with the table's lock held
+static int grow_buckets(struct HoldTable* table) {
+  struct Hold** old_buckets = table->buckets;
+  size_t old_n_buckets = table->n_buckets;
+
+  struct Hold** buckets = (struct Hold**)calloc(2 * old_n_buckets, sizeof(struct Hold*));
+  if (!buckets) return 1;
+  table->buckets = buckets;
+  table->n_buckets = 2 * old_n_buckets;
+
+  for (size_t i = 0; i < old_n_buckets; i++) {
+    struct Hold* hold = old_buckets[i];
+    while (hold) {
+      struct Hold* next = hold->next;
+      size_t bucket = bucket_of(table, hold->id);
+      hold->next = buckets[bucket];
+      buckets[bucket] = hold;
+      hold = next;
+    }
+  }
+  free(old_buckets);
+  return 0;
+}
+
+// Expires the holds tick by tick, releasing their seats without the table's lock so confirms never wait for them
+static void* expire_loop(void* arg) {
+  struct HoldTable* table = (struct HoldTable*)arg;
+
+  pthread_mutex_lock(&table->lock);
+  while (!table->stop) {
+    if (table->wheel.n_timers == 0) {
+      pthread_cond_wait(&table->cond, &table->lock);
+      continue;
+    }
+
+    struct timespec deadline = tick_time(table, table->wheel.now);
+    pthread_cond_timedwait(&table->cond, &table->lock, &deadline);
+    if (table->stop) break;
+
+    struct Timer* fired = timer_wheel_advance(&table->wheel, current_tick(table));
+    for (struct Timer* timer = fired; timer; timer = timer->next) {
+      unlink_hold(table, (struct Hold*)timer);
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    while (fired) {
+      struct Timer* next = fired->next;
+      table->expire((struct Hold*)fired);
+      fired = next;
+    }
+    pthread_mutex_lock(&table->lock);
+  }
+  pthread_mutex_unlock(&table->lock);
+  return NULL;
+}
+
+int hold_table_open(struct HoldTable* table, void (*expire)(struct Hold* hold)) {
+  table->buckets = (struct Hold**)calloc(INITIAL_HOLD_BUCKETS, sizeof(struct Hold*));
+  if (!table->buckets) return 1;
+  table->n_buckets = INITIAL_HOLD_BUCKETS;
+  table->n_holds = 0;
+  table->next_id = 1;
+  table->stop = 0;
+  table->expire = expire;
+  clock_gettime(CLOCK_MONOTONIC, &table->start);
+  timer_wheel_init(&table->wheel, 0);
+
+  // The deadlines are computed from the monotonic clock, so the condition must wait on it too
+  pthread_condattr_t attr;
+  if (pthread_condattr_init(&attr) != 0) {
+    free(table->buckets);
+    return 1;
+  }
+  int failed = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0 || pthread_cond_init(&table->cond, &attr) != 0;
+  pthread_condattr_destroy(&attr);
+  if (failed) {
+    free(table->buckets);
+    return 1;
+  }
+
+  if (pthread_mutex_init(&table->lock, NULL) != 0) {
+    pthread_cond_destroy(&table->cond);
+    free(table->buckets);
+    return 1;
+  }
+  if (pthread_create(&table->expirer, NULL, expire_loop, table) != 0) {
+    pthread_mutex_destroy(&table->lock);
+    pthread_cond_destroy(&table->cond);
+    free(table->buckets);
+    return 1;
+  }
+  return 0;
+}
+
+void hold_table_close(struct HoldTable* table) {
+  pthread_mutex_lock(&table->lock);
+  table->stop = 1;
+  pthread_cond_signal(&table->cond);
+  pthread_mutex_unlock(&table->lock);
+  pthread_join(table->expirer, NULL);
+
+  // No hold outlives the server, so nothing that was never confirmed is left claimed
+  struct Timer* left = timer_wheel_drain(&table->wheel);
+  while (left) {
+    struct Timer* next = left->next;
+    table->expire((struct Hold*)left);
+    left = next;
+  }
+
+  free(table->buckets);
+  pthread_mutex_destroy(&table->lock);
+  pthread_cond_destroy(&table->cond);
+}
+
+unsigned int hold_add(struct HoldTable* table, struct Hold* hold, unsigned int ttl_ms) {
+  pthread_mutex_lock(&table->lock);
+  if (table->n_holds >= table->n_buckets && grow_buckets(table) != 0) {
+    pthread_mutex_unlock(&table->lock);
+    return 0;
+  }
+
+  hold->id = table->next_id++;
+  if (table->next_id == 0) table->next_id = 1;
+  size_t bucket = bucket_of(table, hold->id);
+  hold->next = table->buckets[bucket];
+  table->buckets[bucket] = hold;
+  table->n_holds++;
+
+  // An idle wheel is moved to the current tick first, so the expiry thread has no empty ticks to walk through
+  uint64_t tick = current_tick(table);
+  int was_empty = table->wheel.n_timers == 0;
+  if (was_empty) timer_wheel_advance(&table->wheel, tick);
+  timer_wheel_add(&table->wheel, &hold->timer, tick + (ttl_ms + HOLD_TICK_MS - 1) / HOLD_TICK_MS);
+
+  if (was_empty) pthread_cond_signal(&table->cond);
+  unsigned int hold_id = hold->id;
+  pthread_mutex_unlock(&table->lock);
+  return hold_id;
+}
+
+struct Hold* hold_take(struct HoldTable* table, unsigned int hold_id, unsigned int event_id) {
+  pthread_mutex_lock(&table->lock);
+  struct Hold* hold = table->buckets[bucket_of(table, hold_id)];
+  while (hold && hold->id != hold_id) hold = hold->next;
+
+  if (hold && hold->event_id == event_id) {
+    unlink_hold(table, hold);
+    timer_wheel_remove(&table->wheel, &hold->timer);
+  } else {
+    hold = NULL;
+  }
+  pthread_mutex_unlock(&table->lock);
+  return hold;
+}
@@ -0,0 +1,62 @@
+#ifndef SERVER_HOLDS_H
+#define SERVER_HOLDS_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "timerwheel.h"
+
+// Seats claimed for a limited time, released when the timer fires unless the hold was confirmed first
+struct Hold {
+  struct Timer timer;  // First member, so a fired timer is its hold
+  unsigned int id;
+  unsigned int event_id;
+  struct Event* event;
+  struct Hold* next;  // Next hold in the same bucket
+  size_t num_seats;
+  size_t seats[];  // Indexes of the claimed seats
+};
+
+// Holds indexed by id, expired by a single thread driving a timer wheel
+struct HoldTable {
+  pthread_mutex_t lock;  // Protects everything below, never held while the seats of a hold are released
+  pthread_cond_t cond;   // Signaled when the first hold is added or the table is closed
+  struct TimerWheel wheel;
+  struct Hold** buckets;  // Chains of holds by id, the number of buckets is a power of two
+  size_t n_buckets;
+  size_t n_holds;
+  unsigned int next_id;
+  struct timespec start;  // Monotonic time of tick 0
+  int stop;
+
+  void (*expire)(struct Hold* hold);  // Releases the seats of an expired hold and frees it
+  pthread_t expirer;
+};
+
+/// Initializes an empty table and starts its expiry thread.
+/// @param table Table to be initialized.
+/// @param expire Called without the table's lock for every hold that expires, which it then owns.
+/// @return 0 if the table was initialized, 1 otherwise.
+int hold_table_open(struct HoldTable* table, void (*expire)(struct Hold* hold));
+
+/// Stops the expiry thread and expires every hold left.
+/// @param table Table to be closed.
+void hold_table_close(struct HoldTable* table);
+
+/// Adds a hold that expires after the given time.
+/// @note Constant time, the expiry thread only wakes for it if the table was empty.
+/// @param table Table the hold is added to.
+/// @param hold Hold with its event and seats set, owned by the table until taken or expired.
+/// @param ttl_ms Time in milliseconds until the hold expires, rounded up to a whole tick.
+/// @return Id given to the hold, 0 on failure.
+unsigned int hold_add(struct HoldTable* table, struct Hold* hold, unsigned int ttl_ms);
+
+/// Removes a hold that has not expired yet, cancelling its timer.
+/// @param table Table the hold was added to.
+/// @param hold_id Id returned by hold_add.
+/// @param event_id Event the hold must belong to.
+/// @return The hold, now owned by the caller, NULL if no such hold is pending.
+struct Hold* hold_take(struct HoldTable* table, unsigned int hold_id, unsigned int event_id);
+
+#endif  // SERVER_HOLDS_H
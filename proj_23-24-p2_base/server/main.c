@@ -8,6 +8,9 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <signal.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <time.h>
 
 #include "common/constants.h"
 #include "common/io.h"
@@ -34,7 +37,8 @@ struct Queue{
     pthread_mutex_t remove_from_queue_lock;
     pthread_cond_t remove_from_queue_condvar;
 
-    
+    // Set once no more clients are given out
+    atomic_int closed;
 };
 
 // Struct that represents a client session
@@ -45,12 +49,25 @@ struct Session {
   char resp_pipe_path[MAX_PIPE_PATH_NAME];
 };
 
+// Struct that represents a session being served by a worker
+struct ActiveSession {
+  struct Session* session;
+  int req_pipe;
+  int resp_pipe;              // -1 until the client opens the pipe to read from it
+  int code;                   // Op code of the request waiting for its state access, 0 if none
+  struct timespec ready;      // When the state access of that request completes
+  struct Response response;   // What the session was answered and did not read yet
+};
+
 struct Queue pc_buffer;
 
+// Set by SIGTERM or SIGINT, the server then stops taking sessions and closes the state
+volatile sig_atomic_t stop_server = 0;
+
 // Function that creates a queue of client requests
 int create_queue(struct Queue* queue){
-    // Allocates memory for the actual queue of clients
-    void** buffer = malloc(MAX_SESSION_COUNT * sizeof(void*));
+    // Allocates memory for the actual queue of clients, every slot starts empty
+    void** buffer = calloc(MAX_SESSION_COUNT, sizeof(void*));
 
     if(buffer == NULL){
         printf("Failed to allocate memory for buffer\n");
@@ -59,6 +76,7 @@ int create_queue(struct Queue* queue){
    
     queue->queue_buffer = buffer;
     queue->queue_size = 0;
+    atomic_init(&queue->closed, 0);
 
     // Initializes the locks
     if(pthread_mutex_init(&queue->buffer_lock,NULL) != 0 || pthread_mutex_init(&queue->size_lock,NULL) != 0 || 
@@ -127,12 +145,19 @@ void* remove_element(struct Queue* queue){
     pthread_mutex_lock(&queue->size_lock);
 
     // While its empty
-    while(queue->queue_size == 0){
+    while(queue->queue_size == 0 && !atomic_load(&queue->closed)){
         pthread_mutex_unlock(&queue->size_lock);
         pthread_cond_wait(&queue->remove_from_queue_condvar,&queue->remove_from_queue_lock);
         pthread_mutex_lock(&queue->size_lock);
     }
 
+    // A closed queue gives no client out
+    if(atomic_load(&queue->closed)){
+        pthread_mutex_unlock(&queue->size_lock);
+        pthread_mutex_unlock(&queue->remove_from_queue_lock);
+        return NULL;
+    }
+
     // Locks the queue buffer 
     pthread_mutex_lock(&queue->buffer_lock);
 
@@ -159,9 +184,54 @@ void* remove_element(struct Queue* queue){
     return element;
 
 }
+// Function that removes a client from the queue if there is one, without waiting
+void* try_remove_element(struct Queue* queue){
+
+    pthread_mutex_lock(&queue->remove_from_queue_lock);
+    pthread_mutex_lock(&queue->size_lock);
+
+    if(queue->queue_size == 0 || atomic_load(&queue->closed)){
+        pthread_mutex_unlock(&queue->size_lock);
+        pthread_mutex_unlock(&queue->remove_from_queue_lock);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&queue->buffer_lock);
+    pthread_mutex_unlock(&queue->remove_from_queue_lock);
+    void* element = NULL;
+    for (int i = 0; i < MAX_SESSION_COUNT; ++i) {
+        if (queue->queue_buffer[i] != NULL) {
+            element = queue->queue_buffer[i];
+            queue->queue_buffer[i] = NULL;
+            --queue->queue_size;
+            break;
+        }
+    }
+    pthread_cond_broadcast(&queue->add_to_queue_condvar);
+    pthread_mutex_unlock(&queue->size_lock);
+    pthread_mutex_unlock(&queue->buffer_lock);
+
+    return element;
+}
+
+// Function that closes the queue, waking up every thread waiting for a client
+void close_queue(struct Queue* queue){
+    pthread_mutex_lock(&queue->remove_from_queue_lock);
+    pthread_mutex_lock(&queue->size_lock);
+    atomic_store(&queue->closed, 1);
+    pthread_cond_broadcast(&queue->remove_from_queue_condvar);
+    pthread_mutex_unlock(&queue->size_lock);
+    pthread_mutex_unlock(&queue->remove_from_queue_lock);
+}
+
 // Function that destroys the queue
 void destroy_queue(struct Queue* queue){
     pthread_mutex_destroy(&queue->buffer_lock);
+
+    // Clients no thread took are dropped
+    for (int i = 0; i < MAX_SESSION_COUNT; ++i) {
+        free(queue->queue_buffer[i]);
+    }
     free(queue -> queue_buffer);
 
     pthread_mutex_destroy(&queue->size_lock);
@@ -174,7 +244,61 @@ void destroy_queue(struct Queue* queue){
 
 }
 
-// Function that retrieves a client from the queue and processes its request
+// Function that opens the request pipe of a new session and queues its id, without waiting for the client
+int start_session(struct Session* session, struct ActiveSession* active){
+  active->session = session;
+  active->resp_pipe = -1;
+  active->code = 0;
+  active->response = (struct Response){0};
+
+  // The read end opens without a writer, then reads wait again, a request is read whole once it starts arriving
+  active->req_pipe = open(session->req_pipe_path, O_RDONLY | O_NONBLOCK);
+
+  if(active->req_pipe < 0 || fcntl(active->req_pipe, F_SETFL, fcntl(active->req_pipe, F_GETFL) & ~O_NONBLOCK) < 0 ||
+  queue_response(&active->response, &session->session_id, sizeof(int))){
+    if(active->req_pipe >= 0) close(active->req_pipe);
+    free_response(&active->response);
+    unlink(session->req_pipe_path);
+    unlink(session->resp_pipe_path);
+    free(session);
+    return 1;
+  }
+  return 0;
+}
+
+// Function that opens the response pipe of a session once the client opened it to read, it is left at -1 until then
+int open_response_pipe(struct ActiveSession* active){
+  active->resp_pipe = open(active->session->resp_pipe_path, O_WRONLY | O_NONBLOCK);
+
+  // Without a reader yet the open fails with ENXIO and is tried again later
+  if(active->resp_pipe < 0 && errno != ENXIO) return 1;
+  return 0;
+}
+
+// Function that ends a session and closes its pipes, the last session of the worker takes its place
+void end_session(struct ActiveSession* active, size_t* n_active, size_t index){
+  struct Session* session = active[index].session;
+
+  close(active[index].req_pipe);
+  if(active[index].resp_pipe >= 0) close(active[index].resp_pipe);
+  free_response(&active[index].response);
+
+  // destroy pipes used to communicate with the client
+  unlink(session->req_pipe_path);
+  unlink(session->resp_pipe_path);
+  free(session);
+
+  active[index] = active[--(*n_active)];
+}
+
+// Function that gives the milliseconds left until a time, rounded up
+int ms_until(const struct timespec* time, const struct timespec* now){
+  long long ns = (long long)(time->tv_sec - now->tv_sec) * 1000000000LL + (time->tv_nsec - now->tv_nsec);
+  if(ns <= 0) return 0;
+  return (int)((ns + 999999) / 1000000);
+}
+
+// Function that retrieves clients from the queue and processes their requests
 void* read_session_request(){
   sigset_t set;
 
@@ -184,58 +308,121 @@ void* read_session_request(){
   // Threads that are not the main ignore this signal
   if(pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) return (void*)1;
 
+  // A worker serves several sessions, a request waits out the latency of its state access while the others are
+  // served, and only then runs. Pipes are opened and answers written without waiting, so a client that is slow to
+  // open its pipes or to read its answers only holds up its own session
+  struct ActiveSession active[MAX_WORKER_SESSIONS];
+  struct pollfd fds[MAX_WORKER_SESSIONS];
+  size_t n_active = 0;
+
   while(1){
-    int resp_pipe, req_pipe;
-    struct Session* session = (struct Session*)remove_element(&pc_buffer);
+    // A stopping server ends the sessions it serves
+    if(atomic_load(&pc_buffer.closed)){
+      while(n_active > 0) end_session(active, &n_active, n_active - 1);
+      return (void*)0;
+    }
 
-    // Opens the request and response pipes
-    req_pipe = open(session->req_pipe_path, O_RDONLY);
-    resp_pipe = open(session->resp_pipe_path,O_WRONLY);
+    // An idle worker waits for a session, a busy one only takes the sessions already waiting
+    struct Session* session = NULL;
+    if(n_active == 0){
+      session = (struct Session*)remove_element(&pc_buffer);
+      if(session == NULL) continue;
+    } else if(n_active < MAX_WORKER_SESSIONS){
+      session = (struct Session*)try_remove_element(&pc_buffer);
+    }
+    if(session != NULL && start_session(session, &active[n_active]) == 0) n_active++;
+
+    // Processes the requests whose access completed, writes what is left of the answers and polls the sessions
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int timeout = SESSION_POLL_MS;
+
+    for(size_t i = 0; i < n_active;){
+      fds[i].fd = -1;  // A negative fd is skipped by poll
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+
+      // A client that did not open its response pipe yet is tried again on the next pass
+      if(active[i].resp_pipe < 0){
+        if(open_response_pipe(&active[i])){
+          end_session(active, &n_active, i);
+          continue;
+        }
+        if(active[i].resp_pipe < 0){
+          i++;
+          continue;
+        }
+      }
 
+      if(active[i].code != 0){
+        int remaining = ms_until(&active[i].ready, &now);
 
-    if(resp_pipe < 0 || req_pipe < 0){
-      return (void*)1;
-    }
+        if(remaining > 0){
+          if(remaining < timeout) timeout = remaining;
+          i++;
+          continue;
+        }
+
+        int code = active[i].code;
+        active[i].code = 0;
+        if(process_issued_request(code, active[i].req_pipe, &active[i].response)){
+          end_session(active, &n_active, i);
+          continue;
+        }
+      }
 
-    char *response_message;
+      if(write_response(active[i].resp_pipe, &active[i].response)){
+        end_session(active, &n_active, i);
+        continue;
+      }
 
+      // A session with an answer left waits for the client to read it, the others for their next request
+      if(active[i].response.size > 0){
+        fds[i].fd = active[i].resp_pipe;
+        fds[i].events = POLLOUT;
+      } else {
+        fds[i].fd = active[i].req_pipe;
+      }
+      i++;
+    }
+    if(n_active == 0) continue;
 
-    response_message = malloc(sizeof(int));
-    memcpy(response_message,&session->session_id,sizeof(int));
+    if(poll(fds, (nfds_t)n_active, timeout) < 0){
+      if(errno == EINTR) continue;
 
-    // Sends the session id to the client
-    if(write(resp_pipe,response_message,sizeof(int)) < 0){
-      close(resp_pipe);
-      close(req_pipe);
-      unlink(session->req_pipe_path);
-      unlink(session->resp_pipe_path);
-      return (void*)1;
+      // The sessions can no longer be served, so they are ended instead of left open
+      while(n_active > 0) end_session(active, &n_active, n_active - 1);
+      continue;
     }
 
-    free(response_message);
+    // Goes backwards, so a session ending is replaced by one that was already handled
+    for(size_t i = n_active; i-- > 0;){
+      if(fds[i].revents == 0) continue;
 
+      // The pipe has room again, or it has no reader left and the write fails
+      if(fds[i].events & POLLOUT){
+        if(write_response(active[i].resp_pipe, &active[i].response)) end_session(active, &n_active, i);
+        continue;
+      }
 
-    while (1) {
       char op_code[OP_CODE_LEN];
 
-      // Reads the op code sent from the client
-      if(read(req_pipe,&op_code,OP_CODE_LEN) <= 0) break;
+      // Reads the op code sent from the client, the session ends with the pipe
+      if(read(active[i].req_pipe, &op_code, OP_CODE_LEN) <= 0){
+        end_session(active, &n_active, i);
+        continue;
+      }
 
       int code = get_code(op_code);
-      // process the request from the client
-      if(process_request(code,req_pipe,resp_pipe)){
-        close(resp_pipe);
-        close(req_pipe);
-        unlink(session->req_pipe_path);
-        unlink(session->resp_pipe_path);
-        return (void*)1;
-      } 
 
+      // Quitting ends the session like a request that fails
+      if(issue_state_access(code, &active[i].ready)){
+        active[i].code = code;
+      } else if(process_request(code, active[i].req_pipe, &active[i].response) ||
+      write_response(active[i].resp_pipe, &active[i].response)){
+        end_session(active, &n_active, i);
+      }
     }
-    // destroy pipes used to communicate with the client
-    unlink(session->req_pipe_path);
-    unlink(session->resp_pipe_path);
-
   }
   return (void*)0;
 }
@@ -248,36 +435,130 @@ void sigusr1_handler(int signal){
 
 }
 
+// Function that asks the server to stop, it stops once the client it is waiting for is interrupted
+void stop_handler(int signal){
+  (void)signal;
+  stop_server = 1;
+}
+
 
 int main(int argc, char* argv[]) {
+  char* endptr;
+  struct EmsConfig config = {.delay_us = STATE_ACCESS_DELAY_US,
+                             .n_shards = DEFAULT_SHARD_COUNT,
+                             .n_stripes = DEFAULT_STRIPE_COUNT,
+                             .store_path = NULL,
+                             .wal_path = NULL,
+                             .wal_flush_us = DEFAULT_WAL_FLUSH_US,
+                             .wal_batch_size = DEFAULT_WAL_BATCH_SIZE};
+  int opt;
+
+  // Parses the options given before the pipe path
+  while ((opt = getopt(argc, argv, "s:r:f:w:i:b:")) != -1) {
+    switch (opt) {
+      case 's': {
+        unsigned long int shards = strtoul(optarg, &endptr, 10);
+
+        if (*endptr != '\0' || shards == 0 || shards > MAX_SHARD_COUNT) {
+          fprintf(stderr, "Invalid shard count, must be between 1 and %d\n", MAX_SHARD_COUNT);
+          return 1;
+        }
+
+        config.n_shards = (size_t)shards;
+        break;
+      }
+
+      case 'r': {
+        unsigned long int stripes = strtoul(optarg, &endptr, 10);
+
+        if (*endptr != '\0' || stripes == 0 || stripes > MAX_STRIPE_COUNT) {
+          fprintf(stderr, "Invalid stripe count, must be between 1 and %d\n", MAX_STRIPE_COUNT);
+          return 1;
+        }
+
+        config.n_stripes = (size_t)stripes;
+        break;
+      }
+
+      case 'f':
+        config.store_path = optarg;
+        break;
+
+      case 'w':
+        config.wal_path = optarg;
+        break;
+
+      case 'i': {
+        unsigned long int interval = strtoul(optarg, &endptr, 10);
+
+        if (*endptr != '\0' || interval > MAX_WAL_FLUSH_US) {
+          fprintf(stderr, "Invalid flush interval, must be at most %d microseconds\n", MAX_WAL_FLUSH_US);
+          return 1;
+        }
+
+        config.wal_flush_us = (unsigned int)interval;
+        break;
+      }
+
+      case 'b': {
+        unsigned long int batch = strtoul(optarg, &endptr, 10);
+
+        if (*endptr != '\0' || batch == 0 || batch > MAX_WAL_BATCH_SIZE) {
+          fprintf(stderr, "Invalid batch size, must be between 1 and %d\n", MAX_WAL_BATCH_SIZE);
+          return 1;
+        }
+
+        config.wal_batch_size = (size_t)batch;
+        break;
+      }
+
+      default:
+        fprintf(stderr,
+                "Usage: %s [-s shards] [-r stripes] [-f store_file] [-w wal_file [-i flush_us] [-b batch]] "
+                "<pipe_path> [delay]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
   // Checks for insuficient arguments
-  if (argc < 2 || argc > 3) {
-    fprintf(stderr, "Usage: %s\n <pipe_path> [delay]\n", argv[0]);
+  if (argc - optind < 1 || argc - optind > 2) {
+    fprintf(stderr,
+            "Usage: %s [-s shards] [-r stripes] [-f store_file] [-w wal_file [-i flush_us] [-b batch]] "
+            "<pipe_path> [delay]\n",
+            argv[0]);
     return 1;
   }
 
-  char* endptr;
-  unsigned int state_access_delay_us = STATE_ACCESS_DELAY_US;
-  if (argc == 3) {
-    unsigned long int delay = strtoul(argv[2], &endptr, 10);
+  char* pipe_path = argv[optind];
+
+  if (argc - optind == 2) {
+    unsigned long int delay = strtoul(argv[optind + 1], &endptr, 10);
 
     if (*endptr != '\0' || delay > UINT_MAX) {
       fprintf(stderr, "Invalid delay value or value too large\n");
       return 1;
     }
 
-    state_access_delay_us = (unsigned int)delay;
+    config.delay_us = (unsigned int)delay;
   }
 
-  if (ems_init(state_access_delay_us)) {
+  // Only the main thread takes the stop signals, every thread created until they are unblocked inherits them blocked
+  sigset_t stop_signals;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGTERM);
+  sigaddset(&stop_signals, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+
+  if (ems_init(&config)) {
     fprintf(stderr, "Failed to initialize EMS\n");
     return 1;
   }
 
-  unlink(argv[1]);
+  unlink(pipe_path);
 
   // creates the server pipe
-  if(mkfifo(argv[1],0666) < 0) return 1;
+  if(mkfifo(pipe_path,0666) < 0) return 1;
 
   // creates the producer/consumer buffer
   if(create_queue(&pc_buffer)) return 1;
@@ -288,25 +569,37 @@ int main(int argc, char* argv[]) {
   // changes the handling for the SIGUSR1 signal
   signal(SIGUSR1, sigusr1_handler);
 
+  // A client that closes its response pipe makes the write fail instead of stopping the server
+  signal(SIGPIPE, SIG_IGN);
+
   // Creates all worker threads
   for(int i = 0; i < MAX_SESSION_COUNT; i++){
     if(pthread_create(&thread_list[i],NULL,read_session_request,NULL) != 0){
       destroy_queue(&pc_buffer);
       ems_terminate();
-      unlink(argv[1]);
+      unlink(pipe_path);
       return 1;
     }
   }
+
+  // Without SA_RESTART, so a stop signal interrupts the wait for the next client
+  struct sigaction stop_action = {.sa_handler = stop_handler, .sa_flags = 0};
+  sigemptyset(&stop_action.sa_mask);
+  sigaction(SIGTERM, &stop_action, NULL);
+  sigaction(SIGINT, &stop_action, NULL);
+  pthread_sigmask(SIG_UNBLOCK, &stop_signals, NULL);
+
   // starts the session counter to give clients their session id numbers
   int session_counter = 0;
   
 
-  while (1) {
+  while (!stop_server) {
 
     int register_pipe;
 
     // Opens the server pipe 
-    if((register_pipe = open(argv[1],O_RDONLY)) < 0){
+    if((register_pipe = open(pipe_path,O_RDONLY)) < 0){
+      if(errno == EINTR) continue;
       break;
     }
 
@@ -342,9 +635,14 @@ int main(int argc, char* argv[]) {
 
   }
 
-  //TODO: Close Server
+  // The workers end their sessions and stop before the state is closed, so no request runs while it is
+  close_queue(&pc_buffer);
+  for(int i = 0; i < MAX_SESSION_COUNT; i++){
+    pthread_join(thread_list[i], NULL);
+  }
+
   destroy_queue(&pc_buffer);
   ems_terminate();
-  unlink(argv[1]);
+  unlink(pipe_path);
   return 0;
 }
\ No newline at end of file
@@ -1,29 +1,41 @@
+#include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #include "common/io.h"
 #include "eventlist.h"
+#include "holds.h"
+#include "operations.h"
+#include "wal.h"
 #include "common/constants.h"
 
 static struct EventList* event_list = NULL;
+static struct Wal* event_log = NULL;
+static struct HoldTable* seat_holds = NULL;
 static unsigned int state_access_delay_us = 0;
+static _Thread_local int access_completed = 0;  // Set while a request whose state access was waited for is processed
 
 
 /// Gets the event with the given ID from the state.
-/// @note Will wait to simulate a real system accessing a costly memory resource.
+/// @note Will wait to simulate a real system accessing a costly memory resource, unless the worker already waited
+/// for the access while serving other sessions.
 /// @param event_id The ID of the event to get.
-/// @param from First node to be searched.
-/// @param to Last node to be searched.
 /// @return Pointer to the event if found, NULL otherwise.
-static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode* from, struct ListNode* to) {
-  struct timespec delay = {0, state_access_delay_us * 1000};
-  nanosleep(&delay, NULL);  // Should not be removed
+static struct Event* get_event_with_delay(unsigned int event_id) {
+  if (access_completed) {
+    access_completed = 0;
+  } else {
+    struct timespec delay = {0, state_access_delay_us * 1000};
+    nanosleep(&delay, NULL);  // Should not be removed
+  }
 
-  return get_event(event_list, event_id, from, to);
+  return get_event(event_list, event_id);
 }
 
 /// Gets the index of a seat.
@@ -34,16 +46,210 @@ static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode
 /// @return Index of the seat.
 static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
 
-int ems_init(unsigned int delay_us) {
+/// Applies a logged create, reservation or cancel to the state while the log is replayed.
+/// @note Requests the state already holds, because the store kept them, are skipped.
+/// @param record Logged request.
+/// @param seats Seat indexes of a reservation.
+/// @return 0 if the request was applied or skipped, 1 if it does not fit the state.
+static int replay_record(const struct WalRecord* record, const uint64_t* seats) {
+  struct Event* event = get_event(event_list, record->event_id);
+
+  if (record->type == WAL_CREATE) {
+    if (event != NULL) return 0;
+
+    if (lock_shard(event_list, record->event_id) != 0) return 1;
+    event = create_event(event_list, record->event_id, record->num_rows, record->num_cols);
+    int result = event == NULL || append_to_list(event_list, event) != 0;
+    unlock_shard(event_list, record->event_id);
+    return result;
+  }
+
+  if ((record->type != WAL_RESERVE && record->type != WAL_CANCEL) || event == NULL ||
+      record->num_seats > MAX_RESERVATION_SIZE || record->reservation_id == 0)
+    return 1;
+  for (size_t i = 0; i < record->num_seats; i++) {
+    if (seats[i] >= event->rows * event->cols) return 1;
+  }
+
+  // Only the seats that still hold the id are cleared, the others were already cleared or reserved again
+  if (record->type == WAL_CANCEL) {
+    free(take_reservation(event, record->reservation_id));
+    for (size_t i = 0; i < record->num_seats; i++) {
+      size_t index = (size_t)seats[i];
+      if (get_seat(event, index) != record->reservation_id) continue;
+      set_seat(event, index, 0);
+      release_seats(event, 1, &index);
+    }
+    return 0;
+  }
+
+  // Reservations on different stripes may be logged out of id order, so a reservation counts as applied by the
+  // seats that already hold its id rather than by the ids handed out. A seat holding another id was cancelled and
+  // reserved again later in the log
+  size_t indexes[MAX_RESERVATION_SIZE];
+  size_t n_missing = 0;
+  for (size_t i = 0; i < record->num_seats; i++) {
+    if (get_seat(event, (size_t)seats[i]) == 0) indexes[n_missing++] = (size_t)seats[i];
+  }
+
+  if (claim_seats(event, n_missing, indexes) != 0) return 1;
+  for (size_t i = 0; i < n_missing; i++) {
+    set_seat(event, indexes[i], record->reservation_id);
+  }
+  if (record->reservation_id > event->reservations) event->reservations = record->reservation_id;
+
+  // The record built from the store may have missed seats the reservation had not written yet
+  size_t n_held = 0;
+  for (size_t i = 0; i < record->num_seats; i++) {
+    if (get_seat(event, (size_t)seats[i]) == record->reservation_id) indexes[n_held++] = (size_t)seats[i];
+  }
+  struct ReservationSeats* held = prepare_reservation(event, record->reservation_id, n_held, indexes);
+  if (held == NULL) return 1;
+  free(take_reservation(event, record->reservation_id));
+  index_reservation(event, record->reservation_id, held);
+  return 0;
+}
+
+/// Gives a new reservation id to claimed seats, writes it to them and logs the reservation.
+/// @note Called with the stripes of the seats held, they are released before waiting for the log.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats.
+/// @param indexes Array of seat indexes, claimed by the caller.
+/// @param n_stripes Number of stripes held.
+/// @param stripes Stripes held, as returned by find_stripes.
+/// @return 0 if the reservation was written and is durable, 1 otherwise.
+static int write_reservation(struct Event* event, size_t num_seats, const size_t* indexes, size_t n_stripes,
+                             const size_t* stripes) {
+  unsigned int reservation_id = atomic_fetch_add(&event->reservations, 1) + 1;
+
+  // The record for the reverse index is allocated first, so nothing can fail once the seats are written
+  struct ReservationSeats* reserved = prepare_reservation(event, reservation_id, num_seats, indexes);
+  if (reserved == NULL) {
+    fprintf(stderr, "Error allocating memory for seats\n");
+    release_seats(event, num_seats, indexes);
+    update_free_runs(event, num_seats, indexes);
+    unlock_stripes(event, n_stripes, stripes);
+    return 1;
+  }
+
+  // Widening rewrites every seat, so the whole event is locked instead. The claimed seats stay out of reach of the
+  // other reservations meanwhile, and none of them has been written yet
+  int whole_event = needs_widening(event, reservation_id);
+  if (whole_event) {
+    unlock_stripes(event, n_stripes, stripes);
+    if (lock_event(event) != 0) {
+      fprintf(stderr, "Error locking mutex\n");
+      // The seats are given back under their stripes again, if even those cannot be locked they stay claimed
+      if (lock_stripes(event, n_stripes, stripes) == 0) {
+        release_seats(event, num_seats, indexes);
+        update_free_runs(event, num_seats, indexes);
+        unlock_stripes(event, n_stripes, stripes);
+      }
+      free(reserved);
+      return 1;
+    }
+  }
+
+  for (size_t i = 0; i < num_seats; i++) {
+    set_seat(event, indexes[i], reservation_id);
+  }
+
+  uint64_t position = 0;
+  if (event_log != NULL) {
+    uint64_t seats[MAX_RESERVATION_SIZE];
+    for (size_t i = 0; i < num_seats; i++) {
+      seats[i] = indexes[i];
+    }
+    struct WalRecord record = {
+        .type = WAL_RESERVE, .event_id = event->id, .reservation_id = reservation_id, .num_seats = num_seats};
+    position = wal_append(event_log, &record, seats);
+  }
+  index_reservation(event, reservation_id, reserved);
+
+  if (whole_event) {
+    unlock_event(event);
+  } else {
+    unlock_stripes(event, n_stripes, stripes);
+  }
+
+  if (event_log != NULL && (position == 0 || wal_commit(event_log, position) != 0)) {
+    fprintf(stderr, "Error writing to the write-ahead log\n");
+    return 1;
+  }
+  return 0;
+}
+
+/// Releases the seats of a hold that expired, or that was left when the server stopped.
+/// @note Runs on the expiry thread and only locks the stripes of the hold's seats.
+/// @param hold Expired hold, freed here.
+static void expire_hold(struct Hold* hold) {
+  size_t stripes[MAX_RESERVATION_SIZE];
+  size_t n_stripes = find_stripes(hold->event, hold->num_seats, hold->seats, stripes);
+  if (lock_stripes(hold->event, n_stripes, stripes) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    free(hold);
+    return;
+  }
+
+  release_seats(hold->event, hold->num_seats, hold->seats);
+  update_free_runs(hold->event, hold->num_seats, hold->seats);
+  unlock_stripes(hold->event, n_stripes, stripes);
+  free(hold);
+}
+
+int ems_init(const struct EmsConfig* config) {
   if (event_list != NULL) {
     fprintf(stderr, "EMS state has already been initialized\n");
     return 1;
   }
 
-  event_list = create_list();
-  state_access_delay_us = delay_us;
+  event_list = create_list(config->n_shards, config->n_stripes);
+  state_access_delay_us = config->delay_us;
+
+  if (event_list == NULL) return 1;
+
+  // The events left in the store by the previous server are served again without replaying their requests
+  if (config->store_path != NULL && open_store(event_list, config->store_path) != 0) {
+    fprintf(stderr, "Failed to open event store %s\n", config->store_path);
+    free_list(event_list);
+    event_list = NULL;
+    return 1;
+  }
+
+  // Whatever the store does not hold yet is rebuilt from the log. A store that was closed cleanly holds every record
+  // of the log it was written with, which is then not replayed at all
+  if (config->wal_path != NULL) {
+    struct EventStore* store = event_list->store;
+    int replayed = store == NULL || store->created || !store->was_clean;
+    event_log = (struct Wal*)malloc(sizeof(struct Wal));
+    if (event_log == NULL || wal_open(event_log, config->wal_path, config->wal_flush_us, config->wal_batch_size,
+                                      replayed ? replay_record : NULL) != 0) {
+      fprintf(stderr, "Failed to replay write-ahead log %s\n", config->wal_path);
+      free(event_log);
+      event_log = NULL;
+      free_list(event_list);
+      event_list = NULL;
+      return 1;
+    }
+  }
+
+  // Holds are never logged, a restarted server starts without any
+  seat_holds = (struct HoldTable*)malloc(sizeof(struct HoldTable));
+  if (seat_holds == NULL || hold_table_open(seat_holds, expire_hold) != 0) {
+    fprintf(stderr, "Failed to start the hold timers\n");
+    free(seat_holds);
+    seat_holds = NULL;
+    if (event_log != NULL) {
+      wal_close(event_log, 0);
+      free(event_log);
+      event_log = NULL;
+    }
+    free_list(event_list);
+    event_list = NULL;
+    return 1;
+  }
 
-  return event_list == NULL;
+  return 0;
 }
 
 int ems_terminate() {
@@ -57,8 +263,27 @@ int ems_terminate() {
     return 1;
   }
 
-  free_list(event_list);
+  // The holds left are released first, so the store is closed with only confirmed reservations in it
+  if (seat_holds != NULL) {
+    hold_table_close(seat_holds);
+    free(seat_holds);
+    seat_holds = NULL;
+  }
+
+  // The log is only emptied once the store it checkpoints into is synced
+  int checkpoint = event_list->store != NULL;
   pthread_rwlock_unlock(&event_list->rwl);
+  if (free_list(event_list) != 0) {
+    fprintf(stderr, "Failed to sync the event store\n");
+    checkpoint = 0;
+  }
+  event_list = NULL;
+
+  if (event_log != NULL) {
+    wal_close(event_log, checkpoint);
+    free(event_log);
+    event_log = NULL;
+  }
   return 0;
 }
 
@@ -68,52 +293,46 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
     return 1;
   }
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
+  // Only the creation of events in the same shard waits for the lookup below
+  if (lock_shard(event_list, event_id) != 0) {
+    fprintf(stderr, "Error locking event shard\n");
     return 1;
   }
 
-  if (get_event_with_delay(event_id, event_list->head, event_list->tail) != NULL) {
+  if (get_event_with_delay(event_id) != NULL) {
     fprintf(stderr, "Event already exists\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+    unlock_shard(event_list, event_id);
     return 1;
   }
 
-  struct Event* event = malloc(sizeof(struct Event));
+  struct Event* event = create_event(event_list, event_id, num_rows, num_cols);
 
   if (event == NULL) {
     fprintf(stderr, "Error allocating memory for event\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+    unlock_shard(event_list, event_id);
     return 1;
   }
 
-  event->id = event_id;
-  event->rows = num_rows;
-  event->cols = num_cols;
-  event->reservations = 0;
-  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event);
+  if (append_to_list(event_list, event) != 0) {
+    fprintf(stderr, "Error appending event to list\n");
+    unlock_shard(event_list, event_id);
     return 1;
   }
-  event->data = calloc(num_rows * num_cols, sizeof(unsigned int));
 
-  if (event->data == NULL) {
-    fprintf(stderr, "Error allocating memory for event data\n");
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event);
-    return 1;
+  // Logged under the shard lock so the create precedes every reservation of the event in the log
+  uint64_t position = 0;
+  if (event_log != NULL) {
+    struct WalRecord record = {.type = WAL_CREATE, .event_id = event_id, .num_rows = num_rows, .num_cols = num_cols};
+    position = wal_append(event_log, &record, NULL);
   }
 
-  if (append_to_list(event_list, event) != 0) {
-    fprintf(stderr, "Error appending event to list\n");
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event->data);
-    free(event);
+  unlock_shard(event_list, event_id);
+
+  // The client is only answered once the create is durable, waiting outside the lock lets it share a sync
+  if (event_log != NULL && (position == 0 || wal_commit(event_log, position) != 0)) {
+    fprintf(stderr, "Error writing to the write-ahead log\n");
     return 1;
   }
-
-  pthread_rwlock_unlock(&event_list->rwl);
   return 0;
 }
 
@@ -123,138 +342,351 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
-    return 1;
-  }
-
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
-
-  pthread_rwlock_unlock(&event_list->rwl);
+  struct Event* event = get_event_with_delay(event_id);
 
   if (event == NULL) {
     fprintf(stderr, "Event not found\n");
     return 1;
   }
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
-    fprintf(stderr, "Error locking mutex\n");
+  if (num_seats > MAX_RESERVATION_SIZE) {
+    fprintf(stderr, "Too many seats\n");
     return 1;
   }
 
+  // The dimensions never change, so the seats are checked before locking anything
+  size_t indexes[MAX_RESERVATION_SIZE];
   for (size_t i = 0; i < num_seats; i++) {
     if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
       fprintf(stderr, "Seat out of bounds\n");
-      pthread_mutex_unlock(&event->mutex);
       return 1;
     }
+    indexes[i] = seat_index(event, xs[i], ys[i]);
   }
 
-  for (size_t i = 0; i < event->rows * event->cols; i++) {
-    for (size_t j = 0; j < num_seats; j++) {
-      if (seat_index(event, xs[j], ys[j]) != i) {
-        continue;
-      }
+  // Only the stripes of the requested rows are locked, in increasing order so reservations never deadlock
+  size_t stripes[MAX_RESERVATION_SIZE];
+  size_t n_stripes = find_stripes(event, num_seats, indexes, stripes);
+  if (lock_stripes(event, n_stripes, stripes) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return 1;
+  }
 
-      if (event->data[i] != 0) {
-        fprintf(stderr, "Seat already reserved\n");
-        pthread_mutex_unlock(&event->mutex);
-        return 1;
-      }
+  // Only the requested seats are tested, a repeated seat is rejected like a taken one
+  if (claim_seats(event, num_seats, indexes) != 0) {
+    fprintf(stderr, "Seat already reserved\n");
+    unlock_stripes(event, n_stripes, stripes);
+    return 1;
+  }
 
-      break;
-    }
+  update_free_runs(event, num_seats, indexes);
+  return write_reservation(event, num_seats, indexes, n_stripes, stripes);
+}
+
+int ems_hold(unsigned int event_id, unsigned int ttl_s, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (num_seats > MAX_RESERVATION_SIZE) {
+    fprintf(stderr, "Too many seats\n");
+    return 1;
   }
 
-  unsigned int reservation_id = ++event->reservations;
+  if (ttl_s > UINT_MAX / 1000) {
+    fprintf(stderr, "Hold too long\n");
+    return 1;
+  }
+
+  struct Hold* hold = malloc(sizeof(struct Hold) + num_seats * sizeof(size_t));
+  if (hold == NULL) {
+    fprintf(stderr, "Error allocating memory for hold\n");
+    return 1;
+  }
+  hold->event_id = event_id;
+  hold->event = event;
+  hold->num_seats = num_seats;
 
   for (size_t i = 0; i < num_seats; i++) {
-    event->data[seat_index(event, xs[i], ys[i])] = reservation_id;
+    if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
+      fprintf(stderr, "Seat out of bounds\n");
+      free(hold);
+      return 1;
+    }
+    hold->seats[i] = seat_index(event, xs[i], ys[i]);
+  }
+
+  // The seats are only claimed, they read as free until the hold is confirmed and nothing is logged before that
+  size_t stripes[MAX_RESERVATION_SIZE];
+  size_t n_stripes = find_stripes(event, num_seats, hold->seats, stripes);
+  if (lock_stripes(event, n_stripes, stripes) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    free(hold);
+    return 1;
+  }
+
+  if (claim_seats(event, num_seats, hold->seats) != 0) {
+    fprintf(stderr, "Seat already reserved\n");
+    unlock_stripes(event, n_stripes, stripes);
+    free(hold);
+    return 1;
   }
+  update_free_runs(event, num_seats, hold->seats);
+  unlock_stripes(event, n_stripes, stripes);
 
-  pthread_mutex_unlock(&event->mutex);
+  *hold_id = hold_add(seat_holds, hold, ttl_s * 1000);
+  if (*hold_id == 0) {
+    fprintf(stderr, "Error adding hold\n");
+    expire_hold(hold);
+    return 1;
+  }
   return 0;
 }
 
-int ems_show(int out_fd, unsigned int event_id) {
+int ems_confirm(unsigned int event_id, unsigned int hold_id) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
+  // Taking the hold cancels its timer, so it can no longer expire under the reservation
+  struct Hold* hold = hold_take(seat_holds, hold_id, event_id);
+  if (hold == NULL) {
+    fprintf(stderr, "Hold not found\n");
     return 1;
   }
 
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+  size_t stripes[MAX_RESERVATION_SIZE];
+  size_t n_stripes = find_stripes(hold->event, hold->num_seats, hold->seats, stripes);
+  if (lock_stripes(hold->event, n_stripes, stripes) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    expire_hold(hold);
+    return 1;
+  }
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  int result = write_reservation(hold->event, hold->num_seats, hold->seats, n_stripes, stripes);
+  free(hold);
+  return result;
+}
+
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* row, size_t* col) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Event* event = get_event_with_delay(event_id);
 
   if (event == NULL) {
     fprintf(stderr, "Event not found\n");
     return 1;
   }
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE) {
+    fprintf(stderr, "Invalid number of seats\n");
+    return 1;
+  }
+
+  // The search spans every row, so the whole event is locked like for a widening reservation
+  if (lock_event(event) != 0) {
     fprintf(stderr, "Error locking mutex\n");
     return 1;
   }
 
-  for (size_t i = 1; i <= event->rows; i++) {
-    for (size_t j = 1; j <= event->cols; j++) {
-      char buffer[16];
-      sprintf(buffer, "%u", event->data[seat_index(event, i, j)]);
+  size_t indexes[MAX_RESERVATION_SIZE];
+  if (claim_free_run(event_list, event, num_seats, indexes) != 0) {
+    fprintf(stderr, "No adjacent free seats\n");
+    unlock_event(event);
+    return 1;
+  }
 
-      if (print_str(out_fd, buffer)) {
-        perror("Error writing to file descriptor");
-        pthread_mutex_unlock(&event->mutex);
-        return 1;
-      }
+  unsigned int reservation_id = atomic_fetch_add(&event->reservations, 1) + 1;
+  struct ReservationSeats* reserved = prepare_reservation(event, reservation_id, num_seats, indexes);
+  if (reserved == NULL) {
+    fprintf(stderr, "Error allocating memory for seats\n");
+    release_seats(event, num_seats, indexes);
+    update_free_runs(event, num_seats, indexes);
+    unlock_event(event);
+    return 1;
+  }
 
-      if (j < event->cols) {
-        if (print_str(out_fd, " ")) {
-          perror("Error writing to file descriptor");
-          pthread_mutex_unlock(&event->mutex);
-          return 1;
-        }
-      }
+  for (size_t i = 0; i < num_seats; i++) {
+    set_seat(event, indexes[i], reservation_id);
+  }
+
+  // Logged like any other reservation, so replaying it needs no search
+  uint64_t position = 0;
+  if (event_log != NULL) {
+    uint64_t seats[MAX_RESERVATION_SIZE];
+    for (size_t i = 0; i < num_seats; i++) {
+      seats[i] = indexes[i];
     }
+    struct WalRecord record = {
+        .type = WAL_RESERVE, .event_id = event_id, .reservation_id = reservation_id, .num_seats = num_seats};
+    position = wal_append(event_log, &record, seats);
+  }
+  index_reservation(event, reservation_id, reserved);
 
-    if (print_str(out_fd, "\n")) {
-      perror("Error writing to file descriptor");
-      pthread_mutex_unlock(&event->mutex);
-      return 1;
+  unlock_event(event);
+
+  if (event_log != NULL && (position == 0 || wal_commit(event_log, position) != 0)) {
+    fprintf(stderr, "Error writing to the write-ahead log\n");
+    return 1;
+  }
+
+  *row = indexes[0] / event->cols + 1;
+  *col = indexes[0] % event->cols + 1;
+  return 0;
+}
+
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  // Taking the record out of the index makes a second cancel of the same reservation fail right away
+  struct ReservationSeats* reserved = take_reservation(event, reservation_id);
+  if (reserved == NULL) {
+    fprintf(stderr, "Reservation not found\n");
+    return 1;
+  }
+
+  // Only the stripes of the reservation's rows are locked, the rest of the event is never read
+  size_t stripes[MAX_RESERVATION_SIZE];
+  size_t n_stripes = find_stripes(event, reserved->num_seats, reserved->seats, stripes);
+  if (lock_stripes(event, n_stripes, stripes) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    index_reservation(event, reservation_id, reserved);
+    return 1;
+  }
+
+  size_t cleared[MAX_RESERVATION_SIZE];
+  size_t n_cleared = 0;
+  for (size_t i = 0; i < reserved->num_seats; i++) {
+    if (get_seat(event, reserved->seats[i]) != reservation_id) continue;
+    set_seat(event, reserved->seats[i], 0);
+    cleared[n_cleared++] = reserved->seats[i];
+  }
+  release_seats(event, n_cleared, cleared);
+  update_free_runs(event, n_cleared, cleared);
+
+  uint64_t position = 0;
+  if (event_log != NULL) {
+    uint64_t seats[MAX_RESERVATION_SIZE];
+    for (size_t i = 0; i < n_cleared; i++) {
+      seats[i] = cleared[i];
     }
+    struct WalRecord record = {
+        .type = WAL_CANCEL, .event_id = event_id, .reservation_id = reservation_id, .num_seats = n_cleared};
+    position = wal_append(event_log, &record, seats);
   }
 
-  pthread_mutex_unlock(&event->mutex);
+  unlock_stripes(event, n_stripes, stripes);
+  free(reserved);
+
+  if (event_log != NULL && (position == 0 || wal_commit(event_log, position) != 0)) {
+    fprintf(stderr, "Error writing to the write-ahead log\n");
+    return 1;
+  }
   return 0;
 }
 
-int ems_list_events(int out_fd) {
+/// Takes a snapshot of the seats of an event.
+/// @note Every stripe is locked while the seats are copied, so the snapshot never shows part of a reservation,
+/// but writers never wait for it to be printed.
+/// @param event Event to be copied.
+/// @return Snapshot to be released with release_snapshot, NULL on failure.
+static struct SeatSnapshot* take_snapshot(struct Event* event) {
+  if (lock_event(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return NULL;
+  }
+
+  struct SeatSnapshot* snapshot = snapshot_seats(event);
+  unlock_event(event);
+
+  if (snapshot == NULL) fprintf(stderr, "Error allocating memory for snapshot\n");
+  return snapshot;
+}
+
+int ems_show(int out_fd, unsigned int event_id) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  struct SeatSnapshot* snapshot = take_snapshot(event);
+  if (snapshot == NULL) return 1;
+
+  if (print_rows(out_fd, snapshot->seats, snapshot->rows, snapshot->cols)) {
+    perror("Error writing to file descriptor");
+    release_snapshot(snapshot);
+    return 1;
+  }
+
+  release_snapshot(snapshot);
+  return 0;
+}
+
+/// Gets the first and last nodes of the list.
+/// @note Nodes are only appended after the last one and never removed while the state is initialized,
+/// so the nodes between them can be walked after the list is unlocked.
+/// @param from Receives the first node, NULL if the list is empty.
+/// @param to Receives the last node.
+/// @return 0 if the list was read successfully, 1 otherwise.
+static int list_bounds(struct ListNode** from, struct ListNode** to) {
   if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
     fprintf(stderr, "Error locking list rwl\n");
     return 1;
   }
 
-  struct ListNode* to = event_list->tail;
-  struct ListNode* current = event_list->head;
+  *from = event_list->head;
+  *to = event_list->tail;
+  pthread_rwlock_unlock(&event_list->rwl);
+  return 0;
+}
+
+int ems_list_events(int out_fd) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct ListNode* current;
+  struct ListNode* to;
+  if (list_bounds(&current, &to) != 0) return 1;
 
   if (current == NULL) {
     char buff[] = "No events\n";
     if (print_str(out_fd, buff)) {
       perror("Error writing to file descriptor");
-      pthread_rwlock_unlock(&event_list->rwl);
       return 1;
     }
 
-    pthread_rwlock_unlock(&event_list->rwl);
     return 0;
   }
 
@@ -262,7 +694,6 @@ int ems_list_events(int out_fd) {
     char buff[] = "Event: ";
     if (print_str(out_fd, buff)) {
       perror("Error writing to file descriptor");
-      pthread_rwlock_unlock(&event_list->rwl);
       return 1;
     }
 
@@ -270,13 +701,12 @@ int ems_list_events(int out_fd) {
     sprintf(id, "%u\n", (current->event)->id);
     if (print_str(out_fd, id)) {
       perror("Error writing to file descriptor");
-      pthread_rwlock_unlock(&event_list->rwl);
       return 1;
     }
 
+    // Every event is shown from its own snapshot, so neither the list nor the event waits for the output
+    if (ems_show(out_fd, (current->event)->id)) break;
 
-    if(ems_show(out_fd,(current->event)->id)) break;
-    
     if (current == to) {
       break;
     }
@@ -284,41 +714,117 @@ int ems_list_events(int out_fd) {
     current = current->next;
   }
 
-  pthread_rwlock_unlock(&event_list->rwl);
   return 0;
 }
 
+char* response_space(struct Response* response, size_t size) {
+  if (size > response->capacity - response->size) {
+    size_t capacity = response->capacity > 0 ? response->capacity : RESPONSE_BUFFER_SIZE;
+    while (size > capacity - response->size) capacity *= 2;
+
+    char* data = realloc(response->data, capacity);
+    if (data == NULL) return NULL;
+    response->data = data;
+    response->capacity = capacity;
+  }
+
+  char* space = response->data + response->size;
+  response->size += size;
+  return space;
+}
+
+int queue_response(struct Response* response, const void* data, size_t size) {
+  char* space = response_space(response, size);
+  if (space == NULL) return 1;
+
+  memcpy(space, data, size);
+  return 0;
+}
+
+int write_response(int fd, struct Response* response) {
+  while (response->written < response->size) {
+    ssize_t written = write(fd, response->data + response->written, response->size - response->written);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : 1;
+    }
+    response->written += (size_t)written;
+  }
+
+  // Everything was written, the buffer is reused for the next response
+  response->size = 0;
+  response->written = 0;
+  return 0;
+}
+
+void free_response(struct Response* response) {
+  free(response->data);
+  response->data = NULL;
+  response->size = 0;
+  response->written = 0;
+  response->capacity = 0;
+}
+
 int get_code(char *op_code){
 
-  if(strcmp(op_code,"OP_CODE=1") == 0) return 1;
+  // The op code is not null terminated, only its OP_CODE_LEN bytes are compared
+
+  if(strncmp(op_code,"OP_CODE=1",OP_CODE_LEN) == 0) return 1;
+
+  if(strncmp(op_code,"OP_CODE=2",OP_CODE_LEN) == 0) return 2;
+
+  if(strncmp(op_code,"OP_CODE=3",OP_CODE_LEN) == 0) return 3;
+
+  if(strncmp(op_code,"OP_CODE=4",OP_CODE_LEN) == 0) return 4;
+
+  if(strncmp(op_code,"OP_CODE=5",OP_CODE_LEN) == 0) return 5;
+
+  if(strncmp(op_code,"OP_CODE=6",OP_CODE_LEN) == 0) return 6;
+
+  if(strncmp(op_code,"OP_CODE=7",OP_CODE_LEN) == 0) return 7;
 
-  if(strcmp(op_code,"OP_CODE=2") == 0) return 2;
+  if(strncmp(op_code,"OP_CODE=8",OP_CODE_LEN) == 0) return 8;
 
-  if(strcmp(op_code,"OP_CODE=3") == 0) return 3;
+  if(strncmp(op_code,"OP_CODE=9",OP_CODE_LEN) == 0) return 9;
 
-  if(strcmp(op_code,"OP_CODE=4") == 0) return 4;
+  // codes past 9 keep the op code a single character by going on in hexadecimal
 
-  if(strcmp(op_code,"OP_CODE=5") == 0) return 5;
+  if(strncmp(op_code,"OP_CODE=A",OP_CODE_LEN) == 0) return 10;
 
-  if(strcmp(op_code,"OP_CODE=6") == 0) return 6;
+  if(strncmp(op_code,"OP_CODE=B",OP_CODE_LEN) == 0) return 11;
 
   return 0;
 
 }
 
-int process_request(int code, int request_pipe, int response_pipe){
+int issue_state_access(int code, struct timespec* ready) {
+  // Only the requests that look an event up access the state
+  if (code != 3 && code != 4 && code != 5 && code != 7 && code != 8 && code != 9 && code != 11) return 0;
+
+  clock_gettime(CLOCK_MONOTONIC, ready);
+  long nsec = ready->tv_nsec + (long)(state_access_delay_us % 1000000) * 1000;
+  ready->tv_sec += (time_t)(state_access_delay_us / 1000000 + (unsigned int)(nsec / 1000000000));
+  ready->tv_nsec = nsec % 1000000000;
+  return 1;
+}
+
+int process_issued_request(int code, int request_pipe, struct Response* response) {
+  access_completed = 1;
+  int result = process_request(code, request_pipe, response);
+  access_completed = 0;
+  return result;
+}
+
+int process_request(int code, int request_pipe, struct Response* response){
   char *response_message;
   unsigned int event_id;
   size_t response_size;
 
   switch (code){
     
-    // quit
+    // quit, the session ends and its pipes are closed by the worker
     case 2:
-      close(request_pipe);
-      close(response_pipe);
-
-      return 0;
+      return 1;
 
     // create
     case 3:
@@ -334,7 +840,7 @@ int process_request(int code, int request_pipe, int response_pipe){
   
       response_size = sizeof(int);
 
-      if(write(response_pipe,&create_value,response_size) < 0) return 1;
+      if(queue_response(response,&create_value,response_size)) return 1;
 
       return 0;
     
@@ -378,7 +884,7 @@ int process_request(int code, int request_pipe, int response_pipe){
 
       response_size = sizeof(int);
       
-      if(write(response_pipe,&reserve_value,response_size) < 0) return 1;
+      if(queue_response(response,&reserve_value,response_size)) return 1;
 
 
       return 0;
@@ -392,22 +898,26 @@ int process_request(int code, int request_pipe, int response_pipe){
       }
 
       int show_value = 0;
+      size_t rows = 0;
+      size_t cols = 0;
 
-      // gets event with the given event id
-      struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+      // gets event with the given event id, a missing event is answered with an empty matrix
+      struct Event* event = get_event_with_delay(event_id);
 
       if (event == NULL) {
           show_value = 1;
+      } else {
+          rows = event->rows;
+          cols = event->cols;
       }
 
-      size_t rows = event->rows;
-      size_t cols = event->cols;
       size_t event_size = rows * cols;
 
     
       response_size = sizeof(int) + ROW_COL_LEN + ROW_COL_LEN + event_size * sizeof(unsigned int);
 
-      response_message = malloc(response_size);
+      // The response is built in the session's buffer, a request that fails ends the session along with it
+      response_message = response_space(response, response_size);
 
       // Check if memory allocation is successful
       if (response_message == NULL) {
@@ -417,16 +927,16 @@ int process_request(int code, int request_pipe, int response_pipe){
       memcpy(response_message, &show_value, sizeof(int));
       memcpy(response_message + sizeof(int), &rows, ROW_COL_LEN);
       memcpy(response_message + sizeof(int) + ROW_COL_LEN, &cols, ROW_COL_LEN);
-      memcpy(response_message + sizeof(int) + ROW_COL_LEN + ROW_COL_LEN, event->data, event_size);
 
-      // Write the response message to the pipe
-      if (write(response_pipe, response_message, response_size) <= 0) {
-          free(response_message);
-          return 1;
+      // the seats are copied from a snapshot, so the event is only locked while it is taken
+      if (event != NULL) {
+          struct SeatSnapshot* snapshot = take_snapshot(event);
+          if (snapshot == NULL) return 1;
+          memcpy(response_message + sizeof(int) + ROW_COL_LEN + ROW_COL_LEN, snapshot->seats,
+                 event_size * sizeof(unsigned int));
+          release_snapshot(snapshot);
       }
 
-
-      free(response_message);
       return 0;
 
 
@@ -439,19 +949,22 @@ int process_request(int code, int request_pipe, int response_pipe){
           return 1;
       }
 
-      struct ListNode* to = event_list->tail;
-      struct ListNode* current = event_list->head;
+      struct ListNode* current;
+      struct ListNode* to;
+      if (list_bounds(&current, &to) != 0) return 1;
 
       unsigned int* id = NULL;
 
       // gets id from all existing events
-      while (1) {
-          id = realloc(id, (n_events + 1) * sizeof(unsigned int));
+      while (current != NULL) {
+          unsigned int* new_id = realloc(id, (n_events + 1) * sizeof(unsigned int));
 
-          if (id == NULL) {
+          if (new_id == NULL) {
               fprintf(stderr, "Memory allocation failed\n");
+              free(id);
               return 1;
           }
+          id = new_id;
 
           id[n_events] = (current->event)->id;
           n_events++;
@@ -463,9 +976,10 @@ int process_request(int code, int request_pipe, int response_pipe){
           current = current->next;
       }
 
-      response_size = sizeof(int) + sizeof(int) + n_events * sizeof(unsigned int);
+      // the client reads the number of events as a size_t
+      response_size = sizeof(int) + sizeof(size_t) + n_events * sizeof(unsigned int);
 
-      response_message = malloc(response_size);
+      response_message = response_space(response, response_size);
 
       if (response_message == NULL) {
 
@@ -474,20 +988,134 @@ int process_request(int code, int request_pipe, int response_pipe){
       }
 
       memcpy(response_message, &list_value, sizeof(int));
-      memcpy(response_message + sizeof(int), &n_events, sizeof(int));
-      memcpy(response_message + sizeof(int) + sizeof(int), id, n_events * sizeof(unsigned int));
+      memcpy(response_message + sizeof(int), &n_events, sizeof(size_t));
+      if (n_events > 0) memcpy(response_message + sizeof(int) + sizeof(size_t), id, n_events * sizeof(unsigned int));
 
-      // writes response to pipe
-      if (write(response_pipe, response_message, response_size) <= 0) {
-          free(response_message);
-          free(id);
+      free(id);
+
+      return 0;
+
+    // reserve best
+    case 7:
+      size_t best_seats;
+      size_t best_row = 0;
+      size_t best_col = 0;
+
+      if (read(request_pipe, &event_id, EVENT_ID_LEN) <= 0 ||
+      read(request_pipe, &best_seats, SEATS_LEN) <= 0) return 1;
+
+      int best_value = ems_reserve_best(event_id, best_seats, &best_row, &best_col);
+
+      // answers with the first seat of the run, the others follow it in the same row
+      response_size = sizeof(int) + ROW_COL_LEN + ROW_COL_LEN;
+      char best_response[sizeof(int) + 2 * sizeof(size_t)];
+      memcpy(best_response, &best_value, sizeof(int));
+      memcpy(best_response + sizeof(int), &best_row, ROW_COL_LEN);
+      memcpy(best_response + sizeof(int) + ROW_COL_LEN, &best_col, ROW_COL_LEN);
+
+      if (queue_response(response, best_response, response_size)) return 1;
+
+      return 0;
+
+    // available
+    case 8:
+      if (read(request_pipe, &event_id, EVENT_ID_LEN) <= 0) return 1;
+
+      int available_value = 0;
+      size_t available_rows = 0;
+      size_t available_cols = 0;
+      size_t free_seats = 0;
+
+      // a missing event is answered with no rows
+      struct Event* counted = get_event_with_delay(event_id);
+      if (counted == NULL) {
+          available_value = 1;
+      } else {
+          available_rows = counted->rows;
+          available_cols = counted->cols;
+      }
+
+      size_t header_size = sizeof(int) + ROW_COL_LEN + ROW_COL_LEN + SEATS_LEN;
+      response_size = header_size + available_rows * SEATS_LEN;
+      response_message = response_space(response, response_size);
+
+      if (response_message == NULL) {
           return 1;
       }
 
+      // only the counters the reservations keep are read, the seats are neither locked nor sent
+      if (counted != NULL) {
+          size_t* row_free = NULL;
+          if (available_rows > 0 && (row_free = malloc(available_rows * SEATS_LEN)) == NULL) return 1;
+          free_seats = count_free_seats(counted, row_free);
+          if (row_free != NULL) memcpy(response_message + header_size, row_free, available_rows * SEATS_LEN);
+          free(row_free);
+      }
 
+      memcpy(response_message, &available_value, sizeof(int));
+      memcpy(response_message + sizeof(int), &available_rows, ROW_COL_LEN);
+      memcpy(response_message + sizeof(int) + ROW_COL_LEN, &available_cols, ROW_COL_LEN);
+      memcpy(response_message + sizeof(int) + 2 * ROW_COL_LEN, &free_seats, SEATS_LEN);
 
-      free(response_message);
-      free(id);
+      return 0;
+
+    // hold
+    case 9:
+      unsigned int ttl_s;
+      size_t hold_seats;
+
+      if (read(request_pipe, &event_id, EVENT_ID_LEN) <= 0 ||
+      read(request_pipe, &ttl_s, HOLD_TTL_LEN) <= 0 ||
+      read(request_pipe, &hold_seats, SEATS_LEN) <= 0) return 1;
+
+      // The client never sends more seats than a hold can take, a larger count ends the session
+      if (hold_seats > MAX_RESERVATION_SIZE) return 1;
+
+      size_t hold_xs[MAX_RESERVATION_SIZE];
+      size_t hold_ys[MAX_RESERVATION_SIZE];
+
+      if (read(request_pipe, hold_xs, hold_seats * SEATS_LEN) < 0 ||
+          read(request_pipe, hold_ys, hold_seats * SEATS_LEN) < 0) return 1;
+
+      unsigned int hold_id = 0;
+      int hold_value = ems_hold(event_id, ttl_s, hold_seats, hold_xs, hold_ys, &hold_id);
+
+      // answers with the id the hold is confirmed with
+      response_size = sizeof(int) + HOLD_ID_LEN;
+      char hold_response[sizeof(int) + sizeof(unsigned int)];
+      memcpy(hold_response, &hold_value, sizeof(int));
+      memcpy(hold_response + sizeof(int), &hold_id, HOLD_ID_LEN);
+
+      if (queue_response(response, hold_response, response_size)) return 1;
+
+      return 0;
+
+    // confirm
+    case 10:
+      unsigned int confirmed_id;
+
+      if (read(request_pipe, &event_id, EVENT_ID_LEN) <= 0 ||
+      read(request_pipe, &confirmed_id, HOLD_ID_LEN) <= 0) return 1;
+
+      int confirm_value = ems_confirm(event_id, confirmed_id);
+
+      response_size = sizeof(int);
+
+      if (queue_response(response, &confirm_value, response_size)) return 1;
+
+      return 0;
+
+    case 11:
+      unsigned int cancelled_id;
+
+      if (read(request_pipe, &event_id, EVENT_ID_LEN) <= 0 ||
+      read(request_pipe, &cancelled_id, RESERVATION_ID_LEN) <= 0) return 1;
+
+      int cancel_value = ems_cancel(event_id, cancelled_id);
+
+      response_size = sizeof(int);
+
+      if (queue_response(response, &cancel_value, response_size)) return 1;
 
       return 0;
 
@@ -2,12 +2,24 @@
 #define SERVER_OPERATIONS_H
 
 #include <stddef.h>
+#include <time.h>
 
 
+// Options of the EMS state, taken from the server's command line
+struct EmsConfig {
+  unsigned int delay_us;        // State access delay in microseconds
+  size_t n_shards;              // Number of shards the events are spread over
+  size_t n_stripes;             // Number of row bands every event is locked by
+  const char* store_path;       // File the events are kept in, NULL to keep them in memory only
+  const char* wal_path;         // Write-ahead log of creates, reservations and cancels, NULL to run without one
+  unsigned int wal_flush_us;    // Longest time a logged request waits for its batch
+  size_t wal_batch_size;        // Number of logged requests synced together without waiting
+};
+
 /// Initializes the EMS state.
-/// @param delay_us Delay in microseconds.
+/// @param config Options of the state.
 /// @return 0 if the EMS state was initialized successfully, 1 otherwise.
-int ems_init(unsigned int delay_us);
+int ems_init(const struct EmsConfig* config);
 
 /// Destroys the EMS state.
 int ems_terminate();
@@ -27,6 +39,38 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
 
+/// Reserves the first num_seats adjacent free seats in a row of the given event.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of adjacent seats to reserve.
+/// @param row Receives the row of the first reserved seat.
+/// @param col Receives the column of the first reserved seat.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t *row, size_t *col);
+
+/// Claims the given seats for a limited time, after which they are released unless the hold is confirmed.
+/// @note Held seats cannot be reserved by anyone else but read as free until confirmed. Holds are not logged.
+/// @param event_id Id of the event to hold seats of.
+/// @param ttl_s Number of seconds the seats are held for.
+/// @param num_seats Number of seats to hold.
+/// @param xs Array of rows of the seats to hold.
+/// @param ys Array of columns of the seats to hold.
+/// @param hold_id Receives the id to confirm the hold with.
+/// @return 0 if the seats were held successfully, 1 otherwise.
+int ems_hold(unsigned int event_id, unsigned int ttl_s, size_t num_seats, size_t *xs, size_t *ys,
+             unsigned int *hold_id);
+
+/// Turns a hold that has not expired into a reservation.
+/// @param event_id Id of the event the hold belongs to.
+/// @param hold_id Id given by ems_hold.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_confirm(unsigned int event_id, unsigned int hold_id);
+
+/// Cancels a reservation, freeing its seats.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id the reservation's seats hold.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
 /// Prints the given event.
 /// @param out_fd File descriptor to print the event to.
 /// @param event_id Id of the event to print.
@@ -38,7 +82,62 @@ int ems_show(int out_fd, unsigned int event_id);
 /// @return 0 if the events were printed successfully, 1 otherwise.
 int ems_list_events(int out_fd);
 
+// Responses of a session that were not written to its response pipe yet, so a session that is slow to read them
+// never keeps its worker waiting
+struct Response {
+  char* data;
+  size_t size;      // Number of bytes held
+  size_t written;   // Number of them already written to the pipe
+  size_t capacity;  // Number of bytes data has room for
+};
+
+/// Adds room for some bytes at the end of a response.
+/// @param response Response to add to, starts zeroed.
+/// @param size Number of bytes.
+/// @return Pointer to the bytes, valid until the response grows again. NULL if they could not be allocated.
+char* response_space(struct Response* response, size_t size);
+
+/// Adds some bytes at the end of a response.
+/// @param response Response to add to.
+/// @param data Bytes to add.
+/// @param size Number of bytes.
+/// @return 0 if the bytes were added, 1 if they could not be allocated.
+int queue_response(struct Response* response, const void* data, size_t size);
+
+/// Writes as much of a response as the pipe takes without waiting.
+/// @note The pipe must be non-blocking. The response is emptied once all of it was written.
+/// @param fd Response pipe of the session.
+/// @param response Response to write.
+/// @return 0 if the pipe took everything or is full, 1 if it failed.
+int write_response(int fd, struct Response* response);
+
+/// Frees the bytes of a response.
+/// @param response Response to free, left empty.
+void free_response(struct Response* response);
+
 int get_code(char *op_code);
 
-int process_request(int code, int request_pipe, int response_pipe);
+/// Processes a request, adding its answer to the session's response.
+/// @param code Op code of the request.
+/// @param request_pipe Pipe the arguments of the request are read from.
+/// @param response Response of the session, written to its response pipe by the caller.
+/// @return 0 if the session can go on, 1 if it ends, because it quit or failed.
+int process_request(int code, int request_pipe, struct Response* response);
+
+/// Issues the state access of a request ahead of processing it, so the worker serves other sessions meanwhile.
+/// @note A latency model, not a submission and completion queue: nothing is read from the state or the request pipe
+/// here, only the time the lookup takes is computed. The whole request runs in process_issued_request once that time
+/// has passed, so no result is visible before its access completes.
+/// @param code Op code of the request, its arguments are still in the request pipe.
+/// @param ready Receives the time the access completes at.
+/// @return 1 if the request waits for the access, 0 if it accesses no state and can be processed right away.
+int issue_state_access(int code, struct timespec* ready);
+
+/// Processes a request whose state access was issued with issue_state_access and has completed.
+/// @note Reads the arguments, accesses the state and answers now, without paying the lookup delay again.
+/// @param code Op code of the request.
+/// @param request_pipe Pipe the arguments of the request are read from.
+/// @param response Response of the session.
+/// @return 0 if the session can go on, 1 otherwise.
+int process_issued_request(int code, int request_pipe, struct Response* response);
 #endif  // SERVER_OPERATIONS_H
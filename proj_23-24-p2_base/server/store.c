@@ -0,0 +1,115 @@
+#include "store.h"
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STORE_HEADER_SIZE 64
+#define STORE_GROW_SIZE ((size_t)1 << 20)
+#define STORE_MAP_SIZE ((size_t)1 << 36)  // Address space reserved for the file, the largest store allowed
+
+// Rounds a file size up to a whole number of growth steps
+static size_t round_size(size_t size) { return (size + STORE_GROW_SIZE - 1) & ~(STORE_GROW_SIZE - 1); }
+
+int store_open(struct EventStore* store, const char* path, uint32_t record_size) {
+  store->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (store->fd < 0) return 1;
+
+  struct stat st;
+  if (fstat(store->fd, &st) != 0) {
+    close(store->fd);
+    return 1;
+  }
+
+  int created = st.st_size == 0;
+  if (!created && (size_t)st.st_size < STORE_HEADER_SIZE) {
+    close(store->fd);
+    return 1;
+  }
+
+  void* base = mmap(NULL, STORE_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+  if (base == MAP_FAILED) {
+    close(store->fd);
+    return 1;
+  }
+  store->header = (struct StoreHeader*)base;
+  store->data = (unsigned char*)base + STORE_HEADER_SIZE;
+
+  // Anything past the published records was left by a create that never finished, cutting the file zeroes it
+  size_t used = created ? 0 : store->header->used;
+  if (!created && (store->header->magic != STORE_MAGIC || store->header->version != STORE_VERSION ||
+                   store->header->record_size != record_size || used > (size_t)st.st_size - STORE_HEADER_SIZE)) {
+    munmap(base, STORE_MAP_SIZE);
+    close(store->fd);
+    return 1;
+  }
+
+  store->size = round_size(STORE_HEADER_SIZE + used);
+  if (ftruncate(store->fd, (off_t)(STORE_HEADER_SIZE + used)) != 0 || ftruncate(store->fd, (off_t)store->size) != 0 ||
+      pthread_mutex_init(&store->lock, NULL) != 0) {
+    munmap(base, STORE_MAP_SIZE);
+    close(store->fd);
+    return 1;
+  }
+
+  if (created) {
+    store->header->magic = STORE_MAGIC;
+    store->header->version = STORE_VERSION;
+    store->header->record_size = record_size;
+    store->header->used = 0;
+    store->header->clean = 1;
+  }
+
+  store->created = created;
+  store->was_clean = (int)store->header->clean;
+  store->header->clean = 0;
+  return 0;
+}
+
+int store_close(struct EventStore* store) {
+  // The records reach the file before the header says the store is clean
+  int failed = msync(store->header, store->size, MS_SYNC) != 0;
+  if (!failed) {
+    store->header->clean = 1;
+    failed = msync(store->header, STORE_HEADER_SIZE, MS_SYNC) != 0;
+  }
+  store_discard(store);
+  return failed;
+}
+
+void store_discard(struct EventStore* store) {
+  munmap(store->header, STORE_MAP_SIZE);
+  close(store->fd);
+  pthread_mutex_destroy(&store->lock);
+}
+
+void* store_reserve(struct EventStore* store, size_t size) {
+  if (pthread_mutex_lock(&store->lock) != 0) return NULL;
+
+  size_t end = STORE_HEADER_SIZE + store->header->used + size;
+  if (end > STORE_MAP_SIZE) {
+    pthread_mutex_unlock(&store->lock);
+    return NULL;
+  }
+
+  // The file grows in steps and is extended with zeros, so the record needs no clearing
+  if (end > store->size) {
+    size_t new_size = round_size(end);
+    if (ftruncate(store->fd, (off_t)new_size) != 0) {
+      pthread_mutex_unlock(&store->lock);
+      return NULL;
+    }
+    store->size = new_size;
+  }
+
+  return store->data + store->header->used;
+}
+
+void store_publish(struct EventStore* store, size_t size) {
+  // The record must be complete in the mapping before the header counts it
+  atomic_signal_fence(memory_order_seq_cst);
+  store->header->used += size;
+  pthread_mutex_unlock(&store->lock);
+}
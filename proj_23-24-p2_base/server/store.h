@@ -0,0 +1,59 @@
+#ifndef SERVER_STORE_H
+#define SERVER_STORE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STORE_MAGIC 0x45524f5453534d45ull  // "EMSSTORE"
+#define STORE_VERSION 1
+
+// First cache line of the store file
+struct StoreHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t record_size;  // Size of the fixed part of a record, changes whenever its layout does
+  uint64_t used;         // Bytes of published records after the header
+  uint32_t clean;        // Whether the last server closed the store before exiting
+};
+
+// File backed region the events are allocated from, mapped once at a fixed size so it never moves
+struct EventStore {
+  int fd;
+  struct StoreHeader* header;  // Start of the mapping
+  unsigned char* data;         // Cache line aligned start of the records
+  size_t size;                 // Current size of the file
+  int was_clean;               // Whether the store had been closed cleanly when it was opened
+  int created;                 // Whether the file was created empty when it was opened
+  pthread_mutex_t lock;        // Serializes reserve/publish pairs
+};
+
+/// Opens or creates a store file and maps it.
+/// @param store Store to be initialized.
+/// @param path Path of the store file.
+/// @param record_size Size of the fixed part of a record, a store written with another size is rejected.
+/// @return 0 if the store was opened successfully, 1 otherwise.
+int store_open(struct EventStore* store, const char* path, uint32_t record_size);
+
+/// Syncs the store, marks it as cleanly closed and unmaps it.
+/// @param store Store to be closed.
+/// @return 0 if the records and the mark reached the file, 1 otherwise.
+int store_close(struct EventStore* store);
+
+/// Unmaps the store without marking it as cleanly closed.
+/// @param store Store to be discarded.
+void store_discard(struct EventStore* store);
+
+/// Reserves zeroed space for a record at the end of the store.
+/// @note Locks the store until store_publish is called, records are only visible after restart once published.
+/// @param store Store to allocate from.
+/// @param size Size of the record, a multiple of a cache line.
+/// @return Pointer to the record, NULL if the store could not grow. The store is unlocked on failure.
+void* store_reserve(struct EventStore* store, size_t size);
+
+/// Publishes the record returned by the last store_reserve and unlocks the store.
+/// @param store Store the record belongs to.
+/// @param size Size given to store_reserve.
+void store_publish(struct EventStore* store, size_t size);
+
+#endif  // SERVER_STORE_H
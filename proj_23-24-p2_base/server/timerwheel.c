@@ -0,0 +1,96 @@
+#include "timerwheel.h"
+
+#define SLOT_MASK ((uint64_t)TIMER_WHEEL_SLOTS - 1)
+#define MAX_DELTA (((uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+// Links a timer into the slot its distance from the current tick falls in
+static void link_timer(struct TimerWheel* wheel, struct Timer* timer) {
+  uint64_t expires = timer->expires < wheel->now ? wheel->now : timer->expires;
+  if (expires - wheel->now > MAX_DELTA) expires = wheel->now + MAX_DELTA;
+
+  // Level l holds the timers less than 2^(BITS * (l + 1)) ticks away, in the slot of their tick at that level
+  uint64_t delta = expires - wheel->now;
+  size_t level = 0;
+  while (level + 1 < TIMER_WHEEL_LEVELS && delta >> (TIMER_WHEEL_BITS * (level + 1)) != 0) level++;
+
+  struct Timer** slot = &wheel->slots[level][(expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+  timer->next = *slot;
+  if (timer->next) timer->next->pprev = &timer->next;
+  timer->pprev = slot;
+  *slot = timer;
+}
+
+void timer_wheel_init(struct TimerWheel* wheel, uint64_t now) {
+  wheel->now = now;
+  wheel->n_timers = 0;
+  for (size_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (size_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+      wheel->slots[level][slot] = NULL;
+    }
+  }
+}
+
+void timer_wheel_add(struct TimerWheel* wheel, struct Timer* timer, uint64_t expires) {
+  timer->expires = expires;
+  link_timer(wheel, timer);
+  wheel->n_timers++;
+}
+
+void timer_wheel_remove(struct TimerWheel* wheel, struct Timer* timer) {
+  *timer->pprev = timer->next;
+  if (timer->next) timer->next->pprev = timer->pprev;
+  timer->pprev = NULL;
+  timer->next = NULL;
+  wheel->n_timers--;
+}
+
+struct Timer* timer_wheel_advance(struct TimerWheel* wheel, uint64_t now) {
+  struct Timer* fired = NULL;
+
+  while (wheel->n_timers > 0 && wheel->now <= now) {
+    // At the start of every turn of a level, the next slot of the level above is spread over the levels below
+    uint64_t index = wheel->now & SLOT_MASK;
+    for (size_t level = 1; index == 0 && level < TIMER_WHEEL_LEVELS; level++) {
+      index = (wheel->now >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+      struct Timer* timer = wheel->slots[level][index];
+      wheel->slots[level][index] = NULL;
+      while (timer) {
+        struct Timer* next = timer->next;
+        link_timer(wheel, timer);
+        timer = next;
+      }
+    }
+
+    struct Timer** slot = &wheel->slots[0][wheel->now & SLOT_MASK];
+    while (*slot) {
+      struct Timer* timer = *slot;
+      *slot = timer->next;
+      timer->pprev = NULL;
+      timer->next = fired;
+      fired = timer;
+      wheel->n_timers--;
+    }
+    wheel->now++;
+  }
+
+  // Nothing is left to move down, so the ticks with no timer are skipped
+  if (wheel->n_timers == 0 && wheel->now <= now) wheel->now = now + 1;
+  return fired;
+}
+
+struct Timer* timer_wheel_drain(struct TimerWheel* wheel) {
+  struct Timer* drained = NULL;
+  for (size_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (size_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+      while (wheel->slots[level][slot]) {
+        struct Timer* timer = wheel->slots[level][slot];
+        wheel->slots[level][slot] = timer->next;
+        timer->pprev = NULL;
+        timer->next = drained;
+        drained = timer;
+      }
+    }
+  }
+  wheel->n_timers = 0;
+  return drained;
+}
@@ -0,0 +1,56 @@
+#ifndef SERVER_TIMER_WHEEL_H
+#define SERVER_TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_BITS 8                         // Slots of a level are indexed by this many bits of the tick
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)  // Slots per level
+#define TIMER_WHEEL_LEVELS 4                       // Levels, timers further than 2^32 ticks away are clamped
+
+// Timer embedded in the structure it expires, linked into a single slot of the wheel
+struct Timer {
+  uint64_t expires;      // Tick the timer fires at
+  struct Timer** pprev;  // Link pointing at the timer, either a slot or the next field of the previous timer
+  struct Timer* next;
+};
+
+// Hierarchical timing wheel: level 0 has a slot per tick, every next level a slot per full turn of the one below.
+// Timers are moved down a level at a time as their tick comes closer, so each one is touched a bounded number of times
+struct TimerWheel {
+  uint64_t now;     // Next tick to be expired
+  size_t n_timers;  // Number of timers in the wheel
+  struct Timer* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+/// Initializes an empty wheel.
+/// @param wheel Wheel to be initialized.
+/// @param now Tick the wheel starts at.
+void timer_wheel_init(struct TimerWheel* wheel, uint64_t now);
+
+/// Adds a timer to the wheel.
+/// @note Constant time. A tick that already passed fires on the next advance.
+/// @param wheel Wheel the timer is added to.
+/// @param timer Timer to be added, not in any wheel.
+/// @param expires Tick the timer fires at.
+void timer_wheel_add(struct TimerWheel* wheel, struct Timer* timer, uint64_t expires);
+
+/// Removes a timer that has not fired from the wheel.
+/// @note Constant time.
+/// @param wheel Wheel the timer was added to.
+/// @param timer Timer to be removed.
+void timer_wheel_remove(struct TimerWheel* wheel, struct Timer* timer);
+
+/// Advances the wheel up to the given tick and removes every timer that fired on the way.
+/// @note An empty wheel jumps straight to the tick.
+/// @param wheel Wheel to be advanced.
+/// @param now Tick to advance to, the timers that fire at it are included.
+/// @return List of the fired timers linked through next, NULL if none fired.
+struct Timer* timer_wheel_advance(struct TimerWheel* wheel, uint64_t now);
+
+/// Removes every timer left in the wheel.
+/// @param wheel Wheel to be emptied.
+/// @return List of the removed timers linked through next, NULL if the wheel was empty.
+struct Timer* timer_wheel_drain(struct TimerWheel* wheel);
+
+#endif  // SERVER_TIMER_WHEEL_H
@@ -0,0 +1,241 @@
+#include "wal.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+
+#define WAL_INITIAL_CAPACITY 4096
+
+// Hashes everything after the checksum field of a record
+static uint32_t record_checksum(const struct WalRecord* record, const uint64_t* seats) {
+  uint32_t hash = 2166136261u;
+  const unsigned char* bytes = (const unsigned char*)record + sizeof(record->checksum);
+  for (size_t i = 0; i < sizeof(struct WalRecord) - sizeof(record->checksum); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  bytes = (const unsigned char*)seats;
+  for (size_t i = 0; i < record->num_seats * sizeof(uint64_t); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// Replays the log from the start, returns the length of its valid prefix or -1 if a record could not be applied
+static off_t replay(int fd, int (*apply)(const struct WalRecord* record, const uint64_t* seats)) {
+  struct stat st;
+  if (fstat(fd, &st) != 0) return -1;
+  if (st.st_size == 0) return 0;
+
+  unsigned char* log = (unsigned char*)malloc((size_t)st.st_size);
+  if (!log) return -1;
+
+  size_t size = 0;
+  while (size < (size_t)st.st_size) {
+    ssize_t n = read(fd, log + size, (size_t)st.st_size - size);
+    if (n <= 0) break;
+    size += (size_t)n;
+  }
+
+  size_t offset = 0;
+  while (size - offset >= sizeof(struct WalRecord)) {
+    struct WalRecord record;
+    memcpy(&record, log + offset, sizeof(struct WalRecord));
+    // No request logs more seats than a reservation holds, a larger count can only be a torn or corrupt record
+    if (record.num_seats > MAX_RESERVATION_SIZE ||
+        record.num_seats > (size - offset - sizeof(struct WalRecord)) / sizeof(uint64_t))
+      break;
+
+    size_t seats_size = record.num_seats * sizeof(uint64_t);
+    uint64_t seats[MAX_RESERVATION_SIZE];
+    memcpy(seats, log + offset + sizeof(struct WalRecord), seats_size);
+
+    if (record_checksum(&record, seats) != record.checksum) break;
+
+    if (apply(&record, seats) != 0) {
+      free(log);
+      return -1;
+    }
+    offset += sizeof(struct WalRecord) + seats_size;
+  }
+
+  free(log);
+  return (off_t)offset;
+}
+
+// Time after the given one by a number of microseconds
+static struct timespec add_us(struct timespec time, unsigned int us) {
+  time.tv_sec += us / 1000000;
+  time.tv_nsec += (long)(us % 1000000) * 1000;
+  if (time.tv_nsec >= 1000000000) {
+    time.tv_sec++;
+    time.tv_nsec -= 1000000000;
+  }
+  return time;
+}
+
+// Writes the pending records in batches, syncing once per batch so concurrent commits share the cost
+static void* flush_loop(void* arg) {
+  struct Wal* wal = (struct Wal*)arg;
+  unsigned char* spare = NULL;
+  size_t spare_capacity = 0;
+
+  pthread_mutex_lock(&wal->lock);
+  while (1) {
+    while (wal->n_pending == 0 && !wal->stop) {
+      pthread_cond_wait(&wal->pending_cond, &wal->lock);
+    }
+    if (wal->n_pending == 0) break;
+
+    // A partial batch waits for more records until the oldest one has waited for the whole interval
+    struct timespec deadline = add_us(wal->first_time, wal->flush_interval_us);
+    while (wal->n_pending < wal->batch_size && !wal->stop) {
+      if (pthread_cond_timedwait(&wal->pending_cond, &wal->lock, &deadline) != 0) break;
+    }
+
+    // The workers keep appending to the spare buffer while this batch is written
+    unsigned char* batch = wal->buffer;
+    size_t batch_capacity = wal->capacity;
+    size_t len = wal->len;
+    uint64_t position = wal->appended;
+    wal->buffer = spare;
+    wal->capacity = spare_capacity;
+    wal->len = 0;
+    wal->n_pending = 0;
+    pthread_mutex_unlock(&wal->lock);
+
+    int failed = 0;
+    for (size_t written = 0; written < len && !failed;) {
+      ssize_t n = write(wal->fd, batch + written, len - written);
+      if (n <= 0) failed = 1;
+      else written += (size_t)n;
+    }
+    if (!failed && fdatasync(wal->fd) != 0) failed = 1;
+
+    pthread_mutex_lock(&wal->lock);
+    spare = batch;
+    spare_capacity = batch_capacity;
+    if (failed) wal->failed = 1;
+    else wal->flushed = position;
+    pthread_cond_broadcast(&wal->flushed_cond);
+  }
+  pthread_mutex_unlock(&wal->lock);
+
+  free(spare);
+  return NULL;
+}
+
+int wal_open(struct Wal* wal, const char* path, unsigned int flush_interval_us, size_t batch_size,
+             int (*apply)(const struct WalRecord* record, const uint64_t* seats)) {
+  wal->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (wal->fd < 0) return 1;
+
+  // Without a replay the log is emptied, and synced so the old records never show up behind the new ones
+  off_t valid = apply != NULL ? replay(wal->fd, apply) : 0;
+  if (valid < 0 || ftruncate(wal->fd, valid) != 0 || (apply == NULL && fsync(wal->fd) != 0) ||
+      lseek(wal->fd, valid, SEEK_SET) != valid) {
+    close(wal->fd);
+    return 1;
+  }
+
+  wal->buffer = NULL;
+  wal->len = 0;
+  wal->capacity = 0;
+  wal->n_pending = 0;
+  wal->appended = (uint64_t)valid;
+  wal->flushed = (uint64_t)valid;
+  wal->failed = 0;
+  wal->stop = 0;
+  wal->flush_interval_us = flush_interval_us;
+  wal->batch_size = batch_size == 0 ? 1 : batch_size;
+
+  if (pthread_mutex_init(&wal->lock, NULL) != 0) {
+    close(wal->fd);
+    return 1;
+  }
+  if (pthread_cond_init(&wal->pending_cond, NULL) != 0) {
+    pthread_mutex_destroy(&wal->lock);
+    close(wal->fd);
+    return 1;
+  }
+  if (pthread_cond_init(&wal->flushed_cond, NULL) != 0) {
+    pthread_cond_destroy(&wal->pending_cond);
+    pthread_mutex_destroy(&wal->lock);
+    close(wal->fd);
+    return 1;
+  }
+  if (pthread_create(&wal->flusher, NULL, flush_loop, wal) != 0) {
+    pthread_cond_destroy(&wal->flushed_cond);
+    pthread_cond_destroy(&wal->pending_cond);
+    pthread_mutex_destroy(&wal->lock);
+    close(wal->fd);
+    return 1;
+  }
+  return 0;
+}
+
+void wal_close(struct Wal* wal, int checkpoint) {
+  pthread_mutex_lock(&wal->lock);
+  wal->stop = 1;
+  pthread_cond_signal(&wal->pending_cond);
+  pthread_mutex_unlock(&wal->lock);
+  pthread_join(wal->flusher, NULL);
+
+  // A restart then starts from the store alone instead of replaying the whole history
+  if (checkpoint && !wal->failed && ftruncate(wal->fd, 0) == 0) fsync(wal->fd);
+
+  free(wal->buffer);
+  pthread_cond_destroy(&wal->flushed_cond);
+  pthread_cond_destroy(&wal->pending_cond);
+  pthread_mutex_destroy(&wal->lock);
+  close(wal->fd);
+}
+
+uint64_t wal_append(struct Wal* wal, struct WalRecord* record, const uint64_t* seats) {
+  size_t seats_size = record->num_seats * sizeof(uint64_t);
+  size_t size = sizeof(struct WalRecord) + seats_size;
+  record->checksum = record_checksum(record, seats);
+
+  pthread_mutex_lock(&wal->lock);
+  if (wal->failed) {
+    pthread_mutex_unlock(&wal->lock);
+    return 0;
+  }
+
+  if (wal->len + size > wal->capacity) {
+    size_t capacity = wal->capacity ? wal->capacity : WAL_INITIAL_CAPACITY;
+    while (capacity < wal->len + size) capacity *= 2;
+    unsigned char* buffer = (unsigned char*)realloc(wal->buffer, capacity);
+    if (!buffer) {
+      pthread_mutex_unlock(&wal->lock);
+      return 0;
+    }
+    wal->buffer = buffer;
+    wal->capacity = capacity;
+  }
+
+  memcpy(wal->buffer + wal->len, record, sizeof(struct WalRecord));
+  if (seats_size) memcpy(wal->buffer + wal->len + sizeof(struct WalRecord), seats, seats_size);
+  wal->len += size;
+  wal->appended += size;
+  uint64_t position = wal->appended;
+
+  // The first record starts the interval, a full batch is flushed right away
+  if (wal->n_pending++ == 0) clock_gettime(CLOCK_REALTIME, &wal->first_time);
+  if (wal->n_pending == 1 || wal->n_pending >= wal->batch_size) pthread_cond_signal(&wal->pending_cond);
+  pthread_mutex_unlock(&wal->lock);
+  return position;
+}
+
+int wal_commit(struct Wal* wal, uint64_t position) {
+  pthread_mutex_lock(&wal->lock);
+  while (wal->flushed < position && !wal->failed) {
+    pthread_cond_wait(&wal->flushed_cond, &wal->lock);
+  }
+  int failed = wal->flushed < position;
+  pthread_mutex_unlock(&wal->lock);
+  return failed;
+}
@@ -0,0 +1,77 @@
+#ifndef SERVER_WAL_H
+#define SERVER_WAL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+enum WalRecordType { WAL_CREATE = 1, WAL_RESERVE = 2, WAL_CANCEL = 3 };
+
+// Header of a log record, a reservation or cancel is followed by num_seats seat indexes stored as uint64_t
+struct WalRecord {
+  uint32_t checksum;        // FNV-1a of the rest of the record, a torn record at the end of the log fails it
+  uint32_t type;            // WAL_CREATE, WAL_RESERVE or WAL_CANCEL
+  uint32_t event_id;
+  uint32_t reservation_id;  // Id given to or taken from the reservation, 0 for a create
+  uint64_t num_rows;        // Dimensions of the created event, 0 for a reservation
+  uint64_t num_cols;
+  uint64_t num_seats;       // Number of seat indexes following the header, 0 for a create
+};
+
+// Append only log shared by every worker, written and synced by a single flusher thread
+struct Wal {
+  int fd;
+  pthread_mutex_t lock;
+  pthread_cond_t pending_cond;  // Signaled when a batch is full or the log is closed
+  pthread_cond_t flushed_cond;  // Signaled after every sync
+
+  unsigned char* buffer;  // Records appended since the last flush started
+  size_t len;
+  size_t capacity;
+  size_t n_pending;            // Number of records in the buffer
+  struct timespec first_time;  // When the oldest record in the buffer was appended
+
+  uint64_t appended;  // Log offset right after the last appended record
+  uint64_t flushed;   // Log offset up to which every record is durable
+  int failed;         // Set once a write or sync fails, every later commit fails too
+  int stop;
+
+  unsigned int flush_interval_us;  // Longest time a record waits for its batch to fill
+  size_t batch_size;               // Number of records that triggers a flush right away
+  pthread_t flusher;
+};
+
+/// Opens or creates a log, replays every complete record in it and starts the flusher.
+/// @note A torn record at the end of the log, left by a crash during a write, is cut off. A log whose records are all
+/// in a store that was closed cleanly is emptied instead of replayed.
+/// @param wal Log to be initialized.
+/// @param path Path of the log file.
+/// @param flush_interval_us Longest time in microseconds a record waits before being synced, 0 to sync right away.
+/// @param batch_size Number of pending records that are synced without waiting for the interval.
+/// @param apply Called with every record in the log, in order, a non zero result stops the replay. NULL when the
+/// state already holds every record.
+/// @return 0 if the log was opened and fully replayed, 1 otherwise.
+int wal_open(struct Wal* wal, const char* path, unsigned int flush_interval_us, size_t batch_size,
+             int (*apply)(const struct WalRecord* record, const uint64_t* seats));
+
+/// Flushes the pending records, stops the flusher and closes the log.
+/// @param wal Log to be closed.
+/// @param checkpoint Whether every record is durable in the store by now, in which case the log is emptied.
+void wal_close(struct Wal* wal, int checkpoint);
+
+/// Appends a record to the log without waiting for it to become durable.
+/// @note Records of the same event must be appended in the order their changes were applied.
+/// @param wal Log to be appended to.
+/// @param record Record header, its checksum is computed here.
+/// @param seats Seat indexes of a reservation, NULL for a create.
+/// @return Position to wait for with wal_commit, 0 on failure.
+uint64_t wal_append(struct Wal* wal, struct WalRecord* record, const uint64_t* seats);
+
+/// Waits until every record up to the given position is durable.
+/// @param wal Log the record was appended to.
+/// @param position Position returned by wal_append.
+/// @return 0 if the record is durable, 1 if the log failed.
+int wal_commit(struct Wal* wal, uint64_t position);
+
+#endif  // SERVER_WAL_H
@@ -0,0 +1,27 @@
+#ifndef EMS_BENCH_H
+#define EMS_BENCH_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Helpers shared by the benchmarks, every bench/<name>.c is a program of its own that make bench builds and runs
+
+/// Reads the monotonic clock.
+/// @return Nanoseconds since an arbitrary point in the past.
+static inline uint64_t now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/// Draws a pseudo random number, xorshift so every run draws the same sequence.
+/// @param state State of the sequence, must not be 0. Each thread keeps its own.
+/// @return The next number of the sequence.
+static inline uint64_t next_random(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+#endif  // EMS_BENCH_H
@@ -0,0 +1,99 @@
+// claim_seats on a 1000x1000 venue with requests of MAX_RESERVATION_SIZE random seats: a claim given back right away,
+// a request rejected by a taken seat and one rejected by a seat named twice, against the scan of the whole venue for
+// every requested seat that RESERVE did before the bitmap
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../constants.h"
+#include "../eventlist.h"
+#include "bench.h"
+
+#define ROWS 1000
+#define COLS 1000
+#define NUM_REQUESTS 1000
+#define NUM_SCANS 5
+
+static size_t requests[NUM_REQUESTS][MAX_RESERVATION_SIZE];
+
+// the check RESERVE made before the bitmap, every seat of the venue against every requested seat
+static int scan_venue(const struct Event* event, size_t num_seats, const size_t* indexes) {
+  for (size_t i = 0; i < event->rows * event->cols; i++) {
+    for (size_t j = 0; j < num_seats; j++) {
+      if (indexes[j] != i) continue;
+      if (atomic_load(&event->occupied[i / 64]) & ((uint64_t)1 << (i % 64))) return 1;
+      break;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  struct EventList* list = create_list();
+  struct Event* event = list != NULL ? create_event(list, 1, ROWS, COLS) : NULL;
+  if (event == NULL) return 1;
+
+  // requests of distinct seats, drawn before anything is timed
+  uint64_t state = 314159265u;
+  static unsigned char drawn[ROWS * COLS];
+  for (size_t r = 0; r < NUM_REQUESTS; r++) {
+    for (size_t i = 0; i < MAX_RESERVATION_SIZE; i++) {
+      size_t seat;
+      do {
+        seat = next_random(&state) % (ROWS * COLS);
+      } while (drawn[seat]);
+      drawn[seat] = 1;
+      requests[r][i] = seat;
+    }
+    for (size_t i = 0; i < MAX_RESERVATION_SIZE; i++) {
+      drawn[requests[r][i]] = 0;
+    }
+  }
+
+  printf("claim: ns per request of %d random seats on a %dx%d venue\n", MAX_RESERVATION_SIZE, ROWS, COLS);
+
+  size_t failed = 0;
+  uint64_t start = now_ns();
+  for (size_t r = 0; r < NUM_REQUESTS; r++) {
+    failed += (size_t)claim_seats(event, MAX_RESERVATION_SIZE, requests[r]);
+    release_seats(event, MAX_RESERVATION_SIZE, requests[r]);
+  }
+  printf("%-24s %12.0f\n", "claim and release", (double)(now_ns() - start) / NUM_REQUESTS);
+
+  // the last seat of every request is taken, so each claim gives back every seat before it
+  for (size_t r = 0; r < NUM_REQUESTS; r++) {
+    failed += (size_t)claim_seats(event, 1, &requests[r][MAX_RESERVATION_SIZE - 1]);
+  }
+  start = now_ns();
+  for (size_t r = 0; r < NUM_REQUESTS; r++) {
+    failed += (size_t)(claim_seats(event, MAX_RESERVATION_SIZE, requests[r]) == 0);
+  }
+  printf("%-24s %12.0f\n", "taken last seat", (double)(now_ns() - start) / NUM_REQUESTS);
+
+  start = now_ns();
+  for (size_t r = 0; r < NUM_SCANS; r++) {
+    failed += (size_t)(scan_venue(event, MAX_RESERVATION_SIZE, requests[r]) == 0);
+  }
+  printf("%-24s %12.0f\n", "venue scan, taken seat", (double)(now_ns() - start) / NUM_SCANS);
+
+  for (size_t r = 0; r < NUM_REQUESTS; r++) {
+    release_seats(event, 1, &requests[r][MAX_RESERVATION_SIZE - 1]);
+  }
+
+  // the last seat repeats the first one
+  for (size_t r = 0; r < NUM_REQUESTS; r++) {
+    requests[r][MAX_RESERVATION_SIZE - 1] = requests[r][0];
+  }
+  start = now_ns();
+  for (size_t r = 0; r < NUM_REQUESTS; r++) {
+    failed += (size_t)(claim_seats(event, MAX_RESERVATION_SIZE, requests[r]) == 0);
+  }
+  printf("%-24s %12.0f\n", "repeated seat", (double)(now_ns() - start) / NUM_REQUESTS);
+
+  free_list(list);
+  if (failed != 0) {
+    fprintf(stderr, "claim: %zu requests did not end as expected\n", failed);
+    return 1;
+  }
+  return 0;
+}
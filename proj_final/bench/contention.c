@@ -0,0 +1,102 @@
+// ems_reserve from 1 to 32 threads on one event, with the state access delay at 0. Each access still sleeps for the
+// timer slack, tens of microseconds, and a reservation makes two of them. Every thread makes 3 seat reservations: on
+// disjoint seats, each thread filling a row of its own, or all on the same seats so only one thread wins each group.
+// The serialized runs make the same reservations one at a time behind a mutex, the way reservations on one event used
+// to hold its lock across their accesses
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../eventlist.h"
+#include "../operations.h"
+#include "bench.h"
+
+#define MAX_THREADS 32
+#define SEATS 3
+#define GROUPS 1000  // reservations every thread makes, one row of GROUPS * SEATS seats
+#define COLS (GROUPS * SEATS)
+
+struct Worker {
+  pthread_t id;
+  unsigned int event_id;
+  size_t row;
+  pthread_mutex_t* serialize;  // taken around every reservation, NULL to reserve without it
+  size_t reserved;
+};
+
+static void* reserve(void* arg) {
+  struct Worker* worker = arg;
+  for (size_t group = 0; group < GROUPS; group++) {
+    size_t xs[SEATS], ys[SEATS];
+    for (size_t i = 0; i < SEATS; i++) {
+      xs[i] = worker->row;
+      ys[i] = group * SEATS + i + 1;
+    }
+
+    if (worker->serialize) pthread_mutex_lock(worker->serialize);
+    worker->reserved += ems_reserve(worker->event_id, SEATS, xs, ys) == 0;
+    if (worker->serialize) pthread_mutex_unlock(worker->serialize);
+  }
+  return NULL;
+}
+
+// reservations per second on a new event, negative if a reservation that should have been made was not
+static double run(unsigned int event_id, int num_threads, int overlap, int serialized) {
+  static pthread_mutex_t serialize = PTHREAD_MUTEX_INITIALIZER;
+  if (ems_create(event_id, MAX_THREADS, COLS) != 0) return -1;
+
+  struct Worker workers[MAX_THREADS];
+  uint64_t start = now_ns();
+  for (int i = 0; i < num_threads; i++) {
+    workers[i] = (struct Worker){
+        .event_id = event_id, .row = overlap ? 1 : (size_t)i + 1, .serialize = serialized ? &serialize : NULL};
+    if (pthread_create(&workers[i].id, NULL, reserve, &workers[i]) != 0) return -1;
+  }
+
+  size_t reserved = 0;
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(workers[i].id, NULL);
+    reserved += workers[i].reserved;
+  }
+  double seconds = (double)(now_ns() - start) / 1e9;
+
+  size_t expected = overlap ? GROUPS : (size_t)num_threads * GROUPS;
+  return reserved == expected ? (double)num_threads * GROUPS / seconds : -1;
+}
+
+int main(void) {
+  if (ems_init(0) != 0) return 1;
+
+  // every failed reservation reports itself on stderr, which is not what is being timed
+  int err = dup(STDERR_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  if (err < 0 || null < 0) return 1;
+
+  printf("contention: thousands of reservations per second of %d seats on one event, delay 0\n", SEATS);
+  printf("%10s %12s %12s %12s %12s\n", "threads", "disjoint", "serialized", "overlap", "serialized");
+
+  unsigned int event_id = 1;
+  for (int num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+    double results[4];
+    dup2(null, STDERR_FILENO);
+    for (int i = 0; i < 4; i++) {
+      results[i] = run(event_id++, num_threads, i >= 2, i % 2);
+    }
+    dup2(err, STDERR_FILENO);
+
+    for (int i = 0; i < 4; i++) {
+      if (results[i] < 0) {
+        fprintf(stderr, "contention: reservations went missing with %d threads\n", num_threads);
+        return 1;
+      }
+    }
+    printf("%10d %12.1f %12.1f %12.1f %12.1f\n", num_threads, results[0] / 1e3, results[1] / 1e3, results[2] / 1e3,
+           results[3] / 1e3);
+  }
+
+  close(null);
+  close(err);
+  return ems_terminate();
+}
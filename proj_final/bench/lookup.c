@@ -0,0 +1,58 @@
+// get_event on lists of 1k to 1M events, against a walk of the append-order list like get_event did before the
+// bucket index. Events are 1x1 so the list of 1M fits in memory, lookups draw random ids of the list
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../eventlist.h"
+#include "bench.h"
+
+#define LOOKUPS 1000000
+#define WALK_STEPS 100000000  // nodes visited by the walks at each size, so the walks take about as long at every size
+
+// the lookup get_event did before the index, without the per event locks it also took
+static struct Event* walk_list(struct EventList* list, unsigned int event_id) {
+  for (struct ListNode* node = list->head; node != NULL; node = node->next) {
+    if (node->event->id == event_id) return node->event;
+  }
+  return NULL;
+}
+
+int main(void) {
+  printf("lookup: ns per lookup of a random id, %d lookups through the index\n", LOOKUPS);
+  printf("%10s %10s %10s\n", "events", "index", "walk");
+
+  uint64_t state = 88172645463325252u;
+  for (unsigned int num_events = 1000; num_events <= 1000000; num_events *= 10) {
+    struct EventList* list = create_list();
+    if (list == NULL) return 1;
+
+    for (unsigned int id = 1; id <= num_events; id++) {
+      struct Event* event = create_event(list, id, 1, 1);
+      if (event == NULL || append_to_list(list, event) != 0) {
+        fprintf(stderr, "lookup: could not create %u events\n", num_events);
+        return 1;
+      }
+    }
+
+    // the lookups are counted so none can be left out, every one of them has to find its event
+    size_t found = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < LOOKUPS; i++) {
+      found += get_event(list, 1 + (unsigned int)(next_random(&state) % num_events)) != NULL;
+    }
+    double index_ns = (double)(now_ns() - start) / LOOKUPS;
+
+    // a walk visits half the list on average
+    unsigned int walks = WALK_STEPS / (num_events / 2);
+    start = now_ns();
+    for (unsigned int i = 0; i < walks; i++) {
+      found += walk_list(list, 1 + (unsigned int)(next_random(&state) % num_events)) != NULL;
+    }
+    double walk_ns = (double)(now_ns() - start) / walks;
+
+    printf("%10u %10.0f %10.0f\n", num_events, index_ns, walk_ns);
+    if (found != LOOKUPS + walks) return 1;
+    free_list(list);
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+// get_event from 1 to 64 threads at once on a list of 100k events, against the same lookups made under the list lock
+// as a reader like before the lock free path. Every thread makes the same number of lookups of random ids, so on a
+// machine with at least as many CPUs as threads the lookups per second should grow with the threads
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../eventlist.h"
+#include "bench.h"
+
+#define NUM_EVENTS 100000
+#define LOOKUPS_PER_THREAD 1000000
+#define MAX_THREADS 64
+
+struct Worker {
+  pthread_t id;
+  struct EventList* list;
+  int locked;  // whether every lookup takes the list lock as a reader
+  uint64_t state;
+  size_t found;
+};
+
+static void* look_up(void* arg) {
+  struct Worker* worker = arg;
+  for (int i = 0; i < LOOKUPS_PER_THREAD; i++) {
+    unsigned int id = 1 + (unsigned int)(next_random(&worker->state) % NUM_EVENTS);
+    if (worker->locked) pthread_rwlock_rdlock(&worker->list->list_lock_rw);
+    worker->found += get_event(worker->list, id) != NULL;
+    if (worker->locked) pthread_rwlock_unlock(&worker->list->list_lock_rw);
+  }
+  return NULL;
+}
+
+// lookups per second of the given number of threads, negative if one of them could not be started or missed an event
+static double run(struct EventList* list, int num_threads, int locked) {
+  struct Worker workers[MAX_THREADS];
+  uint64_t start = now_ns();
+  for (int i = 0; i < num_threads; i++) {
+    workers[i] = (struct Worker){.list = list, .locked = locked, .state = 2463534242u + (uint64_t)i, .found = 0};
+    if (pthread_create(&workers[i].id, NULL, look_up, &workers[i]) != 0) return -1;
+  }
+
+  size_t found = 0;
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(workers[i].id, NULL);
+    found += workers[i].found;
+  }
+  double seconds = (double)(now_ns() - start) / 1e9;
+  return found == (size_t)num_threads * LOOKUPS_PER_THREAD ? (double)found / seconds : -1;
+}
+
+int main(void) {
+  struct EventList* list = create_list();
+  if (list == NULL) return 1;
+  for (unsigned int id = 1; id <= NUM_EVENTS; id++) {
+    struct Event* event = create_event(list, id, 1, 1);
+    if (event == NULL || append_to_list(list, event) != 0) return 1;
+  }
+
+  printf("lookup_threads: millions of lookups per second, %d events, %d lookups per thread\n", NUM_EVENTS,
+         LOOKUPS_PER_THREAD);
+  printf("%10s %10s %10s\n", "threads", "lock free", "rwlock");
+  for (int num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+    double lock_free = run(list, num_threads, 0);
+    double locked = run(list, num_threads, 1);
+    if (lock_free < 0 || locked < 0) return 1;
+    printf("%10d %10.1f %10.1f\n", num_threads, lock_free / 1e6, locked / 1e6);
+  }
+
+  free_list(list);
+  return 0;
+}
@@ -0,0 +1,127 @@
+// parse_command over a 100 MB jobs file of mixed commands, through the buffered and the mapped reader. The parser
+// used to read one byte per read call, the cost of those calls alone is measured on the first megabytes
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../output.h"
+#include "../parser.h"
+#include "bench.h"
+
+#define FILE_SIZE ((size_t)100 << 20)
+#define BYTE_READS ((size_t)4 << 20)  // bytes read one at a time, enough to tell the rate
+
+// a random line, with the commands in about the proportions of the jobs files
+static void write_command(struct Output* text, uint64_t* state) {
+  char line[128];
+  unsigned int event_id = 1 + (unsigned int)(next_random(state) % 1000);
+  unsigned int kind = (unsigned int)(next_random(state) % 16);
+  int n;
+
+  if (kind < 8) {
+    n = snprintf(line, sizeof(line), "RESERVE %u [", event_id);
+    output_write(text, line, (size_t)n);
+    size_t num_coords = 1 + next_random(state) % 6;
+    for (size_t i = 0; i < num_coords; i++) {
+      n = snprintf(line, sizeof(line), "(%u,%u)%s", 1 + (unsigned int)(next_random(state) % 100),
+                   1 + (unsigned int)(next_random(state) % 1000), i + 1 < num_coords ? " " : "]\n");
+      output_write(text, line, (size_t)n);
+    }
+    return;
+  }
+
+  switch (kind) {
+    case 8:
+    case 9:
+      n = snprintf(line, sizeof(line), "CREATE %u %u %u\n", event_id, 1 + (unsigned int)(next_random(state) % 100),
+                   1 + (unsigned int)(next_random(state) % 1000));
+      break;
+    case 10:
+      n = snprintf(line, sizeof(line), "SHOW %u\n", event_id);
+      break;
+    case 11:
+      n = snprintf(line, sizeof(line), "CANCEL %u %u\n", event_id, (unsigned int)(next_random(state) % 100000));
+      break;
+    case 12:
+      n = snprintf(line, sizeof(line), "RESERVE_BEST %u %u\n", event_id, 1 + (unsigned int)(next_random(state) % 8));
+      break;
+    case 13:
+      n = snprintf(line, sizeof(line), "WAIT %u %u\n", (unsigned int)(next_random(state) % 100),
+                   1 + (unsigned int)(next_random(state) % 4));
+      break;
+    case 14:
+      n = snprintf(line, sizeof(line), "# a comment\n");
+      break;
+    default:
+      n = snprintf(line, sizeof(line), "LIST\n");
+      break;
+  }
+  output_write(text, line, (size_t)n);
+}
+
+// MB per second of parsing the whole file, negative if it could not be read or not every command was valid
+static double parse_file(const char* path, size_t size, int mapped, size_t expected) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+  struct Reader* reader = mapped ? create_mapped_reader(fd) : create_reader(fd);
+  if (reader == NULL) return -1;
+
+  static struct Operands operands;
+  size_t valid = 0;
+  uint64_t start = now_ns();
+  enum Command command;
+  while ((command = parse_command(reader, &operands)) != EOC) {
+    valid += command != CMD_INVALID && operands.valid;
+  }
+  double seconds = (double)(now_ns() - start) / 1e9;
+
+  free_reader(reader);
+  close(fd);
+  return valid == expected ? (double)size / (1 << 20) / seconds : -1;
+}
+
+int main(void) {
+  struct Output text;
+  init_output(&text);
+  uint64_t state = 1234567u;
+  size_t num_commands = 0;
+  while (text.len < FILE_SIZE && !text.failed) {
+    write_command(&text, &state);
+    num_commands++;
+  }
+  if (text.failed) return 1;
+
+  // the file is cut at the end of the last whole line under FILE_SIZE
+  while (text.len > FILE_SIZE || text.data[text.len - 1] != '\n') {
+    if (text.data[--text.len] == '\n') num_commands--;
+  }
+
+  char path[] = "/tmp/bench_parse_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0 || write(fd, text.data, text.len) != (ssize_t)text.len) return 1;
+
+  size_t file_size = text.len;
+  free_output(&text);
+
+  // the file was just written, so every reader finds it in the page cache
+  lseek(fd, 0, SEEK_SET);
+  char byte;
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < BYTE_READS; i++) {
+    if (read(fd, &byte, 1) != 1) return 1;
+  }
+  double byte_reads = (double)BYTE_READS / (1 << 20) / ((double)(now_ns() - start) / 1e9);
+  close(fd);
+
+  double buffered = parse_file(path, file_size, 0, num_commands);
+  double mapped = parse_file(path, file_size, 1, num_commands);
+  unlink(path);
+  if (buffered < 0 || mapped < 0) return 1;
+
+  printf("parse: MB/s over a %.1f MB jobs file of %zu commands\n", (double)file_size / (1 << 20), num_commands);
+  printf("%-24s %10.1f\n", "read per byte, no parse", byte_reads);
+  printf("%-24s %10.1f\n", "buffered reader", buffered);
+  printf("%-24s %10.1f\n", "mapped reader", mapped);
+  return 0;
+}
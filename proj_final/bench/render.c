@@ -0,0 +1,82 @@
+// renders the seats of a 2000x2000 event row by row the way SHOW does, with output_seats and with a snprintf per seat
+// like before the lookup table, for a free venue, one with a tenth of the seats reserved and a full one
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../output.h"
+#include "bench.h"
+
+#define ROWS 2000
+#define COLS 2000
+#define RENDERS 5
+
+static unsigned int seats[ROWS][COLS];
+
+// the rendering SHOW did before the table, one snprintf per seat
+static void print_seats(struct Output* output) {
+  for (size_t row = 0; row < ROWS; row++) {
+    for (size_t col = 0; col < COLS; col++) {
+      char* space = output_space(output, 16);
+      if (space == NULL) return;
+      output_commit_space(output, (size_t)snprintf(space, 16, "%u%s", seats[row][col], col + 1 < COLS ? " " : "\n"));
+    }
+  }
+}
+
+static void render_seats(struct Output* output) {
+  for (size_t row = 0; row < ROWS; row++) {
+    output_seats(output, seats[row], COLS);
+    output_end_row(output, COLS);
+  }
+}
+
+// ms per render of the whole event, negative if the output differs from the one of snprintf
+static double time_render(void (*render)(struct Output*), struct Output* output, const struct Output* expected) {
+  uint64_t start = now_ns();
+  for (int i = 0; i < RENDERS; i++) {
+    reset_output(output);
+    render(output);
+  }
+  double ms = (double)(now_ns() - start) / 1e6 / RENDERS;
+
+  if (output->failed || (expected != NULL && (output->len != expected->len ||
+                                              memcmp(output->data, expected->data, output->len) != 0))) {
+    return -1;
+  }
+  return ms;
+}
+
+int main(void) {
+  printf("render: ms per render of a %dx%d event\n", ROWS, COLS);
+  printf("%-10s %10s %10s\n", "seats", "snprintf", "table");
+
+  static const char* names[3] = {"free", "10% taken", "all taken"};
+  static const unsigned int odds[3] = {0, 10, 1};  // one in odds seats is reserved, none for 0
+  uint64_t state = 271828183u;
+
+  struct Output expected, output;
+  init_output(&expected);
+  init_output(&output);
+  for (int venue = 0; venue < 3; venue++) {
+    // reservation ids of every length, as a venue fills up with reservations of a few seats each
+    for (size_t row = 0; row < ROWS; row++) {
+      for (size_t col = 0; col < COLS; col++) {
+        int taken = odds[venue] != 0 && next_random(&state) % odds[venue] == 0;
+        seats[row][col] = taken ? 1 + (unsigned int)(next_random(&state) % (ROWS * COLS / 3)) : 0;
+      }
+    }
+
+    double before = time_render(print_seats, &expected, NULL);
+    double after = time_render(render_seats, &output, &expected);
+    if (before < 0 || after < 0) {
+      fprintf(stderr, "render: the two renderings of the %s venue differ\n", names[venue]);
+      return 1;
+    }
+    printf("%-10s %10.1f %10.1f\n", names[venue], before, after);
+  }
+
+  free_output(&expected);
+  free_output(&output);
+  return 0;
+}
@@ -0,0 +1,387 @@
+#include "bytecode.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static const char program_magic[4] = {'E', 'M', 'S', 'B'};
+
+// program being compiled, grown as instructions are emitted
+struct Builder {
+  struct Program* program;
+  size_t capacity;
+};
+
+static int read_all(int fd, void* buf, size_t n) {
+  size_t done = 0;
+  while (done < n) {
+    ssize_t read_bytes = read(fd, (char*)buf + done, n - done);
+    if (read_bytes < 0 && errno == EINTR) continue;
+    if (read_bytes <= 0) return 1;
+    done += (size_t)read_bytes;
+  }
+  return 0;
+}
+
+static int write_all(int fd, const void* buf, size_t n) {
+  size_t done = 0;
+  while (done < n) {
+    ssize_t written = write(fd, (const char*)buf + done, n - done);
+    if (written < 0 && errno == EINTR) continue;
+    if (written < 0) return 1;
+    done += (size_t)written;
+  }
+  return 0;
+}
+
+// FNV-1a taken over 8 byte words rather than single bytes, n is a multiple of the word size
+static uint64_t hash_words(uint64_t hash, const char* bytes, size_t n) {
+  for (size_t i = 0; i < n; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    hash = (hash ^ word) * FNV_PRIME;
+  }
+  return hash;
+}
+
+// the bytes after the last whole word, hashed one at a time
+static uint64_t hash_tail(uint64_t hash, const char* bytes, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    hash = (hash ^ (unsigned char)bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+static uint64_t hash_code(const struct Program* program) {
+  size_t words = program->size - program->size % sizeof(uint64_t);
+  uint64_t hash = hash_words(FNV_OFFSET_BASIS, (const char*)program->code, words);
+  return hash_tail(hash, (const char*)program->code + words, program->size - words);
+}
+
+// size and hash of the whole file, read from its start. Hashing words rather than bytes makes checking that a large
+// file is unchanged cost a fraction of parsing it
+static int hash_source(int fd, uint64_t* size, uint64_t* hash) {
+  char buffer[READER_BUFFER_SIZE];
+  size_t held = 0;  // bytes at the start of buffer left over from the previous read, less than a word
+  *size = 0;
+  *hash = FNV_OFFSET_BASIS;
+
+  if (lseek(fd, 0, SEEK_SET) != 0) return 1;
+
+  while (1) {
+    ssize_t read_bytes = read(fd, buffer + held, sizeof(buffer) - held);
+    if (read_bytes < 0 && errno == EINTR) continue;
+    if (read_bytes < 0) return 1;
+
+    if (read_bytes == 0) {
+      *hash = hash_tail(*hash, buffer, held);
+      return 0;
+    }
+    *size += (uint64_t)read_bytes;
+
+    size_t len = held + (size_t)read_bytes;
+    size_t words = len - len % sizeof(uint64_t);
+    *hash = hash_words(*hash, buffer, words);
+    held = len - words;
+    memmove(buffer, buffer + words, held);
+  }
+}
+
+static int emit(struct Builder* builder, const void* bytes, size_t n) {
+  struct Program* program = builder->program;
+  if (program->size + n > builder->capacity) {
+    size_t capacity = builder->capacity * 2 + n;
+    program = (struct Program*)realloc(program, sizeof(struct Program) + capacity);
+    if (!program) return 1;
+    builder->program = program;
+    builder->capacity = capacity;
+  }
+
+  memcpy(program->code + program->size, bytes, n);
+  program->size += n;
+  return 0;
+}
+
+// little endian base 128, 7 bits per byte with the top bit set on every byte but the last, so the small ids and
+// coordinates that make up most of a file take a single byte
+static int emit_uint(struct Builder* builder, size_t value) {
+  unsigned char bytes[5];
+  size_t n = 0;
+  while (value >= 0x80) {
+    bytes[n++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  bytes[n++] = (unsigned char)value;
+  return emit(builder, bytes, n);
+}
+
+static int emit_instruction(struct Builder* builder, enum Command command, const struct Operands* operands) {
+  unsigned char head[2] = {(unsigned char)command, (unsigned char)operands->valid};
+  if (emit(builder, head, sizeof(head))) return 1;
+  if (!operands->valid) return 0;
+
+  switch (command) {
+    case CMD_CREATE:
+      return emit_uint(builder, operands->event_id) || emit_uint(builder, operands->num_rows) ||
+             emit_uint(builder, operands->num_cols);
+
+    case CMD_RESERVE:
+      if (emit_uint(builder, operands->event_id) || emit_uint(builder, operands->num_coords)) return 1;
+      for (size_t i = 0; i < operands->num_coords; i++) {
+        if (emit_uint(builder, operands->xs[i]) || emit_uint(builder, operands->ys[i])) return 1;
+      }
+      return 0;
+
+    case CMD_RESERVE_BEST:
+      return emit_uint(builder, operands->event_id) || emit_uint(builder, operands->num_coords);
+
+    case CMD_CANCEL:
+      return emit_uint(builder, operands->event_id) || emit_uint(builder, operands->reservation_id);
+
+    case CMD_SHOW:
+    case CMD_MEMORY:
+    case CMD_AVAILABLE:
+      return emit_uint(builder, operands->event_id);
+
+    case CMD_WAIT:
+      return emit_uint(builder, operands->delay) || emit_uint(builder, operands->thread_id);
+
+    case CMD_LIST_EVENTS:
+    case CMD_BARRIER:
+    case CMD_HELP:
+    case CMD_EMPTY:
+    case CMD_INVALID:
+    case EOC:
+      return 0;
+  }
+  return 0;
+}
+
+// parses the whole file once, turning every command into an instruction. A file that can not be mapped is read into
+// a buffer as usual
+static struct Program* compile_program(int fd, int map_input) {
+  if (lseek(fd, 0, SEEK_SET) != 0) return NULL;
+
+  struct Reader* reader = map_input ? create_mapped_reader(fd) : NULL;
+  if (!reader) reader = create_reader(fd);
+  if (!reader) return NULL;
+
+  struct Builder builder = {.program = (struct Program*)malloc(sizeof(struct Program) + READER_BUFFER_SIZE),
+                            .capacity = READER_BUFFER_SIZE};
+  if (!builder.program) {
+    free_reader(reader);
+    return NULL;
+  }
+  builder.program->size = 0;
+
+  struct Operands operands = {0};
+  enum Command command;
+  while ((command = parse_command(reader, &operands)) != EOC) {
+    if (emit_instruction(&builder, command, &operands)) {
+      free(builder.program);
+      free_reader(reader);
+      return NULL;
+    }
+  }
+
+  free_reader(reader);
+  return builder.program;
+}
+
+static int decode_instruction(const struct Program* program, size_t* pc, enum Command* command,
+                              struct Operands* operands);
+
+// reads the compiled file, NULL if it is missing, was not compiled from the given source or does not decode. A
+// compiled file is never trusted further than its header: its size, the hash of its code and every instruction are
+// checked before it is used
+static struct Program* read_program(const char* program_path, uint64_t source_size, uint64_t source_hash) {
+  int fd = open(program_path, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct ProgramHeader header;
+  struct stat status;
+  if (read_all(fd, &header, sizeof(header)) || memcmp(header.magic, program_magic, sizeof(program_magic)) != 0 ||
+      header.version != PROGRAM_VERSION || header.source_size != source_size || header.source_hash != source_hash ||
+      fstat(fd, &status) != 0 || (uint64_t)status.st_size != sizeof(header) + header.code_size) {
+    close(fd);
+    return NULL;
+  }
+
+  struct Program* program = (struct Program*)malloc(sizeof(struct Program) + header.code_size);
+  if (!program || read_all(fd, program->code, header.code_size)) {
+    free(program);
+    close(fd);
+    return NULL;
+  }
+  program->size = header.code_size;
+  close(fd);
+
+  if (hash_code(program) != header.code_hash) {
+    free(program);
+    return NULL;
+  }
+
+  struct Operands operands;
+  enum Command command;
+  for (size_t pc = 0; pc < program->size;) {
+    if (decode_instruction(program, &pc, &command, &operands)) {
+      free(program);
+      return NULL;
+    }
+  }
+
+  return program;
+}
+
+// writes the compiled file under a temporary name first, so it is never seen half written
+static void write_program(const char* program_path, const struct Program* program, uint64_t source_size,
+                          uint64_t source_hash) {
+  struct ProgramHeader header = {.version = PROGRAM_VERSION,
+                                 .source_size = source_size,
+                                 .source_hash = source_hash,
+                                 .code_size = program->size,
+                                 .code_hash = hash_code(program)};
+  memcpy(header.magic, program_magic, sizeof(program_magic));
+
+  char temp_path[strlen(program_path) + 5];
+  strcpy(temp_path, program_path);
+  strcat(temp_path, ".tmp");
+
+  int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return;
+
+  int failed = write_all(fd, &header, sizeof(header)) || write_all(fd, program->code, program->size);
+  if (close(fd) != 0 || failed || rename(temp_path, program_path) != 0) {
+    unlink(temp_path);
+  }
+}
+
+struct Program* load_program(const char* jobs_path, const char* program_path, int map_input) {
+  int fd = open(jobs_path, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  uint64_t source_size, source_hash;
+  if (hash_source(fd, &source_size, &source_hash)) {
+    close(fd);
+    return NULL;
+  }
+
+  struct Program* program = read_program(program_path, source_size, source_hash);
+  if (program) {
+    close(fd);
+    return program;
+  }
+
+  program = compile_program(fd, map_input);
+
+  // a source that changed while it was compiled is not cached under the hash it had before
+  uint64_t compiled_size, compiled_hash;
+  if (program && !hash_source(fd, &compiled_size, &compiled_hash) && compiled_size == source_size &&
+      compiled_hash == source_hash) {
+    write_program(program_path, program, source_size, source_hash);
+  }
+
+  close(fd);
+  return program;
+}
+
+// reads a variable length integer that must end before end and fit an unsigned int, 1 if it does not
+static int next_uint(const unsigned char** code, const unsigned char* end, size_t* value) {
+  *value = 0;
+  unsigned int shift = 0;
+  unsigned char byte;
+  do {
+    if (*code == end || shift > 28) return 1;
+    byte = *(*code)++;
+    *value |= (size_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return *value > UINT_MAX;
+}
+
+static int next_uint32(const unsigned char** code, const unsigned char* end, unsigned int* value) {
+  size_t wide;
+  if (next_uint(code, end, &wide)) return 1;
+  *value = (unsigned int)wide;
+  return 0;
+}
+
+// decodes the instruction at pc, 1 if it runs past the end of the program or holds what no compilation emits
+static int decode_instruction(const struct Program* program, size_t* pc, enum Command* command,
+                              struct Operands* operands) {
+  const unsigned char* code = program->code + *pc;
+  const unsigned char* end = program->code + program->size;
+  if (end - code < 2 || code[0] >= EOC || code[1] > 1) return 1;
+
+  *command = (enum Command)code[0];
+  operands->valid = code[1];
+  code += 2;
+
+  if (operands->valid) {
+    switch (*command) {
+      case CMD_CREATE:
+        if (next_uint32(&code, end, &operands->event_id) || next_uint(&code, end, &operands->num_rows) ||
+            next_uint(&code, end, &operands->num_cols)) {
+          return 1;
+        }
+        break;
+
+      case CMD_RESERVE:
+        if (next_uint32(&code, end, &operands->event_id) || next_uint(&code, end, &operands->num_coords) ||
+            operands->num_coords > MAX_RESERVATION_SIZE) {
+          return 1;
+        }
+        for (size_t i = 0; i < operands->num_coords; i++) {
+          if (next_uint(&code, end, &operands->xs[i]) || next_uint(&code, end, &operands->ys[i])) return 1;
+        }
+        break;
+
+      case CMD_RESERVE_BEST:
+        if (next_uint32(&code, end, &operands->event_id) || next_uint(&code, end, &operands->num_coords)) return 1;
+        break;
+
+      case CMD_CANCEL:
+        if (next_uint32(&code, end, &operands->event_id) || next_uint32(&code, end, &operands->reservation_id)) {
+          return 1;
+        }
+        break;
+
+      case CMD_SHOW:
+      case CMD_MEMORY:
+      case CMD_AVAILABLE:
+        if (next_uint32(&code, end, &operands->event_id)) return 1;
+        break;
+
+      case CMD_WAIT:
+        if (next_uint32(&code, end, &operands->delay) || next_uint32(&code, end, &operands->thread_id)) return 1;
+        break;
+
+      case CMD_LIST_EVENTS:
+      case CMD_BARRIER:
+      case CMD_HELP:
+      case CMD_EMPTY:
+      case CMD_INVALID:
+      case EOC:
+        break;
+    }
+  }
+
+  *pc = (size_t)(code - program->code);
+  return 0;
+}
+
+enum Command next_instruction(const struct Program* program, size_t* pc, struct Operands* operands) {
+  enum Command command;
+  if (*pc >= program->size || decode_instruction(program, pc, &command, operands)) return EOC;
+  return command;
+}
+
+void free_program(struct Program* program) { free(program); }
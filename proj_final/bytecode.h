@@ -0,0 +1,53 @@
+#ifndef EMS_BYTECODE_H
+#define EMS_BYTECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parser.h"
+
+#define PROGRAM_EXTENSION ".ems"  // Extension of the compiled file kept next to each .jobs file
+#define PROGRAM_VERSION 2         // Bumped whenever the encoding changes, so older compiled files are stale
+
+// Header of a compiled file. The program is fresh only while the .jobs file still has the size and hash it was
+// compiled from, and is used only while the code that follows still has its size and hash
+struct ProgramHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_size;
+  uint64_t source_hash;
+  uint64_t code_size;
+  uint64_t code_hash;
+};
+
+// A .jobs file compiled to one instruction per command read from it. Every instruction is the command as a byte,
+// whether its arguments were valid as a byte and, if they were, the arguments as variable length integers: the event
+// id followed by the rows and columns, the number of coordinates and the packed coordinates, the seats, the
+// reservation id or the delay and thread
+struct Program {
+  size_t size;
+  unsigned char code[];
+};
+
+/// Gets the program of a .jobs file, from its compiled file when it is fresh.
+/// @note Otherwise the .jobs file is compiled again and the compiled file rewritten, a compiled file that can not be
+/// written only costs the next run a new compilation. A compiled file that is truncated, corrupt or does not decode
+/// is treated as stale.
+/// @param jobs_path Path of the .jobs file.
+/// @param program_path Path of its compiled file.
+/// @param map_input Whether the .jobs file is mapped and scanned in place when it has to be compiled.
+/// @return The program, NULL if the .jobs file can not be read.
+struct Program* load_program(const char* jobs_path, const char* program_path, int map_input);
+
+/// Decodes the instruction at pc.
+/// @param program Program to decode from.
+/// @param pc Offset of the instruction, moved past it.
+/// @param operands Receives the arguments, those of a valid command exactly as parse_command gives them.
+/// @return The command of the instruction, EOC past the last one or at an instruction that does not decode.
+enum Command next_instruction(const struct Program* program, size_t* pc, struct Operands* operands);
+
+/// Frees a program.
+/// @param program Program to be freed.
+void free_program(struct Program* program);
+
+#endif  // EMS_BYTECODE_H
@@ -1,2 +1,3 @@
 #define MAX_RESERVATION_SIZE 256
 #define STATE_ACCESS_DELAY_MS 10
+#define JOB_QUEUE_SIZE 32  // parsed commands a worker can have waiting for it, or for their state access
@@ -0,0 +1,61 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Reader state of a single thread, kept in its own cache line so readers never share written memory
+struct EpochRecord {
+  _Alignas(64) _Atomic unsigned long epoch;  // Epoch observed by the reader, 0 outside a critical section
+  atomic_int in_use;                         // RECORD_FREE, RECORD_OWNED or RECORD_ORPHANED
+  struct EpochRecord* next;
+};
+
+// Memory waiting for every reader that could still see it to leave its critical section
+struct EpochRetired {
+  void* ptr;
+  unsigned long epoch;  // Global epoch when the memory was retired
+  struct EpochRetired* next;
+};
+
+// Epoch based reclamation domain
+struct EpochDomain {
+  _Atomic unsigned long global;                // Current global epoch, starts at 1
+  _Atomic(struct EpochRecord*) records;        // Every reader record ever registered
+  pthread_mutex_t retire_lock;                 // Protects the retired list
+  struct EpochRetired* retired;
+  unsigned long generation;                    // Tells the domain apart from an earlier one at the same address
+};
+
+/// Initializes an epoch domain.
+/// @param domain Domain to be initialized.
+/// @return 0 if the domain was initialized successfully, 1 otherwise.
+int epoch_init(struct EpochDomain* domain);
+
+/// Frees every retired pointer and the records no longer owned by a thread.
+/// @note No reader may be inside a critical section. A record a thread still owns is handed to that thread, which frees
+/// it when it exits or moves to another domain.
+/// @param domain Domain to be destroyed.
+void epoch_destroy(struct EpochDomain* domain);
+
+/// Enters a read side critical section.
+/// @note Only writes to the calling thread's own record.
+/// @param domain Domain of the shared memory about to be read.
+void epoch_enter(struct EpochDomain* domain);
+
+/// Leaves a read side critical section.
+/// @param domain Domain given to epoch_enter.
+void epoch_exit(struct EpochDomain* domain);
+
+/// Frees the given pointer once no reader can still hold it.
+/// @note The pointer must already be unreachable for new readers.
+/// @param domain Domain the readers of the pointer use.
+/// @param ptr Pointer to be freed.
+/// @return 0 if the pointer was retired, 1 if it could not be tracked and was leaked.
+int epoch_retire(struct EpochDomain* domain, void* ptr);
+
+/// Advances the global epoch if every active reader has seen it and frees what is safe to free.
+/// @param domain Domain to be collected.
+void epoch_collect(struct EpochDomain* domain);
+
+#endif  // EPOCH_H
@@ -1,28 +1,529 @@
 #include "eventlist.h"
 
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#include "constants.h"
+
+#define INITIAL_BUCKETS 64
+#define CACHE_LINE 64
+#define ARENA_CHUNK_SIZE (1 << 20)  // events bigger than a quarter of a chunk get a chunk of their own
+
+// rounds a size up to a whole number of cache lines
+static size_t align_up(size_t size) { return (size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1); }
+
+// spreads consecutive event ids over the buckets
+static size_t hash_id(unsigned int event_id, size_t n_buckets) {
+  return (size_t)(event_id * 2654435761u) & (n_buckets - 1);
+}
+
+// allocates a table with its entry pool in the same block
+static struct BucketTable* create_table(size_t n_buckets) {
+  struct BucketTable* table = (struct BucketTable*)malloc(sizeof(struct BucketTable) +
+                                                          n_buckets * sizeof(_Atomic(struct BucketEntry*)) +
+                                                          n_buckets * sizeof(struct BucketEntry));
+  if (!table) return NULL;
+  table->n_buckets = n_buckets;
+  table->used = 0;
+  table->entries = (struct BucketEntry*)(table->buckets + n_buckets);
+  for (size_t i = 0; i < n_buckets; i++) {
+    atomic_init(&table->buckets[i], NULL);
+  }
+  return table;
+}
+
+// links a node into the table, the release store publishes it to the readers
+static void insert_entry(struct BucketTable* table, struct ListNode* node) {
+  struct BucketEntry* entry = &table->entries[table->used++];
+  size_t bucket = hash_id(node->event->id, table->n_buckets);
+  entry->node = node;
+  atomic_init(&entry->next, atomic_load_explicit(&table->buckets[bucket], memory_order_relaxed));
+  atomic_store_explicit(&table->buckets[bucket], entry, memory_order_release);
+}
+
 struct EventList* create_list() { // constructor that initializes an event list
   struct EventList* list = (struct EventList*)malloc(sizeof(struct EventList)); // assigns the size of an struct
   if (!list) return NULL;
+  struct BucketTable* table = create_table(INITIAL_BUCKETS);
+  if (!table) {
+    free(list);
+    return NULL;
+  }
+  if (epoch_init(&list->epoch)) {
+    free(table);
+    free(list);
+    return NULL;
+  }
+  if (pthread_mutex_init(&list->arena_lock, NULL) != 0) {
+    epoch_destroy(&list->epoch);
+    free(table);
+    free(list);
+    return NULL;
+  }
+  atomic_init(&list->table, table);
+  list->chunks = NULL;
   list->head = NULL;
   list->tail = NULL;
   return list;
 }
 
+// allocates a zeroed chunk with the given usable size
+static struct ArenaChunk* create_chunk(size_t size) {
+  // calloc leaves big chunks to the kernel's zero pages, so untouched seats never become resident
+  struct ArenaChunk* chunk = (struct ArenaChunk*)calloc(1, sizeof(struct ArenaChunk) + CACHE_LINE + size);
+  if (!chunk) return NULL;
+  chunk->data = (unsigned char*)align_up((uintptr_t)(chunk + 1));
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->next = NULL;
+  return chunk;
+}
+
+// hands out zeroed memory from the list's arena
+static void* arena_alloc(struct EventList* list, size_t size) {
+  pthread_mutex_lock(&list->arena_lock);
+  struct ArenaChunk* chunk = list->chunks;
+  if (size > ARENA_CHUNK_SIZE / 4) {
+    // a dedicated chunk goes behind the current one, which keeps being filled
+    chunk = create_chunk(size);
+    if (chunk && list->chunks) {
+      chunk->next = list->chunks->next;
+      list->chunks->next = chunk;
+    } else if (chunk) {
+      list->chunks = chunk;
+    }
+  } else if (!chunk || chunk->size - chunk->used < size) {
+    chunk = create_chunk(ARENA_CHUNK_SIZE);
+    if (chunk) {
+      chunk->next = list->chunks;
+      list->chunks = chunk;
+    }
+  }
+
+  if (!chunk) {
+    pthread_mutex_unlock(&list->arena_lock);
+    return NULL;
+  }
+
+  void* ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  pthread_mutex_unlock(&list->arena_lock);
+  return ptr;
+}
+
+// size of the block holding the event, its tile table, its bitmap and its row counters
+static size_t event_block_size(size_t n_rows, size_t n_seats, size_t n_tiles) {
+  return align_up(sizeof(struct Event)) + align_up(n_tiles * sizeof(_Atomic(_Atomic(unsigned int)*))) +
+         align_up((n_seats + 63) / 64 * sizeof(_Atomic(uint64_t))) + align_up(n_rows * sizeof(_Atomic(size_t)));
+}
+
+struct Event* create_event(struct EventList* list, unsigned int event_id, size_t num_rows, size_t num_cols) {
+  if (!list) return NULL;
+
+  if (num_cols != 0 && num_rows > SIZE_MAX / 2 / num_cols) return NULL;
+  size_t n_seats = num_rows * num_cols;
+  size_t n_tiles = (n_seats + SEAT_TILE_SIZE - 1) / SEAT_TILE_SIZE;
+
+  struct Event* event = arena_alloc(list, event_block_size(num_rows, n_seats, n_tiles));
+  if (!event) return NULL;
+
+  // the block is zeroed, so every seat starts free, unmarked and without a tile and every row starts with none taken
+  event->id = event_id;
+  event->rows = num_rows;
+  event->cols = num_cols;
+  atomic_init(&event->reservations, 0);
+  event->tiles = (_Atomic(_Atomic(unsigned int)*)*)((unsigned char*)event + align_up(sizeof(struct Event)));
+  event->n_tiles = n_tiles;
+  event->used_tiles = 0;
+  event->occupied = (_Atomic(uint64_t)*)((unsigned char*)event->tiles +
+                                         align_up(n_tiles * sizeof(_Atomic(_Atomic(unsigned int)*))));
+  atomic_init(&event->free_runs, NULL);
+  atomic_init(&event->taken_seats, 0);
+  atomic_init(&event->record_bytes, 0);
+  for (size_t i = 0; i < RESERVATION_SEGMENTS; i++) {
+    atomic_init(&event->reservation_index[i], NULL);
+  }
+  event->row_taken = (_Atomic(size_t)*)((unsigned char*)event->occupied +
+                                        align_up((n_seats + 63) / 64 * sizeof(_Atomic(uint64_t))));
+  event->node.event = event;
+  event->node.next = NULL;
+  return event;
+}
+
+int claim_seats(struct Event* event, size_t num_seats, const size_t* indexes) {
+  if (num_seats > MAX_RESERVATION_SIZE) return 1;
+
+  size_t words[MAX_RESERVATION_SIZE];
+  uint64_t masks[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < num_seats; i++) {
+    words[i] = indexes[i] / 64;
+    masks[i] = (uint64_t)1 << (indexes[i] % 64);
+  }
+
+  // the common case of a taken seat is rejected without writing to the bitmap shared with the other threads
+  uint64_t taken = 0;
+  for (size_t i = 0; i < num_seats; i++) {
+    taken |= atomic_load_explicit(&event->occupied[words[i]], memory_order_relaxed) & masks[i];
+  }
+  if (taken) return 1;
+
+  // a bit that was already set belongs to another reservation or to a repeated seat, only the bits set here are undone
+  for (size_t i = 0; i < num_seats; i++) {
+    if (atomic_fetch_or_explicit(&event->occupied[words[i]], masks[i], memory_order_acquire) & masks[i]) {
+      for (size_t j = 0; j < i; j++) {
+        atomic_fetch_and_explicit(&event->occupied[words[j]], ~masks[j], memory_order_release);
+      }
+      return 1;
+    }
+  }
+
+  // the counters only follow the bitmap, nothing is decided from them
+  for (size_t i = 0; i < num_seats; i++) {
+    atomic_fetch_add_explicit(&event->row_taken[indexes[i] / event->cols], 1, memory_order_relaxed);
+  }
+  atomic_fetch_add_explicit(&event->taken_seats, num_seats, memory_order_relaxed);
+  return 0;
+}
+
+// smallest power of two that is at least size
+static size_t round_pow2(size_t size) {
+  size_t pow2 = 1;
+  while (pow2 < size) pow2 *= 2;
+  return pow2;
+}
+
+// joins the runs of two adjacent ranges of len seats each
+static struct FreeRun join_runs(struct FreeRun left, struct FreeRun right, unsigned int len) {
+  struct FreeRun run;
+  run.prefix = left.prefix == len ? len + right.prefix : left.prefix;
+  run.suffix = right.suffix == len ? len + left.suffix : right.suffix;
+  run.best = left.suffix + right.prefix;
+  if (left.best > run.best) run.best = left.best;
+  if (right.best > run.best) run.best = right.best;
+  return run;
+}
+
+// recomputes the longest run of the rows above a row after its tree changed
+static void update_row(struct FreeRunIndex* index, size_t row) {
+  size_t node = index->row_width + row;
+  index->row_best[node] = index->runs[row * 2 * index->width + 1].best;
+  for (node /= 2; node > 0; node /= 2) {
+    unsigned int left = index->row_best[2 * node], right = index->row_best[2 * node + 1];
+    index->row_best[node] = left > right ? left : right;
+  }
+}
+
+// copies the state of the given seats from the bitmap into the index, which must be locked
+static void refresh_runs(struct FreeRunIndex* index, const struct Event* event, size_t num_seats,
+                         const size_t* indexes) {
+  for (size_t i = 0; i < num_seats; i++) {
+    size_t row = indexes[i] / event->cols;
+    struct FreeRun* tree = &index->runs[row * 2 * index->width];
+    unsigned int is_free = !(atomic_load_explicit(&event->occupied[indexes[i] / 64], memory_order_relaxed) &
+                             ((uint64_t)1 << (indexes[i] % 64)));
+
+    size_t node = index->width + indexes[i] % event->cols;
+    tree[node] = (struct FreeRun){is_free, is_free, is_free};
+    for (unsigned int len = 1; node > 1; len *= 2) {
+      node /= 2;
+      tree[node] = join_runs(tree[2 * node], tree[2 * node + 1], len);
+    }
+
+    // the rows only need the longest run once every seat of the row is in
+    if (i + 1 == num_seats || indexes[i + 1] / event->cols != row) update_row(index, row);
+  }
+}
+
+// builds the index of an event from its bitmap, the event's lock must be held as a writer
+static struct FreeRunIndex* create_free_runs(struct EventList* list, struct Event* event) {
+  size_t width = round_pow2(event->cols);
+  size_t row_width = round_pow2(event->rows);
+  if (event->rows > SIZE_MAX / sizeof(struct FreeRun) / 2 / width) return NULL;
+
+  struct FreeRunIndex* index = arena_alloc(list, align_up(sizeof(struct FreeRunIndex)) +
+                                                     align_up(event->rows * 2 * width * sizeof(struct FreeRun)) +
+                                                     2 * row_width * sizeof(unsigned int));
+  if (!index) return NULL;
+  index->width = width;
+  index->row_width = row_width;
+  index->runs = (struct FreeRun*)((unsigned char*)index + align_up(sizeof(struct FreeRunIndex)));
+  index->row_best =
+      (unsigned int*)((unsigned char*)index->runs + align_up(event->rows * 2 * width * sizeof(struct FreeRun)));
+
+  // published before the bitmap is read, a reservation either sees the index or has its seat read below
+  atomic_store(&event->free_runs, index);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  for (size_t row = 0; row < event->rows; row++) {
+    struct FreeRun* tree = &index->runs[row * 2 * width];
+    for (size_t col = 0; col < event->cols; col++) {
+      size_t seat = row * event->cols + col;
+      unsigned int is_free = !(atomic_load_explicit(&event->occupied[seat / 64], memory_order_relaxed) &
+                               ((uint64_t)1 << (seat % 64)));
+      tree[width + col] = (struct FreeRun){is_free, is_free, is_free};
+    }
+
+    // every level is built from the one below, the zeroed leaves past the last column stay taken
+    for (size_t level = width / 2, len = 1; level > 0; level /= 2, len *= 2) {
+      for (size_t node = level; node < 2 * level; node++) {
+        tree[node] = join_runs(tree[2 * node], tree[2 * node + 1], (unsigned int)len);
+      }
+    }
+    update_row(index, row);
+  }
+  return index;
+}
+
+// finds the first row with num_seats adjacent free seats and the first column they start at
+static int find_free_run(const struct FreeRunIndex* index, unsigned int num_seats, size_t* row, size_t* col) {
+  if (index->row_best[1] < num_seats) return 1;
+
+  size_t node = 1;
+  while (node < index->row_width) {
+    node = index->row_best[2 * node] >= num_seats ? 2 * node : 2 * node + 1;
+  }
+  *row = node - index->row_width;
+
+  // the leftmost run is either inside the left half, across the middle or inside the right half
+  const struct FreeRun* tree = &index->runs[*row * 2 * index->width];
+  size_t start = 0;
+  node = 1;
+  for (size_t len = index->width; node < index->width; len /= 2) {
+    const struct FreeRun* left = &tree[2 * node];
+    const struct FreeRun* right = &tree[2 * node + 1];
+    if (left->best >= num_seats) {
+      node = 2 * node;
+    } else if (left->suffix + right->prefix >= num_seats) {
+      *col = start + len / 2 - left->suffix;
+      return 0;
+    } else {
+      node = 2 * node + 1;
+      start += len / 2;
+    }
+  }
+  *col = start;
+  return 0;
+}
+
+int claim_free_run(struct EventList* list, struct Event* event, size_t num_seats, size_t* indexes) {
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE || num_seats > event->cols) return 1;
+
+  pthread_rwlock_wrlock(&event->event_lock_rw);
+  struct FreeRunIndex* index = atomic_load_explicit(&event->free_runs, memory_order_relaxed);
+  if (!index) index = create_free_runs(list, event);
+
+  while (index) {
+    size_t row, col;
+    if (find_free_run(index, (unsigned int)num_seats, &row, &col)) break;
+
+    for (size_t i = 0; i < num_seats; i++) {
+      indexes[i] = row * event->cols + col + i;
+    }
+    int taken = claim_seats(event, num_seats, indexes);
+    refresh_runs(index, event, num_seats, indexes);
+    if (!taken) {
+      pthread_rwlock_unlock(&event->event_lock_rw);
+      return 0;
+    }
+
+    // a reservation claimed one of the seats without the lock and has not updated the index yet, which was just done
+  }
+
+  pthread_rwlock_unlock(&event->event_lock_rw);
+  return 1;
+}
+
+void update_free_runs(struct Event* event, size_t num_seats, const size_t* indexes) {
+  // pairs with the fence in create_free_runs, the seats were claimed or released before
+  atomic_thread_fence(memory_order_seq_cst);
+  if (!atomic_load_explicit(&event->free_runs, memory_order_relaxed)) return;
+
+  pthread_rwlock_wrlock(&event->event_lock_rw);
+  refresh_runs(atomic_load_explicit(&event->free_runs, memory_order_relaxed), event, num_seats, indexes);
+  pthread_rwlock_unlock(&event->event_lock_rw);
+}
+
+void release_seats(struct Event* event, size_t num_seats, const size_t* indexes) {
+  for (size_t i = 0; i < num_seats; i++) {
+    atomic_fetch_and_explicit(&event->occupied[indexes[i] / 64], ~((uint64_t)1 << (indexes[i] % 64)),
+                              memory_order_release);
+    atomic_fetch_sub_explicit(&event->row_taken[indexes[i] / event->cols], 1, memory_order_relaxed);
+  }
+  atomic_fetch_sub_explicit(&event->taken_seats, num_seats, memory_order_relaxed);
+}
+
+// segment of the reverse index holding a reservation id and the id's position in it
+static size_t segment_of(unsigned int reservation_id, size_t* offset) {
+  size_t segment = (size_t)(31 - __builtin_clz(reservation_id));
+  *offset = reservation_id - ((size_t)1 << segment);
+  return segment;
+}
+
+// bytes allocated for the record of a reservation
+static size_t record_size(const struct ReservationSeats* seats) {
+  return sizeof(struct ReservationSeats) + seats->num_seats * sizeof(size_t);
+}
+
+struct ReservationSeats* prepare_reservation(struct Event* event, unsigned int reservation_id, size_t num_seats,
+                                             const size_t* indexes) {
+  if (reservation_id == 0) return NULL;
+
+  size_t offset;
+  size_t segment = segment_of(reservation_id, &offset);
+  if (!atomic_load_explicit(&event->reservation_index[segment], memory_order_acquire)) {
+    _Atomic(struct ReservationSeats*)* slots = calloc((size_t)1 << segment, sizeof(_Atomic(struct ReservationSeats*)));
+    if (!slots) return NULL;
+    _Atomic(struct ReservationSeats*)* expected = NULL;
+    if (!atomic_compare_exchange_strong_explicit(&event->reservation_index[segment], &expected, slots,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+      free(slots);
+    }
+  }
+
+  struct ReservationSeats* seats = malloc(sizeof(struct ReservationSeats) + num_seats * sizeof(size_t));
+  if (!seats) return NULL;
+  seats->num_seats = num_seats;
+  for (size_t i = 0; i < num_seats; i++) {
+    seats->seats[i] = indexes[i];
+  }
+  return seats;
+}
+
+void index_reservation(struct Event* event, unsigned int reservation_id, struct ReservationSeats* seats) {
+  size_t offset;
+  size_t segment = segment_of(reservation_id, &offset);
+  _Atomic(struct ReservationSeats*)* slots =
+      atomic_load_explicit(&event->reservation_index[segment], memory_order_acquire);
+
+  struct ReservationSeats* expected = NULL;
+  if (!atomic_compare_exchange_strong_explicit(&slots[offset], &expected, seats, memory_order_release,
+                                               memory_order_relaxed)) {
+    free(seats);
+    return;
+  }
+  atomic_fetch_add_explicit(&event->record_bytes, record_size(seats), memory_order_relaxed);
+}
+
+struct ReservationSeats* take_reservation(struct Event* event, unsigned int reservation_id) {
+  if (reservation_id == 0) return NULL;
+
+  size_t offset;
+  size_t segment = segment_of(reservation_id, &offset);
+  _Atomic(struct ReservationSeats*)* slots =
+      atomic_load_explicit(&event->reservation_index[segment], memory_order_acquire);
+  if (!slots) return NULL;
+
+  struct ReservationSeats* seats = atomic_exchange_explicit(&slots[offset], NULL, memory_order_acquire);
+  if (seats) atomic_fetch_sub_explicit(&event->record_bytes, record_size(seats), memory_order_relaxed);
+  return seats;
+}
+
+size_t count_free_seats(const struct Event* event, size_t* row_free) {
+  if (row_free) {
+    for (size_t row = 0; row < event->rows; row++) {
+      row_free[row] = event->cols - atomic_load_explicit(&event->row_taken[row], memory_order_relaxed);
+    }
+  }
+  return event->rows * event->cols - atomic_load_explicit(&event->taken_seats, memory_order_relaxed);
+}
+
+int materialize_seats(struct EventList* list, struct Event* event, size_t num_seats, const size_t* indexes) {
+  for (size_t i = 0; i < num_seats; i++) {
+    size_t tile = indexes[i] / SEAT_TILE_SIZE;
+    if (atomic_load_explicit(&event->tiles[tile], memory_order_acquire)) continue;
+
+    // checked again under the lock, another reservation in the same tile may have allocated it meanwhile
+    pthread_rwlock_wrlock(&event->event_lock_rw);
+    if (!atomic_load_explicit(&event->tiles[tile], memory_order_relaxed)) {
+      // tiles come from the arena, so a tile allocated for a failed reservation is simply kept
+      _Atomic(unsigned int)* seats = arena_alloc(list, SEAT_TILE_SIZE * sizeof(_Atomic(unsigned int)));
+      if (!seats) {
+        pthread_rwlock_unlock(&event->event_lock_rw);
+        return 1;
+      }
+      atomic_store_explicit(&event->tiles[tile], seats, memory_order_release);
+      event->used_tiles++;
+    }
+    pthread_rwlock_unlock(&event->event_lock_rw);
+  }
+  return 0;
+}
+
+unsigned int read_seat(const struct Event* event, size_t index) {
+  _Atomic(unsigned int)* tile = atomic_load_explicit(&event->tiles[index / SEAT_TILE_SIZE], memory_order_acquire);
+  return tile ? atomic_load_explicit(&tile[index % SEAT_TILE_SIZE], memory_order_relaxed) : 0;
+}
+
+int read_tile(const struct Event* event, size_t tile, size_t num_seats, unsigned int* seats) {
+  _Atomic(unsigned int)* seats_of_tile = atomic_load_explicit(&event->tiles[tile], memory_order_acquire);
+  if (!seats_of_tile) return 1;
+
+  for (size_t i = 0; i < num_seats; i++) {
+    seats[i] = atomic_load_explicit(&seats_of_tile[i], memory_order_relaxed);
+  }
+  return 0;
+}
+
+void write_seat(struct Event* event, size_t index, unsigned int reservation_id) {
+  _Atomic(unsigned int)* tile = atomic_load_explicit(&event->tiles[index / SEAT_TILE_SIZE], memory_order_relaxed);
+  atomic_store_explicit(&tile[index % SEAT_TILE_SIZE], reservation_id, memory_order_relaxed);
+}
+
+size_t event_memory(const struct Event* event) {
+  size_t bytes = event_block_size(event->rows, event->rows * event->cols, event->n_tiles) +
+                 event->used_tiles * SEAT_TILE_SIZE * sizeof(_Atomic(unsigned int));
+
+  for (size_t segment = 0; segment < RESERVATION_SEGMENTS; segment++) {
+    if (atomic_load(&event->reservation_index[segment])) {
+      bytes += ((size_t)1 << segment) * sizeof(_Atomic(struct ReservationSeats*));
+    }
+  }
+  bytes += atomic_load_explicit(&event->record_bytes, memory_order_relaxed);
+
+  const struct FreeRunIndex* index = atomic_load(&event->free_runs);
+  if (index) {
+    bytes += align_up(sizeof(struct FreeRunIndex)) + align_up(event->rows * 2 * index->width * sizeof(struct FreeRun)) +
+             2 * index->row_width * sizeof(unsigned int);
+  }
+  return bytes;
+}
+
+// replaces the table with one twice the size, must be called with the list write lock held
+static int grow_table(struct EventList* list) {
+  struct BucketTable* old_table = atomic_load_explicit(&list->table, memory_order_relaxed);
+  struct BucketTable* table = create_table(old_table->n_buckets * 2);
+  if (!table) return 1;
+
+  // the append order list already has every node, so the index is rebuilt from it
+  for (struct ListNode* current = list->head; current; current = current->next) {
+    insert_entry(table, current);
+  }
+
+  // readers may still be walking the old table, it is only freed once they are all gone
+  atomic_store_explicit(&list->table, table, memory_order_release);
+  if (epoch_retire(&list->epoch, old_table)) return 1;
+  return 0;
+}
+
 int append_to_list(struct EventList* list, struct Event* event) {
 
   if (!list) return 1;
 
   pthread_rwlock_wrlock(&list -> list_lock_rw);
-  struct ListNode* new_node = (struct ListNode*)malloc(sizeof(struct ListNode)); // node that will be added
-  if (!new_node){
-    pthread_rwlock_unlock(&list -> list_lock_rw); 
-    return 1;
-  } 
+  struct ListNode* new_node = &event->node; // node that will be added, it lives inside the event
+
+  // keeps at most one event per bucket on average
+  struct BucketTable* table = atomic_load_explicit(&list->table, memory_order_relaxed);
+  if (table->used == table->n_buckets) {
+    if (grow_table(list)) {
+      pthread_rwlock_unlock(&list -> list_lock_rw);
+      return 1;
+    }
+    table = atomic_load_explicit(&list->table, memory_order_relaxed);
+  }
 
-  new_node->event = event; // assigns the event to the new node created
-  new_node->next = NULL; // assigns the next node as NULL
+  insert_entry(table, new_node);
 
   if (list->head == NULL) { // if the given list is empty, assign the head and the tail since its the same
     list->head = new_node;
@@ -31,48 +532,58 @@ int append_to_list(struct EventList* list, struct Event* event) {
     list->tail->next = new_node;
     list->tail = new_node;
   }
+  epoch_collect(&list->epoch);
   pthread_rwlock_unlock(&list -> list_lock_rw);
   return 0;
 }
 
-static void free_event(struct Event* event) {
-  if (!event) return;
-
-  free(event->data); // frees the space occupied by the matrix
-  free(event);
-}
-
-void free_list(struct EventList* list) { 
+void free_list(struct EventList* list) {
   if (!list) return;
 
-  struct ListNode* current = list->head;
-  while (current) { // while there are nodes in the event list to be freed
-    struct ListNode* temp = current; // assign a temporary variable
-    current = current->next; // next node to free
+  // the seats of the reservations are the only part of an event allocated on its own
+  for (struct ListNode* current = list->head; current; current = current->next) {
+    for (size_t segment = 0; segment < RESERVATION_SEGMENTS; segment++) {
+      _Atomic(struct ReservationSeats*)* slots = atomic_load(&current->event->reservation_index[segment]);
+      if (!slots) continue;
+      for (size_t i = 0; i < (size_t)1 << segment; i++) {
+        free(atomic_load(&slots[i]));
+      }
+      free(slots);
+    }
+  }
 
-    free_event(temp->event);
+  // the events and their nodes live in the arena, so freeing its chunks releases all of them at once
+  struct ArenaChunk* chunk = list->chunks;
+  while (chunk) {
+    struct ArenaChunk* temp = chunk;
+    chunk = chunk->next;
     free(temp);
   }
 
+  pthread_mutex_destroy(&list->arena_lock);
+  epoch_destroy(&list->epoch);
+  free(atomic_load(&list->table));
   free(list);
 }
 
 struct Event* get_event(struct EventList* list, unsigned int event_id) {
   if (!list) return NULL;
 
-  pthread_rwlock_rdlock(&list -> list_lock_rw);
-  struct ListNode* current = list->head; // access the first node of the list
+  struct Event* event = NULL;
+
+  // readers only announce themselves in their own epoch record, the list lock is left to the writers
+  epoch_enter(&list->epoch);
+  struct BucketTable* table = atomic_load_explicit(&list->table, memory_order_acquire);
+  struct BucketEntry* current =
+      atomic_load_explicit(&table->buckets[hash_id(event_id, table->n_buckets)], memory_order_acquire);
   while (current) {
-    struct Event* event = current->event; 
-    pthread_rwlock_rdlock(&event -> event_lock_rw);
-    if (event->id == event_id) {
-      pthread_rwlock_unlock(&event -> event_lock_rw);
-      pthread_rwlock_unlock(&list -> list_lock_rw);
-      return event;
+    if (current->node->event->id == event_id) {
+      event = current->node->event;
+      break;
     }
-    pthread_rwlock_unlock(&event -> event_lock_rw);
-    current = current->next;
+    current = atomic_load_explicit(&current->next, memory_order_acquire);
   }
-  pthread_rwlock_unlock(&list -> list_lock_rw);
-  return NULL;
+  epoch_exit(&list->epoch);
+
+  return event;
 }
@@ -2,30 +2,103 @@
 #define EVENT_LIST_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
 
+#include "epoch.h"
+
+struct ListNode {
+  struct Event* event;
+  struct ListNode* next;
+};
+
+#define SEAT_TILE_SIZE 1024  // Seats per tile, a page of reservation ids
+
+// Free seats at both ends of a range of seats in a row and the longest run of free seats inside it
+struct FreeRun {
+  unsigned int prefix;
+  unsigned int suffix;
+  unsigned int best;
+};
+
+// Segment trees over the free seats of every row and over the longest free run of each row.
+// Node 1 is the root and node i has children 2i and 2i+1, the leaves come last
+struct FreeRunIndex {
+  size_t width;            // Leaves of a row tree, the number of columns rounded up to a power of two
+  size_t row_width;        // Leaves of the tree over the rows, the number of rows rounded up to a power of two
+  struct FreeRun* runs;    // One tree of 2 * width nodes per row, the leaves past the last column are never free
+  unsigned int* row_best;  // Tree of 2 * row_width nodes with the longest free run in the rows below each node
+};
+
+#define RESERVATION_SEGMENTS 32  // Segment k of the reverse index holds the reservation ids from 2^k to 2^(k+1) - 1
+
+// Seats of a reservation, kept so it can be cancelled without scanning the event
+struct ReservationSeats {
+  size_t num_seats;
+  size_t seats[];
+};
+
+// Allocated from the list's arena together with its tile table, bitmap and row counters, the tiles are added on first
+// write.
+// Seats are claimed and written without locks, the lock only guards the allocation of tiles and the free-run index
 struct Event {
-  unsigned int id;            /// Event id
-  unsigned int reservations;  /// Number of reservations for the event.
+  unsigned int id;                     /// Event id
+  _Atomic(unsigned int) reservations;  /// Number of reservations for the event.
 
   size_t cols;  /// Number of columns.
   size_t rows;  /// Number of rows.
 
-  unsigned int* data;  /// Array of size rows * cols with the reservations for each seat.
- 
-  pthread_rwlock_t event_lock_rw;
+  _Atomic(_Atomic(unsigned int)*)* tiles;   /// Reservations of SEAT_TILE_SIZE seats each, NULL while all are free.
+  size_t n_tiles;                           /// Number of tiles covering the rows * cols seats.
+  size_t used_tiles;                        /// Number of tiles allocated so far.
+  _Atomic(uint64_t)* occupied;              /// Bitmap of size rows * cols with a bit set for every reserved seat.
+  _Atomic(struct FreeRunIndex*) free_runs;  /// Index of the free runs of every row, NULL until RESERVE_BEST needs it.
+  _Atomic(size_t) taken_seats;              /// Number of claimed seats, the free ones are rows * cols minus these.
+  _Atomic(size_t)* row_taken;               /// Number of claimed seats in each row.
+
+  /// Reverse index from reservation id to its seats, the ids are handed out in order so every segment fills up.
+  _Atomic(_Atomic(struct ReservationSeats*)*) reservation_index[RESERVATION_SEGMENTS];
+  _Atomic(size_t) record_bytes;  /// Bytes of the reservation records held by the reverse index.
+
+  pthread_rwlock_t event_lock_rw;  /// Taken as a writer to add a tile or update the index, as a reader to count tiles.
+
+  struct ListNode node;  /// Node linking the event into the list.
 };
 
-struct ListNode {
-  struct Event* event;
-  struct ListNode* next;
+// Chunk of memory the events are carved from, only freed together with the list
+struct ArenaChunk {
+  struct ArenaChunk* next;
+  unsigned char* data;  // Cache line aligned start of the usable memory
+  size_t size;          // Number of usable bytes
+  size_t used;          // Number of bytes already handed out
+};
+
+// Entry of a bucket chain, owned by the bucket table it was inserted in
+struct BucketEntry {
+  struct ListNode* node;
+  _Atomic(struct BucketEntry*) next;
+};
+
+// Hash index of the nodes by event id, replaced as a whole when it grows
+struct BucketTable {
+  size_t n_buckets;              // Number of buckets, always a power of two
+  size_t used;                   // Number of entries in use, at most n_buckets
+  struct BucketEntry* entries;   // Entry pool, stored right after the buckets
+  _Atomic(struct BucketEntry*) buckets[];
 };
 
-// Linked list structure
+// Linked list structure, indexed by event id
 struct EventList {
   struct ListNode* head;  // Head of the list
   struct ListNode* tail;  // Tail of the list
-  pthread_rwlock_t list_lock_rw;
+
+  _Atomic(struct BucketTable*) table;  // Read without locks, old tables are reclaimed through the epoch domain
+  struct EpochDomain epoch;
+
+  pthread_rwlock_t list_lock_rw;  // Taken as a writer to append and as a reader to iterate
+
+  struct ArenaChunk* chunks;   // Arena holding every event of the list
+  pthread_mutex_t arena_lock;  // Protects the arena
 };
 
 
@@ -36,9 +109,119 @@ struct EventList {
 /// @return Newly created event list, NULL on failure
 struct EventList* create_list();
 
+/// Allocates an event with every seat free from the list's arena, without any seat tile.
+/// @note The event is released together with the list, never on its own.
+/// @param list Event list whose arena the event is carved from.
+/// @param event_id Event id.
+/// @param num_rows Number of rows of the event.
+/// @param num_cols Number of columns of the event.
+/// @return Newly created event, NULL on failure
+struct Event* create_event(struct EventList* list, unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Marks the given seats as occupied if all of them are free and no seat is repeated.
+/// @note Lock free, every seat is claimed with an atomic read-modify-write and the claimed ones are given back
+/// if another is taken, so reservations of disjoint seats never wait for each other. Counts the seats as taken.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats to claim, at most MAX_RESERVATION_SIZE.
+/// @param indexes Array of seat indexes.
+/// @return 0 if every seat was claimed, 1 if nothing was claimed because a seat was taken or repeated.
+int claim_seats(struct Event* event, size_t num_seats, const size_t* indexes);
+
+/// Finds and claims the first num_seats adjacent free seats in a row, trying the rows and columns in order.
+/// @note Builds the free-run index of the event on first use, the reservations made afterwards keep it up to date.
+/// Takes the event's lock as a writer.
+/// @param list Event list whose arena the index is carved from.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of adjacent seats to claim, at most MAX_RESERVATION_SIZE.
+/// @param indexes Array of size num_seats that receives the indexes of the claimed seats.
+/// @return 0 if the seats were claimed, 1 if no row has enough adjacent free seats or the index could not be built.
+int claim_free_run(struct EventList* list, struct Event* event, size_t num_seats, size_t* indexes);
+
+/// Brings the free-run index up to date after the given seats were claimed or released.
+/// @note Does nothing until the index is built, otherwise takes the event's lock as a writer.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats.
+/// @param indexes Array of seat indexes.
+void update_free_runs(struct Event* event, size_t num_seats, const size_t* indexes);
+
+/// Gives back seats claimed by claim_seats.
+/// @note Lock free, the seats must have been claimed by the caller. Counts the seats as free again.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats to release.
+/// @param indexes Array of seat indexes.
+void release_seats(struct Event* event, size_t num_seats, const size_t* indexes);
+
+/// Counts the free seats of an event and of each of its rows.
+/// @note Lock free and without reading any seat, a reservation being claimed may be counted in some rows only.
+/// @param event Event to be counted.
+/// @param row_free Array of size event->rows that receives the free seats of each row, NULL to skip the rows.
+/// @return Number of free seats in the event.
+size_t count_free_seats(const struct Event* event, size_t* row_free);
+
+/// Allocates the record of a reservation's seats and the segment of the reverse index it goes in.
+/// @note Lock free, a segment allocated by two reservations at once is kept by the first one.
+/// @param event Event the reservation belongs to.
+/// @param reservation_id Id of the reservation.
+/// @param num_seats Number of seats of the reservation.
+/// @param indexes Array of seat indexes.
+/// @return Record to be published with index_reservation, NULL on failure.
+struct ReservationSeats* prepare_reservation(struct Event* event, unsigned int reservation_id, size_t num_seats,
+                                             const size_t* indexes);
+
+/// Publishes the seats of a reservation in the reverse index, where cancel finds them.
+/// @note Must be called once every seat holds the id. A reservation that is already indexed keeps its record.
+/// @param event Event the reservation belongs to.
+/// @param reservation_id Id of the reservation.
+/// @param seats Record returned by prepare_reservation, owned by the index from now on.
+void index_reservation(struct Event* event, unsigned int reservation_id, struct ReservationSeats* seats);
+
+/// Removes a reservation from the reverse index.
+/// @note Lock free, only one of several concurrent calls for the same id gets the record.
+/// @param event Event the reservation belongs to.
+/// @param reservation_id Id of the reservation.
+/// @return Record of the reservation's seats to be freed by the caller, NULL if it is not indexed.
+struct ReservationSeats* take_reservation(struct Event* event, unsigned int reservation_id);
+
+/// Allocates the tiles holding the given seats that were not written yet.
+/// @note Only takes the event's lock as a writer when a tile is missing.
+/// @param list Event list whose arena the tiles are carved from.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of seats.
+/// @param indexes Array of seat indexes.
+/// @return 0 if every seat can be written, 1 otherwise.
+int materialize_seats(struct EventList* list, struct Event* event, size_t num_seats, const size_t* indexes);
+
+/// Reads the reservation of a seat.
+/// @param event Event the seat belongs to.
+/// @param index Index of the seat.
+/// @return Reservation id of the seat, 0 if it is free.
+unsigned int read_seat(const struct Event* event, size_t index);
+
+/// Reads the reservations of the first seats of a tile.
+/// @note Every seat is read atomically, a reservation being written may show only some of its seats.
+/// @param event Event the tile belongs to.
+/// @param tile Index of the tile, the seats from tile * SEAT_TILE_SIZE on.
+/// @param num_seats Number of seats to read, at most SEAT_TILE_SIZE.
+/// @param seats Receives the reservation id of every seat, 0 if it is free. Left untouched when the tile is missing.
+/// @return 0 if the seats were read, 1 if the tile was never written and all its seats are free.
+int read_tile(const struct Event* event, size_t tile, size_t num_seats, unsigned int* seats);
+
+/// Writes the reservation of a seat.
+/// @note The seat must have been claimed by the caller and materialized.
+/// @param event Event the seat belongs to.
+/// @param index Index of the seat.
+/// @param reservation_id Reservation id to be stored.
+void write_seat(struct Event* event, size_t index, unsigned int reservation_id);
+
+/// Computes the memory an event currently holds.
+/// @param event Event to be measured.
+/// @return Number of bytes used by the event, its tile table, bitmap, row counters, allocated tiles, free-run index
+/// and reverse index with its reservation records.
+size_t event_memory(const struct Event* event);
+
 /// Appends a new node to the list.
 /// @param list Event list to be modified.
-/// @param data Event to be stored in the new node.
+/// @param data Event to be stored in the new node, created by create_event.
 /// @return 0 if the node was appended successfully, 1 otherwise.
 int append_to_list(struct EventList* list, struct Event* data);
 
@@ -48,6 +231,7 @@ int append_to_list(struct EventList* list, struct Event* data);
 void free_list(struct EventList* list);
 
 /// Retrieves an event in the list.
+/// @note Lock free, may run concurrently with append_to_list.
 /// @param list Event list to be searched
 /// @param event_id Event id.
 /// @return Pointer to the event if found, NULL otherwise.
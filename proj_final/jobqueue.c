@@ -0,0 +1,117 @@
+#include "jobqueue.h"
+
+#include <string.h>
+
+int init_job_queue(struct JobQueue* queue) {
+  queue->head = 0;
+  queue->count = 0;
+  queue->pending = 0;
+  queue->worker_waiting = 0;
+  queue->dispatcher_waiting = 0;
+
+  if (pthread_mutex_init(&queue->lock, NULL) != 0) return 1;
+
+  if (pthread_cond_init(&queue->not_empty, NULL) != 0) {
+    pthread_mutex_destroy(&queue->lock);
+    return 1;
+  }
+
+  if (pthread_cond_init(&queue->not_full, NULL) != 0) {
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+    return 1;
+  }
+  return 0;
+}
+
+void destroy_job_queue(struct JobQueue* queue) {
+  pthread_cond_destroy(&queue->not_full);
+  pthread_cond_destroy(&queue->not_empty);
+  pthread_mutex_destroy(&queue->lock);
+}
+
+struct Job* next_free_job(struct JobQueue* queue, int wait) {
+  struct Job* job = NULL;
+  pthread_mutex_lock(&queue->lock);
+  while (wait && queue->count + queue->pending == JOB_QUEUE_SIZE) {
+    queue->dispatcher_waiting = 1;
+    pthread_cond_wait(&queue->not_full, &queue->lock);
+    queue->dispatcher_waiting = 0;
+  }
+  if (queue->count + queue->pending < JOB_QUEUE_SIZE) {
+    job = &queue->jobs[(queue->head + queue->count + queue->pending) % JOB_QUEUE_SIZE];
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return job;
+}
+
+// hands the pending jobs over, the lock must be held
+static void publish_jobs(struct JobQueue* queue) {
+  queue->count += queue->pending;
+  queue->pending = 0;
+  if (queue->worker_waiting) pthread_cond_signal(&queue->not_empty);
+}
+
+void push_job(struct JobQueue* queue) {
+  pthread_mutex_lock(&queue->lock);
+  queue->pending++;
+  // a busy worker takes the jobs as they come, an idle one is only woken up for a whole batch
+  if (!queue->worker_waiting || queue->pending >= JOB_QUEUE_SIZE / 2) publish_jobs(queue);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+void flush_jobs(struct JobQueue* queue) {
+  pthread_mutex_lock(&queue->lock);
+  if (queue->pending > 0) publish_jobs(queue);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+struct Job* next_job(struct JobQueue* queue) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == 0) {
+    queue->worker_waiting = 1;
+    pthread_cond_wait(&queue->not_empty, &queue->lock);
+    queue->worker_waiting = 0;
+  }
+  struct Job* job = &queue->jobs[queue->head];
+  pthread_mutex_unlock(&queue->lock);
+  return job;
+}
+
+struct Job* peek_job(struct JobQueue* queue, size_t offset) {
+  struct Job* job = NULL;
+  pthread_mutex_lock(&queue->lock);
+  if (offset < queue->count) job = &queue->jobs[(queue->head + offset) % JOB_QUEUE_SIZE];
+  pthread_mutex_unlock(&queue->lock);
+  return job;
+}
+
+void pop_job(struct JobQueue* queue) {
+  pthread_mutex_lock(&queue->lock);
+  queue->head = (queue->head + 1) % JOB_QUEUE_SIZE;
+  queue->count--;
+  if (queue->dispatcher_waiting && queue->count + queue->pending <= JOB_QUEUE_SIZE / 2) {
+    pthread_cond_signal(&queue->not_full);
+  }
+  pthread_mutex_unlock(&queue->lock);
+}
+
+void copy_job(struct Job* job, enum Command command, size_t sequence, const struct Operands* operands) {
+  job->command = command;
+  job->sequence = sequence;
+
+  // the coordinate arrays are most of the operands, only the ones a RESERVE read are worth copying
+  struct Operands* copy = &job->operands;
+  copy->valid = operands->valid;
+  copy->event_id = operands->event_id;
+  copy->reservation_id = operands->reservation_id;
+  copy->num_rows = operands->num_rows;
+  copy->num_cols = operands->num_cols;
+  copy->num_coords = operands->num_coords;
+  copy->delay = operands->delay;
+  copy->thread_id = operands->thread_id;
+  if (command == CMD_RESERVE) {
+    memcpy(copy->xs, operands->xs, operands->num_coords * sizeof(size_t));
+    memcpy(copy->ys, operands->ys, operands->num_coords * sizeof(size_t));
+  }
+}
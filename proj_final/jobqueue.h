@@ -0,0 +1,79 @@
+#ifndef EMS_JOBQUEUE_H
+#define EMS_JOBQUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "constants.h"
+#include "parser.h"
+
+// A command parsed by the dispatcher, for a worker to execute
+struct Job {
+  enum Command command;
+  size_t sequence;  // Turn of the command in the .out file, only for commands that write to it
+  struct Operands operands;
+};
+
+// Bounded queue of the jobs of one worker. Only the dispatcher adds jobs and only the worker removes them, so each
+// side fills or executes its slot in place, outside the lock
+struct JobQueue {
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;  // Signaled when a job is added
+  pthread_cond_t not_full;   // Signaled when a job is removed
+  size_t head;               // Slot of the oldest job
+  size_t count;              // Number of jobs handed to the worker and not yet removed
+  size_t pending;            // Number of jobs written after them, not yet handed to the worker
+  int worker_waiting;        // Whether the worker waits for not_empty
+  int dispatcher_waiting;    // Whether the dispatcher waits for not_full
+  struct Job jobs[JOB_QUEUE_SIZE];
+};
+
+/// Initializes an empty queue.
+/// @param queue Queue to be initialized.
+/// @return 0 if the queue was initialized successfully, 1 otherwise.
+int init_job_queue(struct JobQueue* queue);
+
+/// Destroys a queue.
+/// @param queue Queue to be destroyed.
+void destroy_job_queue(struct JobQueue* queue);
+
+/// Gets the slot the next job is to be written to.
+/// @param queue Queue to add to.
+/// @param wait Whether to wait while the queue is full.
+/// @return The slot, only handed to the worker by push_job. NULL if the queue is full and wait is not set.
+struct Job* next_free_job(struct JobQueue* queue, int wait);
+
+/// Adds the job written to the slot given by next_free_job.
+/// @note Jobs are handed to an idle worker in batches of half the queue, so the worker is not woken up for each one.
+/// @param queue Queue to add to.
+void push_job(struct JobQueue* queue);
+
+/// Hands every job added so far to the worker, waking it up if it is idle.
+/// @param queue Queue to flush.
+void flush_jobs(struct JobQueue* queue);
+
+/// Gets the oldest job, waiting while the queue is empty.
+/// @param queue Queue to take from.
+/// @return The job, kept in its slot until pop_job.
+struct Job* next_job(struct JobQueue* queue);
+
+/// Gets a job handed to the worker behind older ones it has not removed yet, without waiting.
+/// @note Lets the worker start on a job while the ones in front of it still hold their slots.
+/// @param queue Queue to take from.
+/// @param offset Number of older jobs in front of it.
+/// @return The job, kept in its slot until pop_job. NULL if the worker was not handed that many jobs yet.
+struct Job* peek_job(struct JobQueue* queue, size_t offset);
+
+/// Frees the slot of the job given by next_job.
+/// @note A dispatcher waiting for a full queue is only woken up once half of it is free.
+/// @param queue Queue to take from.
+void pop_job(struct JobQueue* queue);
+
+/// Copies a job, along with only the coordinates it uses.
+/// @param job Slot to copy to.
+/// @param command Command of the job.
+/// @param sequence Turn of the command in the .out file.
+/// @param operands Arguments of the command.
+void copy_job(struct Job* job, enum Command command, size_t sequence, const struct Operands* operands);
+
+#endif  // EMS_JOBQUEUE_H
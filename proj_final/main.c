@@ -9,6 +9,7 @@
 #include<sys/wait.h>
 #include <pthread.h>
   
+#include "bytecode.h"
 #include "constants.h"
 #include "operations.h"
 #include "parser.h"
@@ -26,9 +27,24 @@ int main(int argc, char *argv[]) {
 
   struct dirent *entry; // pointer for the entry of a directory 
 
+  // -m maps every .jobs file and scans it in place instead of reading it into a buffer. It applies whenever a file is
+  // parsed, which is when it is compiled: a fresh compiled file is decoded without parsing the text at all
+  int map_input = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "m")) != -1) {
+    if (opt != 'm') {
+      write_to_file("Usage: ems [-m] <jobs_dir> <max_proc> <max_threads> [delay_ms]\n",STDERR_FILENO);
+      exit(EXIT_FAILURE);
+    }
+    map_input = 1;
+  }
+
+  // the positional arguments are looked at as if no option was given
+  argc -= optind - 1;
+  argv += optind - 1;
   
-  
-  if(argc != 4){
+  // the state access delay is optional
+  if(argc != 4 && argc != 5){
     write_to_file("Wrong number of arguments\n",STDERR_FILENO);
     exit(EXIT_FAILURE);
   }
@@ -96,6 +112,11 @@ int main(int argc, char *argv[]) {
           exit(1);
         }
 
+        if(max_thread <= 0){
+          printf("Invalid max number of threads\n");
+          exit(1);
+        }
+
         // if the number of parallel processes reaches max it waits until one of the existing processes exits to create another    
         if(n_proc == max_proc){
             
@@ -123,8 +144,6 @@ int main(int argc, char *argv[]) {
 
           // child process code
           if(cur_pid == 0){
-            // array that will contain the id of each thread 
-           struct Thread* t_id[max_thread];      
             ems_init(delay);
             
 
@@ -148,8 +167,15 @@ int main(int argc, char *argv[]) {
             char outputFilePath[MAX_PATH_SIZE];
             snprintf(outputFilePath, MAX_PATH_SIZE, "%s/%s.out", argv[1], fileName); 
             
+            char programFilePath[MAX_PATH_SIZE];
+            snprintf(programFilePath, MAX_PATH_SIZE, "%s/%s" PROGRAM_EXTENSION, argv[1], fileName);
+
+            // the .jobs file is compiled once, through the mapping under -m, and kept next to it, so later runs only
+            // decode it. Without a program the text is parsed as before
+            struct Program* program = load_program(inputFilePath, programFilePath, map_input);
+
             // opens the file and erases its content if it already exists, creates a new one if it doesn't
-            fd_output = open(outputFilePath,O_WRONLY | O_CREAT | O_TRUNC);  
+            fd_output = open(outputFilePath,O_WRONLY | O_CREAT | O_TRUNC, 0666);  
             
             if(fd_output < 0){
                 write_to_file("Error opening output file \n",STDERR_FILENO);
@@ -157,72 +183,89 @@ int main(int argc, char *argv[]) {
             }
             
 
-            
+            // the input is read by this process once, whatever the number of threads
+            int fd_input = -1;
+            struct Reader* input = NULL;
 
-            for(int i = 0; i < max_thread; i++){
+            if(program == NULL){
 
-             int fd_input = open(inputFilePath, O_RDONLY); // Opens the file to read only mode
+              fd_input = open(inputFilePath, O_RDONLY); // Opens the file to read only mode
 
               if(fd_input < 0){
                 
                 write_to_file("Error opening inputfile\n",STDERR_FILENO);
                 exit(EXIT_FAILURE);
               }
-              pthread_t id;
+
+              // a file that can not be mapped is read into a buffer as usual
+              if(map_input){
+                input = create_mapped_reader(fd_input);
+              }
+              if(input == NULL){
+                input = create_reader(fd_input);
+              }
+
+              if(input == NULL){
+                write_to_file("Error allocating memory for input buffer\n",STDERR_FILENO);
+                exit(EXIT_FAILURE);
+              }
+            }
+
+
+            // the output of the commands is written in their order, whichever thread executes them
+            struct Sequencer sequencer;
+            if(init_sequencer(&sequencer,fd_output) != 0){
+              exit(EXIT_FAILURE);
+            }
+
+            // the threads and this one, which hands them the commands, cross every BARRIER together
+            pthread_barrier_t barrier;
+            if(pthread_barrier_init(&barrier,NULL,(unsigned int)max_thread + 1) != 0){
+              exit(EXIT_FAILURE);
+            }
+
+            // array that will contain the id of each thread 
+            struct Thread* t_id[max_thread];      
+
+            for(int i = 0; i < max_thread; i++){
+
               struct Thread* thread_inf = malloc(sizeof(struct Thread));
-              thread_inf ->fd_output = fd_output;
-              thread_inf -> fd_input = fd_input;
+
+              if(thread_inf == NULL || init_job_queue(&thread_inf->jobs) != 0){
+                write_to_file("Error allocating memory for thread\n",STDERR_FILENO);
+                exit(EXIT_FAILURE);
+              }
+              thread_inf->sequencer = &sequencer;
               thread_inf->thread_index = i;
-              thread_inf->max_threads = max_thread;
-              thread_inf -> lines_read = 0;
+              thread_inf->barrier = &barrier;
             
-              if(pthread_create(&id,NULL,compute_file,thread_inf)){
+              if(pthread_create(&thread_inf->id,NULL,compute_file,thread_inf)){
                 exit(EXIT_FAILURE);
               }
-              thread_inf -> id = id;
               t_id[i] = thread_inf;
                 
             }
             
-            
-            int n_barrier = 0;
-          
-            // checks if the threads reached barrier (exit status 1)
+
+            // every command is parsed once, here, and executed by the thread it belongs to
+            dispatch_file(input, program, t_id, max_thread, &barrier);
+
             for(int i = 0; i < max_thread; i++){
               if(pthread_join(t_id[i]->id,NULL) != 0){
                 exit(EXIT_FAILURE);
               }
-              if(t_id[i]->state == 1){
-                n_barrier++;
-              }
-            }
-            
-
-            // if all of them reach barrier creates new threads to process the remaining lines in the input file
-            if(n_barrier > 0){
-              
-              for(int i = 0; i < max_thread; i++){
-
-                  pthread_t id;
-                  struct Thread* args = malloc(sizeof(struct Thread));
-                  args ->fd_output = fd_output;
-                  args -> fd_input = t_id[i]->fd_input;
-                  args->thread_index = i;
-                  args->max_threads = max_thread;
-                  args -> lines_read = 0;
-                  
-                  free(t_id[i]);
-                
-                  if(pthread_create(&id,NULL,compute_file,args)){
-                    exit(EXIT_FAILURE);
-                  }
-                  args -> id = id;
-                  // adds the new threads to the array of current threads
-                  t_id[i] = args;
-              }
+              destroy_job_queue(&t_id[i]->jobs);
+              free(t_id[i]);
             }
+            pthread_barrier_destroy(&barrier);
+            destroy_sequencer(&sequencer);
 
 
+            if(input != NULL){
+              free_reader(input);
+              close(fd_input);
+            }
+            free_program(program);
             ems_terminate();
             close(fd_output);
             // terminates the process
@@ -1,9 +1,11 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <fcntl.h>
 
 
@@ -14,8 +16,18 @@
 
 static struct EventList* event_list = NULL;
 static unsigned int state_access_delay_ms = 0;
+
+static _Thread_local int access_completed = 0;  // set while a command whose lookup was waited for is executed
+
+// lookups of the commands a worker issued and has not executed yet, oldest first. Each command waits in its job slot
+// until its lookup completes, and only then reads or changes the state
+struct AccessQueue {
+  struct timespec ready[JOB_QUEUE_SIZE];  // when the lookup completes
+  int lookup[JOB_QUEUE_SIZE];             // whether the command looks an event up at all
+  size_t head;
+  size_t count;
+};
 pthread_rwlock_t global_lock;
-int wait_id = -1;
 
 
 
@@ -35,27 +47,94 @@ static struct timespec delay_to_timespec(unsigned int delay_ms) {
   return (struct timespec){delay_ms / 1000, (delay_ms % 1000) * 1000000};
 }
 
+/// Pays for an access to the state.
+/// @note Waits to simulate a real system accessing a costly memory resource.
+static void access_state(void) {
+  struct timespec delay = delay_to_timespec(state_access_delay_ms);
+  nanosleep(&delay, NULL);  // Should not be removed
+}
+
+/// Issues the lookup of a command ahead of executing it, so the worker issues the next ones meanwhile.
+/// @note Nothing is read from the state here, only the time the lookup completes at is computed.
+/// @param queue Queue of the calling worker, holding fewer than JOB_QUEUE_SIZE commands.
+/// @param command Command to be issued.
+static void issue_access(struct AccessQueue* queue, enum Command command) {
+  size_t slot = (queue->head + queue->count) % JOB_QUEUE_SIZE;
+  queue->count++;
+
+  // only the commands that look an event up access the state before they run
+  queue->lookup[slot] = command == CMD_CREATE || command == CMD_RESERVE || command == CMD_RESERVE_BEST ||
+                        command == CMD_CANCEL || command == CMD_SHOW || command == CMD_MEMORY ||
+                        command == CMD_AVAILABLE;
+  if (!queue->lookup[slot]) return;
+
+  struct timespec* ready = &queue->ready[slot];
+  clock_gettime(CLOCK_MONOTONIC, ready);
+  ready->tv_sec += (time_t)(state_access_delay_ms / 1000);
+  ready->tv_nsec += (long)(state_access_delay_ms % 1000) * 1000000;
+  if (ready->tv_nsec >= 1000000000) {
+    ready->tv_sec++;
+    ready->tv_nsec -= 1000000000;
+  }
+}
+
+/// Waits until the lookup of the oldest command in the queue completes and removes it.
+/// @param queue Queue of the calling worker, not empty.
+/// @return 1 if the command looked an event up, 0 if it accesses no state before it runs.
+static int complete_access(struct AccessQueue* queue) {
+  int lookup = queue->lookup[queue->head];
+  if (lookup) {
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &queue->ready[queue->head], NULL) == EINTR) {
+    }
+  }
+  queue->head = (queue->head + 1) % JOB_QUEUE_SIZE;
+  queue->count--;
+  return lookup;
+}
+
 /// Gets the event with the given ID from the state.
-/// @note Will wait to simulate a real system accessing a costly memory resource.
+/// @note Will wait to simulate a real system accessing a costly memory resource, unless the worker already waited
+/// for the lookup while issuing the next commands.
 /// @param event_id The ID of the event to get.
 /// @return Pointer to the event if found, NULL otherwise.
 static struct Event* get_event_with_delay(unsigned int event_id) {
-  struct timespec delay = delay_to_timespec(state_access_delay_ms);
-  nanosleep(&delay, NULL);  // Should not be removed
+  if (access_completed) {
+    access_completed = 0;
+  } else {
+    access_state();
+  }
 
   return get_event(event_list, event_id);
 }
 
-/// Gets the seat with the given index from the state.
-/// @note Will wait to simulate a real system accessing a costly memory resource.
-/// @param event Event to get the seat from.
-/// @param index Index of the seat to get.
-/// @return Pointer to the seat.
-static unsigned int* get_seat_with_delay(struct Event* event, size_t index) {
-  struct timespec delay = delay_to_timespec(state_access_delay_ms);
-  nanosleep(&delay, NULL);  // Should not be removed
+/// Gets the first seats of a tile from the state.
+/// @note Will wait to simulate a real system accessing a costly memory resource, once for the tile. A tile that was
+/// never written is known to hold only free seats without being read, so it costs nothing.
+/// @param event Event to get the seats from.
+/// @param tile Index of the tile.
+/// @param num_seats Number of seats to get.
+/// @param seats Receives the reservation id of every seat, 0 if it is free.
+/// @return 0 if the seats were read, 1 if every seat of the tile is free and seats was left untouched.
+static int get_tile_with_delay(struct Event* event, size_t tile, size_t num_seats, unsigned int* seats) {
+  if (read_tile(event, tile, num_seats, seats) != 0) return 1;
+
+  access_state();
+  return 0;
+}
 
-  return &event->data[index];
+/// Sets the seats with the given indexes in the state.
+/// @note Will wait to simulate a real system accessing a costly memory resource, once for the whole vector.
+/// @param event Event to set the seats in.
+/// @param num_seats Number of seats to set.
+/// @param indexes Indexes of the seats to set, their tiles must already be materialized.
+/// @param reservation_id Reservation id to be stored in every seat.
+static void set_seats_with_delay(struct Event* event, size_t num_seats, const size_t* indexes,
+                                 unsigned int reservation_id) {
+  access_state();
+
+  for (size_t i = 0; i < num_seats; i++) {
+    write_seat(event, indexes[i], reservation_id);
+  }
 }
 
 /// Gets the index of a seat.
@@ -106,7 +185,7 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
     
   }
 
-  struct Event* event = malloc(sizeof(struct Event));
+  struct Event* event = create_event(event_list, event_id, num_rows, num_cols);
   if (event == NULL) {
     write_to_file("Error allocating memory for event\n",STDERR_FILENO);
     return 1;
@@ -114,31 +193,10 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   }
 
   pthread_rwlock_init(&event->event_lock_rw,NULL);
-  pthread_rwlock_wrlock(&event -> event_lock_rw);
-
-  event->id =  event_id;
-  event->rows = num_rows;
-  event->cols = num_cols;
-  event->reservations = 0;
-  event->data = malloc(num_rows * num_cols * sizeof(unsigned int));
- 
-  if (event->data == NULL) {
-    write_to_file("Error allocating memory for event data\n",STDERR_FILENO);
-    free(event);
-    return 1;
-
-  }
-
-  for (size_t i = 0; i < num_rows * num_cols; i++) {
-    event->data[i] = 0;
-  }
-  
-  pthread_rwlock_unlock(&event -> event_lock_rw);
 
+  // the event's memory belongs to the list's arena and is only released by ems_terminate
   if (append_to_list(event_list, event)) {
     write_to_file("Error appending event to list\n",STDERR_FILENO);
-    free(event->data);
-    free(event);
     return 1;
   }
  
@@ -166,60 +224,135 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
   }
 
 
-  pthread_rwlock_wrlock(&event -> event_lock_rw);
-  unsigned int reservation_id = ++event->reservations;
-  pthread_rwlock_unlock(&event -> event_lock_rw);
+  size_t indexes[MAX_RESERVATION_SIZE];
+  if (num_seats > MAX_RESERVATION_SIZE) {
+    write_to_file("Invalid seat\n",STDERR_FILENO);
+    return 1;
+  }
 
-  size_t i = 0;
-  for (; i < num_seats; i++) {
+  for (size_t i = 0; i < num_seats; i++) {
     size_t row = xs[i];
     size_t col = ys[i];
 
     if (row <= 0 || row > event->rows || col <= 0 || col > event->cols) {
       write_to_file("Invalid seat\n",STDERR_FILENO);
-      
-      break;
+      return 1;
     }
 
-    if (*get_seat_with_delay(event, seat_index(event, row, col)) != 0) {
+    indexes[i] = seat_index(event, row, col);
+  }
 
-      write_to_file("Seat already reserved\n",STDERR_FILENO);
-          
-      break;
-    }
+  // the seats are claimed without locks, a reservation that finds one taken gives back the ones it claimed
+  if (claim_seats(event, num_seats, indexes)) {
+    write_to_file("Seat already reserved\n",STDERR_FILENO);
+    return 1;
+  }
+  if (materialize_seats(event_list, event, num_seats, indexes)) {
+    release_seats(event, num_seats, indexes);
+    update_free_runs(event, num_seats, indexes);
+    write_to_file("Error allocating memory for seats\n",STDERR_FILENO);
+    return 1;
+  }
+  update_free_runs(event, num_seats, indexes);
+  unsigned int reservation_id = atomic_fetch_add(&event->reservations, 1) + 1;
+
+  struct ReservationSeats* seats = prepare_reservation(event, reservation_id, num_seats, indexes);
+  if (seats == NULL) {
+    release_seats(event, num_seats, indexes);
+    update_free_runs(event, num_seats, indexes);
+    write_to_file("Error allocating memory for seats\n",STDERR_FILENO);
+    return 1;
+  }
 
+  // the claimed seats belong to this reservation, no other reserve can write to them
+  set_seats_with_delay(event, num_seats, indexes, reservation_id);
 
-    pthread_rwlock_wrlock(&event -> event_lock_rw);
+  // only indexed once written, so a cancel never finds seats still being written
+  index_reservation(event, reservation_id, seats);
+  return 0; 
 
-    *get_seat_with_delay(event, seat_index(event, row, col)) = reservation_id;
+}
 
-    pthread_rwlock_unlock(&event -> event_lock_rw);
+int ems_reserve_best(unsigned int event_id, size_t num_seats) {
 
+  if (event_list == NULL) {
+    write_to_file("EMS state must be initialized\n",STDERR_FILENO);
+    return 1;
   }
 
-  // If the reservation was not successful, free the seats that were reserved.
-  if (i < num_seats) {
-    pthread_rwlock_wrlock(&event -> event_lock_rw);
-    event->reservations--;
-    pthread_rwlock_unlock(&event -> event_lock_rw);
+  struct Event* event = get_event_with_delay(event_id);
 
-    for (size_t j = 0; j < i; j++) {
+  if (event == NULL) {
+    write_to_file("Event not found\n",STDERR_FILENO);
+    return 1;
+  }
 
-      pthread_rwlock_wrlock(&event -> event_lock_rw);
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE) {
+    write_to_file("Invalid number of seats\n",STDERR_FILENO);
+    return 1;
+  }
 
-      *get_seat_with_delay(event, seat_index(event, xs[j], ys[j])) = 0;
+  // the free-run index finds the seats, so nothing is scanned and no taken seat is ever tried
+  size_t indexes[MAX_RESERVATION_SIZE];
+  if (claim_free_run(event_list, event, num_seats, indexes)) {
+    write_to_file("No adjacent free seats\n",STDERR_FILENO);
+    return 1;
+  }
+  if (materialize_seats(event_list, event, num_seats, indexes)) {
+    release_seats(event, num_seats, indexes);
+    update_free_runs(event, num_seats, indexes);
+    write_to_file("Error allocating memory for seats\n",STDERR_FILENO);
+    return 1;
+  }
+  unsigned int reservation_id = atomic_fetch_add(&event->reservations, 1) + 1;
 
-      pthread_rwlock_unlock(&event -> event_lock_rw);
+  struct ReservationSeats* seats = prepare_reservation(event, reservation_id, num_seats, indexes);
+  if (seats == NULL) {
+    release_seats(event, num_seats, indexes);
+    update_free_runs(event, num_seats, indexes);
+    write_to_file("Error allocating memory for seats\n",STDERR_FILENO);
+    return 1;
+  }
 
-    }
+  set_seats_with_delay(event, num_seats, indexes, reservation_id);
+
+  index_reservation(event, reservation_id, seats);
+  return 0;
+
+}
+
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+
+  if (event_list == NULL) {
+    write_to_file("EMS state must be initialized\n",STDERR_FILENO);
     return 1;
   }
 
-  return 0; 
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    write_to_file("Event not found\n",STDERR_FILENO);
+    return 1;
+  }
+
+  // taking the seats out of the index makes this the only cancel of the reservation
+  struct ReservationSeats* seats = take_reservation(event, reservation_id);
+  if (seats == NULL) {
+    write_to_file("Reservation not found\n",STDERR_FILENO);
+    return 1;
+  }
+
+  // the seats are cleared before they are released, so a reserve claiming them again is never overwritten
+  set_seats_with_delay(event, seats->num_seats, seats->seats, 0);
+  release_seats(event, seats->num_seats, seats->seats);
+  update_free_runs(event, seats->num_seats, seats->seats);
+
+  free(seats);
+  return 0;
 
 }
 
-int ems_show(unsigned int event_id, const int output_fd) {
+int ems_show(unsigned int event_id, struct Output* output) {
   
   if (event_list == NULL) {
     write_to_file("EMS state must be initialized\n",STDERR_FILENO);
@@ -238,38 +371,46 @@ int ems_show(unsigned int event_id, const int output_fd) {
   }
 
 
-  pthread_rwlock_wrlock(&global_lock);
-  for (size_t i = 1; i <= event->rows; i++) {
-    for (size_t j = 1; j <= event->cols; j++) {
-
-      
-      pthread_rwlock_rdlock(&event -> event_lock_rw);
-      unsigned int* seat = get_seat_with_delay(event, seat_index(event, i, j));
-      pthread_rwlock_unlock(&event -> event_lock_rw);
-    
-
-      char seat_str[16];  
+  // the seats are fetched a tile at a time into a fixed buffer, so a SHOW never copies the whole event, and tiles
+  // that were never written are rendered as free seats without being read
+  unsigned int seats[SEAT_TILE_SIZE];
+  size_t n_seats = event->rows * event->cols;
 
-      sprintf(seat_str, "%u", *seat);
-      write_to_file(seat_str,output_fd);
+  pthread_rwlock_wrlock(&global_lock);
 
-      if (j < event->cols) {
-        write_to_file(" ", output_fd);
-  
+  for (size_t first = 0; first < n_seats; first += SEAT_TILE_SIZE) {
+    size_t num_seats = n_seats - first < SEAT_TILE_SIZE ? n_seats - first : SEAT_TILE_SIZE;
+    int untouched = get_tile_with_delay(event, first / SEAT_TILE_SIZE, num_seats, seats);
+
+    // a tile may hold the end of a row, whole rows and the start of another
+    for (size_t done = 0; done < num_seats;) {
+      size_t col = (first + done) % event->cols;
+      size_t n = num_seats - done < event->cols - col ? num_seats - done : event->cols - col;
+      if (untouched) {
+        output_free_seats(output, n);
+      } else {
+        output_seats(output, &seats[done], n);
       }
+      done += n;
+
+      if (col + n == event->cols) output_end_row(output, event->cols);
     }
-    write_to_file("\n",output_fd);
+  }
 
+  // rows without seats are only their newline
+  for (size_t i = 0; event->cols == 0 && i < event->rows; i++) {
+    output_end_row(output, 0);
   }
+
   pthread_rwlock_unlock(&global_lock);
   return 0; 
 
 }
 
-int ems_list_events(const int output_fd) {
+int ems_list_events(struct Output* output) {
 
   if (event_list == NULL) {
-    write_to_file("EMS state must be initialized\n",output_fd);
+    output_print(output, "EMS state must be initialized\n");
     return 1;
      
   }
@@ -278,8 +419,9 @@ int ems_list_events(const int output_fd) {
 
   pthread_rwlock_rdlock(&event_list -> list_lock_rw);
   if (event_list->head == NULL) {
-    write_to_file("No events\n",output_fd);
+    output_print(output, "No events\n");
     pthread_rwlock_unlock(&event_list -> list_lock_rw);
+    pthread_rwlock_unlock(&global_lock);
     return 1;
    
   }
@@ -287,171 +429,188 @@ int ems_list_events(const int output_fd) {
   struct ListNode* current = event_list->head;
 
   while (current != NULL) {
-    write_to_file("Event: ",output_fd);
+    output_print(output, "Event: ");
     char id[16];  
 
     
 
     sprintf(id,"%u\n",(current->event)->id);
   
-    write_to_file(id,output_fd);
+    output_print(output, id);
 
 
     current = current->next;
     
   }
+  pthread_rwlock_unlock(&event_list -> list_lock_rw);
   pthread_rwlock_unlock(&global_lock);
   return 0; 
 
 }
 
-void ems_wait(unsigned int thread_id) {
-  pthread_rwlock_wrlock(&global_lock);
-  wait_id = (int)thread_id;
-  pthread_rwlock_unlock(&global_lock);
+int ems_memory(unsigned int event_id, struct Output* output) {
+
+  if (event_list == NULL) {
+    write_to_file("EMS state must be initialized\n",STDERR_FILENO);
+    return 1;
+  }
+
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    write_to_file("Event not found\n",STDERR_FILENO);
+    return 1;
+  }
+
+  pthread_rwlock_rdlock(&event -> event_lock_rw);
+  size_t used_tiles = event->used_tiles;
+  size_t bytes = event_memory(event);
+  pthread_rwlock_unlock(&event -> event_lock_rw);
+
+  char line[128];
+  sprintf(line, "Event: %u\nTiles: %zu/%zu\nBytes: %zu\n", event->id, used_tiles, event->n_tiles, bytes);
+  output_print(output, line);
+  return 0;
 
 }
 
+int ems_available(unsigned int event_id, struct Output* output) {
 
-// checks if the current thread sould execute the command 
-int should_execute(int lines_read, int max_thread, int thread_index){
-  if(lines_read % max_thread != thread_index){
-    return 0;
+  if (event_list == NULL) {
+    write_to_file("EMS state must be initialized\n",STDERR_FILENO);
+    return 1;
+  }
+
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    write_to_file("Event not found\n",STDERR_FILENO);
+    return 1;
   }
-  return 1;
+
+  // an event without rows has no counters to read
+  size_t* row_free = NULL;
+  if (event->rows > 0 && (row_free = malloc(event->rows * sizeof(size_t))) == NULL) {
+    write_to_file("Error allocating memory for rows\n",STDERR_FILENO);
+    return 1;
+  }
+
+  // read from the counters the reservations keep, no seat is touched
+  size_t free_seats = count_free_seats(event, row_free);
+
+  char line[128];
+  sprintf(line, "Event: %u\nFree: %zu/%zu\nRows:", event->id, free_seats, event->rows * event->cols);
+  output_print(output, line);
+  for (size_t i = 0; i < event->rows; i++) {
+    sprintf(line, " %zu", row_free[i]);
+    output_print(output, line);
+  }
+  output_write(output, "\n", 1);
+
+  free(row_free);
+  return 0;
+
 }
 
+void ems_wait(unsigned int delay_ms) {
+  struct timespec delay = delay_to_timespec(delay_ms);
+  nanosleep(&delay, NULL);
+}
 
-void* compute_file(void* thread_inf){
 
-    struct Thread* args = (struct Thread*)thread_inf;
-    int eoc = 0;
-    unsigned int delay_ms;
-    unsigned int thread_id;
-    int thread_index = args->thread_index;
-    int fd_output = args->fd_output;
-    int max_thread = args->max_threads;
-    int fd_input = args->fd_input;
+// hands every job added so far to the workers
+static void flush_workers(struct Thread** workers, int max_threads){
+  for (int i = 0; i < max_threads; i++) {
+    flush_jobs(&workers[i]->jobs);
+  }
+}
 
-    
-    while (1){
-      
-      // all threads wait
-      if(wait_id == 0){
+// adds a command to the queue of a worker, waiting while the worker has too many left to execute. The other workers
+// are handed their jobs before that, so none of them idles with jobs it was not handed yet
+static void hand_job(struct Thread** workers, int max_threads, int worker, enum Command command, size_t sequence,
+                     const struct Operands* operands){
+  struct Job* job = next_free_job(&workers[worker]->jobs, 0);
+  if (job == NULL) {
+    flush_workers(workers, max_threads);
+    job = next_free_job(&workers[worker]->jobs, 1);
+  }
+  copy_job(job, command, sequence, operands);
+  push_job(&workers[worker]->jobs);
+}
 
-        struct timespec delay = delay_to_timespec(delay_ms);
-        nanosleep(&delay, NULL);
-      }
+// adds a command to the queue of every worker and hands them all their jobs
+static void hand_all(struct Thread** workers, int max_threads, enum Command command, const struct Operands* operands){
+  for (int i = 0; i < max_threads; i++) {
+    hand_job(workers, max_threads, i, command, 0, operands);
+  }
+  flush_workers(workers, max_threads);
+}
 
-      // only a specific thread waits
-      if(wait_id == thread_index){
+void dispatch_file(struct Reader* input, const struct Program* program, struct Thread** workers, int max_threads,
+                   pthread_barrier_t* barrier){
 
-        struct timespec delay = delay_to_timespec(delay_ms);
-        nanosleep(&delay, NULL);
-        wait_id = -1;
-      }
-     
- 
-      unsigned int event_id;
-      size_t num_rows, num_columns, num_coords;
-      size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    struct Operands operands = {0};
+    size_t pc = 0;
+    int lines_read = 0;
+    size_t outputs = 0;  // commands handed out so far that write to the .out file
 
-      switch (get_next(fd_input)) {
-        
-        
-        case CMD_CREATE:
-          
-          if (parse_create(fd_input, &event_id, &num_rows, &num_columns)) {
-          
-            write_to_file("Invalid command. See HELP for usage\n",STDERR_FILENO);
-            break;
+    while (1){
 
-          }
-          if(should_execute(args -> lines_read,max_thread,thread_index)){
+      // a compiled file is only decoded, the .jobs file is parsed otherwise
+      enum Command command =
+          program != NULL ? next_instruction(program, &pc, &operands) : parse_command(input, &operands);
 
+      // each line is still executed by the thread whose index it has, counting from the last barrier
+      int owner = lines_read % max_threads;
 
-            if (ems_create(event_id, num_rows, num_columns)) {
-              write_to_file("Failed to create event\n",STDERR_FILENO);
-              break;
-        
-            } 
-           
-            break;
-          }
-          break;
+      switch (command) {
 
+        case CMD_CREATE:
         case CMD_RESERVE:
-          num_coords = parse_reserve(fd_input, MAX_RESERVATION_SIZE, &event_id, xs, ys);
-
-          if (num_coords == 0) {
+        case CMD_RESERVE_BEST:
+        case CMD_CANCEL:
+          if (!operands.valid) {
             write_to_file("Invalid command. See HELP for usage\n",STDERR_FILENO);
             break;
 
           }
-          if(should_execute(args -> lines_read,max_thread,thread_index)){
-        
-            if (ems_reserve(event_id, num_coords, xs, ys)) {
-         
-              write_to_file("Failed to reserve seats\n",STDERR_FILENO);
-              break;
-            
-            }
-
-            break;
-          
-          }
+          hand_job(workers, max_threads, owner, command, 0, &operands);
           break;
 
+        // commands that write to the .out file take the next turn in it
         case CMD_SHOW:
-          if (parse_show(fd_input, &event_id) != 0) {
+        case CMD_MEMORY:
+        case CMD_AVAILABLE:
+          if (!operands.valid) {
             write_to_file("Invalid command. See HELP for usage\n",STDERR_FILENO);
             break;
 
           }
-
-          if(should_execute(args -> lines_read,max_thread,thread_index)){
-          
-     
-            if (ems_show(event_id,fd_output)) {
-
-              write_to_file("Failed to show event\n",STDERR_FILENO);
-              break;
-            }
-            
-            break;
-          }
+          hand_job(workers, max_threads, owner, command, outputs++, &operands);
           break;
 
         case CMD_LIST_EVENTS:
-          if(should_execute(args -> lines_read,max_thread,thread_index)){
-     
-      
-            if (ems_list_events(fd_output)) {
-              write_to_file("Failed to list events\n",STDERR_FILENO);
-              break;
-            
-            }
-            
-            break;
-          }
+          hand_job(workers, max_threads, owner, command, outputs++, &operands);
           break;
 
         case CMD_WAIT:
-          if (parse_wait(fd_input, &delay_ms, &thread_id) == -1) { 
+          // an invalid WAIT does not count as a line
+          if (!operands.valid) { 
             write_to_file("Invalid command. See HELP for usage\n",STDERR_FILENO);
             continue;
           
           }
-          if(should_execute(args -> lines_read,max_thread,thread_index)){
 
-            if (delay_ms > 0) {
-              printf("Waiting...\n");
-              ems_wait(thread_id);
-              
-              break;
-            }
+          if (operands.delay > 0) {
+            printf("Waiting...\n");
 
-            break;
+            // threads are numbered from 1, without a thread every one of them waits
+            if (operands.thread_id == 0) {
+              hand_all(workers, max_threads, command, &operands);
+            } else if (operands.thread_id <= (unsigned int)max_threads) {
+              hand_job(workers, max_threads, (int)operands.thread_id - 1, command, 0, &operands);
+              flush_workers(workers, max_threads);
+            }
           }
           break;
 
@@ -465,41 +624,157 @@ void* compute_file(void* thread_inf){
               "Available commands:\n"
               "  CREATE <event_id> <num_rows> <num_columns>\n"
               "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+              "  RESERVE_BEST <event_id> <num_seats>\n"
+              "  CANCEL <event_id> <reservation_id>\n"
               "  SHOW <event_id>\n"
+              "  MEMORY <event_id>\n"
+              "  AVAILABLE <event_id>\n"
               "  LIST\n"
-              "  WAIT <delay_ms> [thread_id]\n"  // thread_id is not implemented
-              "  BARRIER\n"                      // Not implemented
+              "  WAIT <delay_ms> [thread_id]\n"
+              "  BARRIER\n"
               "  HELP\n");
 
           break;
 
         case CMD_BARRIER: 
-   
-          args->state = 1;
-      
-          pthread_exit(&args->state);
-          break;
+          // every worker finishes the commands before the barrier before any command after it is handed out
+          hand_all(workers, max_threads, command, &operands);
+          pthread_barrier_wait(barrier);
+
+          lines_read = 0;
+          continue;
 
 
         case CMD_EMPTY:
           break;
 
         case EOC: 
-          eoc = 1;
-          close(fd_input);
-          break;
+          hand_all(workers, max_threads, command, &operands);
+          return;
 
-          
       }
-      if(eoc){
-        args->state = 0;
-        pthread_exit(&args->state);
 
+      lines_read++;
+    }
+}
+
+
+// hands what a command rendered to the sequencer, nothing at all if it did not fit in memory. Even a command that
+// failed takes its turn, so the ones after it are not kept waiting
+static void finish_output(struct Sequencer* sequencer, size_t sequence, struct Output* output){
+  if (output->failed) {
+    write_to_file("Error allocating memory for output\n",STDERR_FILENO);
+    reset_output(output);
+  }
+  commit_output(sequencer, sequence, output);
+}
+
+
+void* compute_file(void* thread_inf){
+
+    struct Thread* args = (struct Thread*)thread_inf;
+
+    // what a command writes to the .out file is rendered here and written in its turn
+    struct Output output;
+    init_output(&output);
+
+    // the lookups of the commands handed to the worker are issued as soon as it sees them, and each command waits in
+    // its slot until its own lookup completes. Commands still run one at a time and in order, so none of them reads or
+    // changes the state, or writes output, before its lookup completes
+    struct AccessQueue queue = {.head = 0, .count = 0};
+
+    while (1){
+
+      // an idle worker waits for a command, a busy one only issues the ones it was already handed
+      if (queue.count == 0) issue_access(&queue, next_job(&args->jobs)->command);
+      for (struct Job* issued; (issued = peek_job(&args->jobs, queue.count)) != NULL;) {
+        issue_access(&queue, issued->command);
       }
-      
-      args -> lines_read++;
-      }
-    
 
+      // the oldest command is executed in its slot, which is only freed afterwards
+      access_completed = complete_access(&queue);
+      struct Job* job = next_job(&args->jobs);
+      struct Operands* operands = &job->operands;
+      int eoc = 0;
+
+      switch (job->command) {
+        
+        case CMD_CREATE:
+          if (ems_create(operands->event_id, operands->num_rows, operands->num_cols)) {
+            write_to_file("Failed to create event\n",STDERR_FILENO);
+          }
+          break;
+
+        case CMD_RESERVE:
+          if (ems_reserve(operands->event_id, operands->num_coords, operands->xs, operands->ys)) {
+            write_to_file("Failed to reserve seats\n",STDERR_FILENO);
+          }
+          break;
+
+        case CMD_RESERVE_BEST:
+          if (ems_reserve_best(operands->event_id, operands->num_coords)) {
+            write_to_file("Failed to reserve seats\n",STDERR_FILENO);
+          }
+          break;
+
+        case CMD_CANCEL:
+          if (ems_cancel(operands->event_id, operands->reservation_id)) {
+            write_to_file("Failed to cancel reservation\n",STDERR_FILENO);
+          }
+          break;
 
-}
\ No newline at end of file
+        case CMD_SHOW:
+          if (ems_show(operands->event_id,&output)) {
+            write_to_file("Failed to show event\n",STDERR_FILENO);
+          }
+          finish_output(args->sequencer, job->sequence, &output);
+          break;
+
+        case CMD_MEMORY:
+          if (ems_memory(operands->event_id,&output)) {
+            write_to_file("Failed to report event memory\n",STDERR_FILENO);
+          }
+          finish_output(args->sequencer, job->sequence, &output);
+          break;
+
+        case CMD_AVAILABLE:
+          if (ems_available(operands->event_id,&output)) {
+            write_to_file("Failed to count free seats\n",STDERR_FILENO);
+          }
+          finish_output(args->sequencer, job->sequence, &output);
+          break;
+
+        case CMD_LIST_EVENTS:
+          if (ems_list_events(&output)) {
+            write_to_file("Failed to list events\n",STDERR_FILENO);
+          }
+          finish_output(args->sequencer, job->sequence, &output);
+          break;
+
+        case CMD_WAIT:
+          ems_wait(operands->delay);
+          break;
+
+        case CMD_BARRIER: 
+          pthread_barrier_wait(args->barrier);
+          break;
+
+        case EOC: 
+          eoc = 1;
+          break;
+
+        // handled by the dispatcher, never handed to a worker
+        case CMD_INVALID:
+        case CMD_HELP:
+        case CMD_EMPTY:
+          break;
+      }
+
+      access_completed = 0;
+      pop_job(&args->jobs);
+      if(eoc){
+        free_output(&output);
+        return NULL;
+      }
+    }
+}
@@ -4,6 +4,9 @@
 
 
 #include <stddef.h>
+#include "bytecode.h"
+#include "jobqueue.h"
+#include "output.h"
 #include "parser.h"
 
 struct FileArgs{
@@ -16,16 +19,27 @@ struct FileArgs{
 
 struct Thread{
     pthread_t id;
-    int fd_input;
-    int fd_output;
+    struct JobQueue jobs;        // commands this thread executes, handed over by the dispatcher
+    pthread_barrier_t* barrier;  // crossed together with the dispatcher and the other threads at every BARRIER
+    struct Sequencer* sequencer; // writes the output of the commands to the .out file in their order
     int thread_index;
-    int max_threads;
-    int state;
-    int lines_read;
 };
 
+/// Executes the commands handed to a thread until the end of the file.
+/// @param thread_inf The struct Thread of the calling thread.
+/// @return NULL.
 void* compute_file(void* thread_inf);
 
+/// Parses every command of a .jobs file once and hands it to the thread that executes it.
+/// @note Returns once every thread was handed the end of the file, without waiting for them.
+/// @param input Reader over the .jobs file, not used when there is a program.
+/// @param program Compiled .jobs file, NULL to parse input instead.
+/// @param workers Threads running compute_file.
+/// @param max_threads Number of threads.
+/// @param barrier Barrier of the threads and the caller.
+void dispatch_file(struct Reader* input, const struct Program* program, struct Thread** workers, int max_threads,
+                   pthread_barrier_t* barrier);
+
 void write_to_file(const char *message,const int output_fd);
 
 char* parse_file_name( char *fileName);
@@ -53,18 +67,45 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
 
+/// Reserves the first num_seats adjacent free seats in a row of the given event.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of adjacent seats to reserve.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats);
+
+/// Cancels a reservation, freeing its seats.
+/// @note Only the seats of the reservation are touched, they are found through the event's reverse index.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id of the reservation to cancel.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
 /// Prints the given event.
 /// @param event_id Id of the event to print.
+/// @param output Output the event is rendered to.
 /// @return 0 if the event was printed successfully, 1 otherwise.
-int ems_show(unsigned int event_id, const int output_fd);
+int ems_show(unsigned int event_id, struct Output* output);
+
+/// Prints how much memory the given event holds.
+/// @param event_id Id of the event to measure.
+/// @param output Output the memory usage is rendered to.
+/// @return 0 if the memory usage was printed successfully, 1 otherwise.
+int ems_memory(unsigned int event_id, struct Output* output);
+
+/// Prints the number of free seats of the given event and of each of its rows.
+/// @param event_id Id of the event to count.
+/// @param output Output the counts are rendered to.
+/// @return 0 if the counts were printed successfully, 1 otherwise.
+int ems_available(unsigned int event_id, struct Output* output);
 
 /// Prints all the events.
+/// @param output Output the events are rendered to.
 /// @return 0 if the events were printed successfully, 1 otherwise.
-int ems_list_events(const int output_fd);
+int ems_list_events(struct Output* output);
 
 /// Waits for a given amount of time.
-/// @param delay_us Delay in milliseconds.
-void ems_wait(unsigned int thread_id);
+/// @param delay_ms Delay in milliseconds.
+void ems_wait(unsigned int delay_ms);
 
 
 
@@ -0,0 +1,221 @@
+#include "output.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUTPUT_INITIAL_CAPACITY 4096
+
+void init_output(struct Output* output) {
+  output->data = NULL;
+  output->len = 0;
+  output->capacity = 0;
+  output->failed = 0;
+}
+
+void free_output(struct Output* output) {
+  free(output->data);
+  init_output(output);
+}
+
+void reset_output(struct Output* output) {
+  output->len = 0;
+  output->failed = 0;
+}
+
+char* output_space(struct Output* output, size_t n) {
+  if (output->failed) return NULL;
+
+  if (output->len + n > output->capacity) {
+    size_t capacity = output->capacity > 0 ? output->capacity : OUTPUT_INITIAL_CAPACITY;
+    while (capacity < output->len + n) {
+      capacity *= 2;
+    }
+
+    char* data = realloc(output->data, capacity);
+    if (data == NULL) {
+      output->failed = 1;
+      return NULL;
+    }
+    output->data = data;
+    output->capacity = capacity;
+  }
+  return output->data + output->len;
+}
+
+void output_commit_space(struct Output* output, size_t n) { output->len += n; }
+
+void output_write(struct Output* output, const char* bytes, size_t n) {
+  char* space = output_space(output, n);
+  if (space == NULL) return;
+
+  memcpy(space, bytes, n);
+  output->len += n;
+}
+
+void output_print(struct Output* output, const char* message) { output_write(output, message, strlen(message)); }
+
+#define UINT_TEXT_SIZE 10  // digits of the largest unsigned int
+
+// "00" to "99", so two digits take one division and one copy
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354"
+    "555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+#define FREE_SEATS_8 "0 0 0 0 0 0 0 0 "
+#define FREE_SEATS_64 FREE_SEATS_8 FREE_SEATS_8 FREE_SEATS_8 FREE_SEATS_8 FREE_SEATS_8 FREE_SEATS_8 FREE_SEATS_8 FREE_SEATS_8
+
+// a run of free seats, each with the space after it
+static const char free_seats[] = FREE_SEATS_64 FREE_SEATS_64;
+
+// formats a value at p, returning the end of its digits
+static char* format_uint(char* p, unsigned int value) {
+  char digits[UINT_TEXT_SIZE];
+  char* first = digits + UINT_TEXT_SIZE;
+
+  while (value >= 100) {
+    unsigned int pair = value % 100;
+    value /= 100;
+    first -= 2;
+    memcpy(first, digit_pairs + pair * 2, 2);
+  }
+  if (value >= 10) {
+    first -= 2;
+    memcpy(first, digit_pairs + value * 2, 2);
+  } else {
+    *--first = (char)('0' + value);
+  }
+
+  size_t len = (size_t)(digits + UINT_TEXT_SIZE - first);
+  memcpy(p, first, len);
+  return p + len;
+}
+
+// copies n free seats at p, returning the end of them
+static char* put_free_seats(char* p, size_t n) {
+  for (size_t bytes = n * 2; bytes > 0;) {
+    size_t chunk = bytes < sizeof(free_seats) - 1 ? bytes : sizeof(free_seats) - 1;
+    memcpy(p, free_seats, chunk);
+    p += chunk;
+    bytes -= chunk;
+  }
+  return p;
+}
+
+void output_seats(struct Output* output, const unsigned int* seats, size_t n) {
+  // every seat takes at most its digits and a space
+  char* start = output_space(output, n * (UINT_TEXT_SIZE + 1));
+  if (start == NULL) return;
+
+  char* p = start;
+  size_t i = 0;
+  while (i < n) {
+    if (seats[i] != 0) {
+      p = format_uint(p, seats[i++]);
+      *p++ = ' ';
+      continue;
+    }
+
+    size_t run = 1;
+    while (i + run < n && seats[i + run] == 0) {
+      run++;
+    }
+    i += run;
+    p = put_free_seats(p, run);
+  }
+  output_commit_space(output, (size_t)(p - start));
+}
+
+void output_free_seats(struct Output* output, size_t n) {
+  char* start = output_space(output, n * 2);
+  if (start == NULL) return;
+
+  output_commit_space(output, (size_t)(put_free_seats(start, n) - start));
+}
+
+void output_end_row(struct Output* output, size_t n) {
+  if (output->failed) return;
+
+  // the space after the last seat becomes the newline
+  if (n > 0) {
+    output->data[output->len - 1] = '\n';
+  } else {
+    output_write(output, "\n", 1);
+  }
+}
+
+int init_sequencer(struct Sequencer* sequencer, int fd) {
+  sequencer->fd = fd;
+  sequencer->next = 0;
+  sequencer->parked = NULL;
+
+  if (pthread_mutex_init(&sequencer->lock, NULL) != 0) return 1;
+
+  if (pthread_cond_init(&sequencer->turn, NULL) != 0) {
+    pthread_mutex_destroy(&sequencer->lock);
+    return 1;
+  }
+  return 0;
+}
+
+void destroy_sequencer(struct Sequencer* sequencer) {
+  pthread_cond_destroy(&sequencer->turn);
+  pthread_mutex_destroy(&sequencer->lock);
+}
+
+// writes an output whose turn it is, the lock must be held so no later output gets in before it
+static void write_output(struct Sequencer* sequencer, const struct Output* output) {
+  size_t done = 0;
+  while (done < output->len) {
+    ssize_t written = write(sequencer->fd, output->data + done, output->len - done);
+    if (written < 0 && errno == EINTR) continue;
+    if (written < 0) break;
+    done += (size_t)written;
+  }
+  sequencer->next++;
+}
+
+void commit_output(struct Sequencer* sequencer, size_t sequence, struct Output* output) {
+  pthread_mutex_lock(&sequencer->lock);
+
+  if (sequence != sequencer->next) {
+    struct ParkedOutput* parked = malloc(sizeof(struct ParkedOutput));
+
+    // without room to park it, the output waits for its turn in place
+    if (parked == NULL) {
+      while (sequence != sequencer->next) {
+        pthread_cond_wait(&sequencer->turn, &sequencer->lock);
+      }
+    } else {
+      parked->sequence = sequence;
+      parked->output = *output;
+      init_output(output);
+
+      struct ParkedOutput** slot = &sequencer->parked;
+      while (*slot != NULL && (*slot)->sequence < sequence) {
+        slot = &(*slot)->next;
+      }
+      parked->next = *slot;
+      *slot = parked;
+
+      pthread_mutex_unlock(&sequencer->lock);
+      return;
+    }
+  }
+
+  write_output(sequencer, output);
+  reset_output(output);
+
+  // the outputs that were only waiting for this one follow it
+  while (sequencer->parked != NULL && sequencer->parked->sequence == sequencer->next) {
+    struct ParkedOutput* parked = sequencer->parked;
+    sequencer->parked = parked->next;
+    write_output(sequencer, &parked->output);
+    free_output(&parked->output);
+    free(parked);
+  }
+
+  pthread_cond_broadcast(&sequencer->turn);
+  pthread_mutex_unlock(&sequencer->lock);
+}
@@ -0,0 +1,103 @@
+#ifndef EMS_OUTPUT_H
+#define EMS_OUTPUT_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Bytes a command writes to the .out file, rendered in memory and written at once when it is the command's turn
+struct Output {
+  char* data;
+  size_t len;
+  size_t capacity;
+  int failed;  // Set once the buffer could not grow, every write after that is dropped
+};
+
+// An output rendered before its turn, kept until the outputs before it are written
+struct ParkedOutput {
+  size_t sequence;
+  struct Output output;
+  struct ParkedOutput* next;
+};
+
+// Writes the outputs of the commands to the .out file in the order of the commands, whatever the order the threads
+// render them in. Every command with output is given the next sequence number when it is read and must be committed
+// exactly once, even when it has nothing to write
+struct Sequencer {
+  pthread_mutex_t lock;
+  pthread_cond_t turn;          // Broadcast whenever next moves on
+  int fd;                       // The .out file
+  size_t next;                  // Sequence number of the next output to be written
+  struct ParkedOutput* parked;  // Outputs rendered ahead of their turn, by increasing sequence number
+};
+
+/// Initializes an empty output.
+/// @param output Output to be initialized.
+void init_output(struct Output* output);
+
+/// Frees the buffer of an output.
+/// @param output Output to be freed.
+void free_output(struct Output* output);
+
+/// Empties an output, keeping its buffer.
+/// @param output Output to be emptied.
+void reset_output(struct Output* output);
+
+/// Gets room for the given number of bytes at the end of an output.
+/// @note The bytes written there are only added once output_commit_space is called.
+/// @param output Output to write to.
+/// @param n Number of bytes needed.
+/// @return Pointer to the room, NULL if the buffer could not grow.
+char* output_space(struct Output* output, size_t n);
+
+/// Adds the bytes written to the room given by output_space.
+/// @param output Output written to.
+/// @param n Number of bytes written, at most the number asked for.
+void output_commit_space(struct Output* output, size_t n);
+
+/// Adds bytes to the end of an output.
+/// @param output Output to write to.
+/// @param bytes Bytes to be added.
+/// @param n Number of bytes.
+void output_write(struct Output* output, const char* bytes, size_t n);
+
+/// Adds a string to the end of an output.
+/// @param output Output to write to.
+/// @param message String to be added, without its terminator.
+void output_print(struct Output* output, const char* message);
+
+/// Renders seats as their reservation ids, each followed by a space.
+/// @note Ids are formatted two digits at a time from a table, and runs of free seats are copied whole.
+/// @param output Output to write to.
+/// @param seats Reservation ids of the seats, 0 for a free seat.
+/// @param n Number of seats.
+void output_seats(struct Output* output, const unsigned int* seats, size_t n);
+
+/// Renders free seats, each followed by a space, without looking at any reservation id.
+/// @param output Output to write to.
+/// @param n Number of seats.
+void output_free_seats(struct Output* output, size_t n);
+
+/// Ends a row of seats rendered by output_seats and output_free_seats with a newline.
+/// @param output Output written to.
+/// @param n Number of seats in the row, a row without seats is only the newline.
+void output_end_row(struct Output* output, size_t n);
+
+/// Initializes a sequencer.
+/// @param sequencer Sequencer to be initialized.
+/// @param fd File descriptor the outputs are written to.
+/// @return 0 if the sequencer was initialized successfully, 1 otherwise.
+int init_sequencer(struct Sequencer* sequencer, int fd);
+
+/// Destroys a sequencer, once every output was committed.
+/// @param sequencer Sequencer to be destroyed.
+void destroy_sequencer(struct Sequencer* sequencer);
+
+/// Hands the output of a command to the sequencer.
+/// @note The output is written right away when it is its turn, along with any output waiting for it. Otherwise its
+/// buffer is parked until then and the output is left empty, without a buffer.
+/// @param sequencer Sequencer of the .out file.
+/// @param sequence Sequence number of the command.
+/// @param output Output of the command, empty on return.
+void commit_output(struct Sequencer* sequencer, size_t sequence, struct Output* output);
+
+#endif  // EMS_OUTPUT_H
@@ -1,35 +1,39 @@
 #include "parser.h"
 
 #include <limits.h>
-#include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "constants.h"
 
-static int read_uint(int fd, unsigned int *value, char *next) {
-  char buf[16];
-
-  int i = 0;
+static int read_uint(struct Reader *reader, unsigned int *value, char *next) {
+  // the digits are converted as they are scanned, nothing is copied out of the reader
+  unsigned long ul = 0;
+  int too_large = 0;
   while (1) {
-    if (read(fd, buf + i, 1) == 0) {
+    int ch = reader_getc(reader);
+    if (ch == -1) {
       *next = '\0';
       break;
     }
 
-    *next = buf[i];
+    *next = (char)ch;
 
-    if (buf[i] > '9' || buf[i] < '0') {
-      buf[i] = '\0';
+    if (ch > '9' || ch < '0') {
       break;
     }
 
-    i++;
+    // the remaining digits of a number that is already too large are still consumed
+    ul = ul * 10 + (unsigned long)(ch - '0');
+    if (ul > UINT_MAX) {
+      too_large = 1;
+      ul = UINT_MAX;
+    }
   }
 
-  unsigned long ul = strtoul(buf, NULL, 10);
-
-  if (ul > UINT_MAX) {
+  if (too_large) {
     return 1;
   }
 
@@ -38,121 +42,269 @@ static int read_uint(int fd, unsigned int *value, char *next) {
   return 0;
 }
 
-void cleanup(int fd) {
-  char ch;
-  while (read(fd, &ch, 1) == 1 && ch != '\n')
-    ;
+void cleanup(struct Reader *reader) { reader_skip_line(reader); }
+
+#ifdef __SSE2__
+// bitmask of the digits among the 16 bytes at p
+static unsigned int digit_mask(const char *p) {
+  __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+  __m128i above = _mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1));
+  __m128i below = _mm_cmplt_epi8(bytes, _mm_set1_epi8('9' + 1));
+  return (unsigned int)_mm_movemask_epi8(_mm_and_si128(above, below));
+}
+#endif
+
+// length of the run of digits at p, without looking at end or past it
+static size_t digit_run(const char *p, const char *end) {
+  size_t n = 0;
+#ifdef __SSE2__
+  while (end - (p + n) >= 16) {
+    unsigned int others = ~digit_mask(p + n) & 0xFFFF;
+    if (others) {
+      return n + (size_t)__builtin_ctz(others);
+    }
+    n += 16;
+  }
+#endif
+  while (p + n < end && p[n] >= '0' && p[n] <= '9') {
+    n++;
+  }
+  return n;
+}
+
+// value of the n digits at p, saturated past UINT_MAX, base is the first byte that may be read before p
+static unsigned long long digits_value(const char *p, size_t n, const char *base) {
+#ifdef __SSE2__
+  // the run is loaded right aligned, the bytes before it are masked out and every digit keeps its place value
+  if (n > 0 && n <= 16 && (size_t)(p - base) + n >= 16) {
+    static const char keep[32] = {0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+                                  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+    __m128i digits = _mm_loadu_si128((const __m128i *)(p + n - 16));
+    digits = _mm_and_si128(_mm_subs_epu8(digits, _mm_set1_epi8('0')), _mm_loadu_si128((const __m128i *)(keep + n)));
+
+    // pairs of digits, then groups of four, each step multiplying the more significant half by its place
+    __m128i zero = _mm_setzero_si128();
+    __m128i tens = _mm_set_epi16(1, 10, 1, 10, 1, 10, 1, 10);
+    __m128i pairs = _mm_packs_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(digits, zero), tens),
+                                    _mm_madd_epi16(_mm_unpackhi_epi8(digits, zero), tens));
+    __m128i groups = _mm_madd_epi16(pairs, _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100));
+
+    int group[4];
+    _mm_storeu_si128((__m128i *)group, groups);
+    return (((unsigned long long)group[0] * 10000 + (unsigned long long)group[1]) * 10000 +
+            (unsigned long long)group[2]) * 10000 + (unsigned long long)group[3];
+  }
+#else
+  (void)base;
+#endif
+  unsigned long long value = 0;
+  for (size_t i = 0; i < n; i++) {
+    value = value * 10 + (unsigned long long)(p[i] - '0');
+    if (value > UINT_MAX) {
+      value = (unsigned long long)UINT_MAX + 1;
+    }
+  }
+  return value;
 }
 
-enum Command get_next(int fd) {
+// parses the coordinate list of a RESERVE in place, from '[' up to the newline after ']'. Only a valid list that is
+// fully in view is consumed, anything else is left to the byte by byte parser so errors are reported the same way
+static size_t scan_coordinates(struct Reader *reader, size_t max, size_t *xs, size_t *ys) {
+  size_t avail;
+  const char *start = reader_span(reader, &avail);
+  const char *end = start + avail;
+  const char *p = start;
+
+  if (p == end || *p++ != '[') {
+    return 0;
+  }
+
+  size_t num_coords = 0;
+  while (num_coords < max) {
+    if (p == end || *p++ != '(') {
+      return 0;
+    }
+
+    size_t n = digit_run(p, end);
+    unsigned long long x = digits_value(p, n, reader->data);
+    if (p + n == end || p[n] != ',' || x > UINT_MAX) {
+      return 0;
+    }
+    p += n + 1;
+
+    n = digit_run(p, end);
+    unsigned long long y = digits_value(p, n, reader->data);
+    if (p + n == end || p[n] != ')' || y > UINT_MAX) {
+      return 0;
+    }
+    p += n + 1;
+
+    xs[num_coords] = (size_t)x;
+    ys[num_coords] = (size_t)y;
+    num_coords++;
+
+    if (p == end || (*p != ' ' && *p != ']')) {
+      return 0;
+    }
+
+    if (*p++ == ']') {
+      break;
+    }
+  }
+
+  if (num_coords == max || p == end || (*p != '\n' && *p != '\0')) {
+    return 0;
+  }
+
+  reader_consume(reader, (size_t)(p + 1 - start));
+  return num_coords;
+}
+
+enum Command get_next(struct Reader *reader) {
   char buf[16];
-  if (read(fd, buf, 1) != 1) {
+  int first = reader_getc(reader);
+  if (first == -1) {
     return EOC;
   }
+  buf[0] = (char)first;
 
   switch (buf[0]) {
     case 'C':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "CREATE ", 7) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 6) != 6) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      return CMD_CREATE;
+      if (strncmp(buf, "CREATE ", 7) == 0) {
+        return CMD_CREATE;
+      }
+
+      if (strncmp(buf, "CANCEL ", 7) != 0) {
+        cleanup(reader);
+        return CMD_INVALID;
+      }
+
+      return CMD_CANCEL;
 
     case 'R':
-      if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE ", 8) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 7) != 7 || strncmp(buf, "RESERVE", 7) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      return CMD_RESERVE;
+      if (buf[7] == ' ') {
+        return CMD_RESERVE;
+      }
+
+      if (buf[7] != '_' || reader_read(reader, buf + 8, 5) != 5 || strncmp(buf, "RESERVE_BEST ", 13) != 0) {
+        cleanup(reader);
+        return CMD_INVALID;
+      }
+
+      return CMD_RESERVE_BEST;
 
     case 'S':
-      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_SHOW;
 
     case 'L':
-      if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      if (read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
-        cleanup(fd);
+      if (reader_read(reader, buf + 4, 1) != 0 && buf[4] != '\n') {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_LIST_EVENTS;
 
+    case 'M':
+      if (reader_read(reader, buf + 1, 6) != 6 || strncmp(buf, "MEMORY ", 7) != 0) {
+        cleanup(reader);
+        return CMD_INVALID;
+      }
+
+      return CMD_MEMORY;
+
+    case 'A':
+      if (reader_read(reader, buf + 1, 9) != 9 || strncmp(buf, "AVAILABLE ", 10) != 0) {
+        cleanup(reader);
+        return CMD_INVALID;
+      }
+
+      return CMD_AVAILABLE;
+
     case 'B':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "BARRIER", 7) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 6) != 6 || strncmp(buf, "BARRIER", 7) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      if (read(fd, buf + 7, 1) != 0 && buf[7] != '\n') {
-        cleanup(fd);
+      if (reader_read(reader, buf + 7, 1) != 0 && buf[7] != '\n') {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_BARRIER;
 
     case 'W':
-      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "WAIT ", 5) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 4) != 4 || strncmp(buf, "WAIT ", 5) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_WAIT;
 
     case 'H':
-      if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "HELP", 4) != 0) {
-        cleanup(fd);
+      if (reader_read(reader, buf + 1, 3) != 3 || strncmp(buf, "HELP", 4) != 0) {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
-      if (read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
-        cleanup(fd);
+      if (reader_read(reader, buf + 4, 1) != 0 && buf[4] != '\n') {
+        cleanup(reader);
         return CMD_INVALID;
       }
 
       return CMD_HELP;
 
     case '#':
-      cleanup(fd);
+      cleanup(reader);
       return CMD_EMPTY;
 
     case '\n':
       return CMD_EMPTY;
 
     default:
-      cleanup(fd);
+      cleanup(reader);
       return CMD_INVALID;
   }
 }
 
-int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols) {
+int parse_create(struct Reader *reader, unsigned int *event_id, size_t *num_rows, size_t *num_cols) {
   char ch;
 
-  if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
-    cleanup(fd);
+  if (read_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
     return 1;
   }
 
   unsigned int u_num_rows;
-  if (read_uint(fd, &u_num_rows, &ch) != 0 || ch != ' ') {
-    cleanup(fd);
+  if (read_uint(reader, &u_num_rows, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
     return 1;
   }
   *num_rows = (size_t)u_num_rows;
 
   unsigned int u_num_cols;
-  if (read_uint(fd, &u_num_cols, &ch) != 0 || (ch != '\n' && ch != '\0')) {
-    cleanup(fd);
+  if (read_uint(reader, &u_num_cols, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
     return 1;
   }
   *num_cols = (size_t)u_num_cols;
@@ -160,44 +312,49 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
   return 0;
 }
 
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+size_t parse_reserve(struct Reader *reader, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
   char ch;
 
-  if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
-    cleanup(fd);
+  if (read_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
     return 0;
   }
 
-  if (read(fd, &ch, 1) != 1 || ch != '[') {
-    cleanup(fd);
+  size_t scanned = scan_coordinates(reader, max, xs, ys);
+  if (scanned > 0) {
+    return scanned;
+  }
+
+  if (reader_read(reader, &ch, 1) != 1 || ch != '[') {
+    cleanup(reader);
     return 0;
   }
 
   size_t num_coords = 0;
   while (num_coords < max) {
-    if (read(fd, &ch, 1) != 1 || ch != '(') {
-      cleanup(fd);
+    if (reader_read(reader, &ch, 1) != 1 || ch != '(') {
+      cleanup(reader);
       return 0;
     }
 
     unsigned int x;
-    if (read_uint(fd, &x, &ch) != 0 || ch != ',') {
-      cleanup(fd);
+    if (read_uint(reader, &x, &ch) != 0 || ch != ',') {
+      cleanup(reader);
       return 0;
     }
     xs[num_coords] = (size_t)x;
 
     unsigned int y;
-    if (read_uint(fd, &y, &ch) != 0 || ch != ')') {
-      cleanup(fd);
+    if (read_uint(reader, &y, &ch) != 0 || ch != ')') {
+      cleanup(reader);
       return 0;
     }
     ys[num_coords] = (size_t)y;
 
     num_coords++;
 
-    if (read(fd, &ch, 1) != 1 || (ch != ' ' && ch != ']')) {
-      cleanup(fd);
+    if (reader_read(reader, &ch, 1) != 1 || (ch != ' ' && ch != ']')) {
+      cleanup(reader);
       return 0;
     }
 
@@ -207,47 +364,81 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
   }
 
   if (num_coords == max) {
-    cleanup(fd);
+    cleanup(reader);
     return 0;
   }
 
-  if (read(fd, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
-    cleanup(fd);
+  if (reader_read(reader, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
     return 0;
   }
 
   return num_coords;
 }
 
-int parse_show(int fd, unsigned int *event_id) {
+int parse_reserve_best(struct Reader *reader, unsigned int *event_id, size_t *num_seats) {
+  char ch;
+
+  if (read_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 1;
+  }
+
+  unsigned int u_num_seats;
+  if (read_uint(reader, &u_num_seats, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
+    return 1;
+  }
+  *num_seats = (size_t)u_num_seats;
+
+  return 0;
+}
+
+int parse_cancel(struct Reader *reader, unsigned int *event_id, unsigned int *reservation_id) {
+  char ch;
+
+  if (read_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 1;
+  }
+
+  if (read_uint(reader, reservation_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
+    return 1;
+  }
+
+  return 0;
+}
+
+int parse_show(struct Reader *reader, unsigned int *event_id) {
   char ch;
 
-  if (read_uint(fd, event_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
-    cleanup(fd);
+  if (read_uint(reader, event_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
     return 1;
   }
 
   return 0;
 }
 
-int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
+int parse_wait(struct Reader *reader, unsigned int *delay, unsigned int *thread_id) {
   char ch;
 
-  if (read_uint(fd, delay, &ch) != 0) {
-    cleanup(fd);
+  if (read_uint(reader, delay, &ch) != 0) {
+    cleanup(reader);
     return -1;
   }
 
   if (ch == ' ') {
 
     if (thread_id == NULL) {
-      cleanup(fd);
+      cleanup(reader);
       return 0;
     }
 
 
-    if (read_uint(fd, thread_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
-      cleanup(fd);
+    if (read_uint(reader, thread_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+      cleanup(reader);
       return -1;
     }
 
@@ -255,7 +446,59 @@ int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
   } else if (ch == '\n' || ch == '\0') {
     return 0;
   } else {
-    cleanup(fd);
+    cleanup(reader);
     return -1;
   }
 }
+
+enum Command parse_command(struct Reader *reader, struct Operands *operands) {
+  enum Command command = get_next(reader);
+  operands->valid = 1;
+
+  switch (command) {
+    case CMD_CREATE:
+      operands->valid = parse_create(reader, &operands->event_id, &operands->num_rows, &operands->num_cols) == 0;
+      break;
+
+    case CMD_RESERVE:
+      operands->num_coords = parse_reserve(reader, MAX_RESERVATION_SIZE, &operands->event_id, operands->xs, operands->ys);
+      operands->valid = operands->num_coords > 0;
+      break;
+
+    case CMD_RESERVE_BEST:
+      operands->valid = parse_reserve_best(reader, &operands->event_id, &operands->num_coords) == 0;
+      break;
+
+    case CMD_CANCEL:
+      operands->valid = parse_cancel(reader, &operands->event_id, &operands->reservation_id) == 0;
+      break;
+
+    // MEMORY and AVAILABLE take the same argument as SHOW
+    case CMD_SHOW:
+    case CMD_MEMORY:
+    case CMD_AVAILABLE:
+      operands->valid = parse_show(reader, &operands->event_id) == 0;
+      break;
+
+    case CMD_WAIT: {
+      // the arguments are only kept once the whole line is known to be valid
+      unsigned int delay, thread_id = 0;
+      operands->valid = parse_wait(reader, &delay, &thread_id) != -1;
+      if (operands->valid) {
+        operands->delay = delay;
+        operands->thread_id = thread_id;
+      }
+      break;
+    }
+
+    case CMD_LIST_EVENTS:
+    case CMD_BARRIER:
+    case CMD_HELP:
+    case CMD_EMPTY:
+    case CMD_INVALID:
+    case EOC:
+      break;
+  }
+
+  return command;
+}
@@ -3,11 +3,18 @@
 
 #include <stddef.h>
 
+#include "constants.h"
+#include "reader.h"
+
 enum Command {
   CMD_CREATE,
   CMD_RESERVE,
+  CMD_RESERVE_BEST,
+  CMD_CANCEL,
   CMD_SHOW,
   CMD_LIST_EVENTS,
+  CMD_MEMORY,
+  CMD_AVAILABLE,
   CMD_BARRIER,
   CMD_WAIT,
   CMD_HELP,
@@ -16,41 +23,76 @@ enum Command {
   EOC  // End of commands
 };
 
+// Arguments of a command, as parse_command leaves them
+struct Operands {
+  int valid;  // Whether the arguments of the command were parsed
+  unsigned int event_id;
+  unsigned int reservation_id;
+  size_t num_rows;
+  size_t num_cols;
+  size_t num_coords;  // Coordinates of a RESERVE, or seats of a RESERVE_BEST
+  size_t xs[MAX_RESERVATION_SIZE];
+  size_t ys[MAX_RESERVATION_SIZE];
+  unsigned int delay;      // Delay of the last valid WAIT
+  unsigned int thread_id;  // Thread of the last valid WAIT, 0 if it named none
+};
+
 /// Reads a line and returns the corresponding command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the file to read from.
 /// @return The command read.
-enum Command get_next(int fd);
+enum Command get_next(struct Reader *reader);
 
 /// Parses a CREATE command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the file to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @param num_rows Pointer to the variable to store the number of rows in.
 /// @param num_cols Pointer to the variable to store the number of columns in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
-int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
+int parse_create(struct Reader *reader, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
 
 /// Parses a RESERVE command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the file to read from.
 /// @param max Maximum number of coordinates to read.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @param xs Pointer to the array to store the X coordinates in.
 /// @param ys Pointer to the array to store the Y coordinates in.
 /// @return Number of coordinates read. 0 on failure.
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
+size_t parse_reserve(struct Reader *reader, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
+
+/// Parses a RESERVE_BEST command.
+/// @param reader Reader over the file to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param num_seats Pointer to the variable to store the number of adjacent seats in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_reserve_best(struct Reader *reader, unsigned int *event_id, size_t *num_seats);
+
+/// Parses a CANCEL command.
+/// @param reader Reader over the file to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param reservation_id Pointer to the variable to store the reservation ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_cancel(struct Reader *reader, unsigned int *event_id, unsigned int *reservation_id);
 
 /// Parses a SHOW command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the file to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
-int parse_show(int fd, unsigned int *event_id);
+int parse_show(struct Reader *reader, unsigned int *event_id);
 
 /// Parses a WAIT command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the file to read from.
 /// @param delay Pointer to the variable to store the wait delay in.
 /// @param thread_id Pointer to the variable to store the thread ID in. May not be set.
 /// @return 0 if no thread was specified, 1 if a thread was specified, -1 on error.
-int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id);
+int parse_wait(struct Reader *reader, unsigned int *delay, unsigned int *thread_id);
+
+/// Reads a line and parses the arguments of its command.
+/// @note An invalid WAIT leaves the delay and thread of the previous one untouched.
+/// @param reader Reader over the file to read from.
+/// @param operands Receives the arguments, valid is cleared if they could not be parsed.
+/// @return The command read.
+enum Command parse_command(struct Reader *reader, struct Operands *operands);
 
-void cleanup(int fd);
+void cleanup(struct Reader *reader);
 
 #endif  // EMS_PARSER_H
@@ -0,0 +1,109 @@
+#include "reader.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct Reader* create_reader(int fd) {
+  struct Reader* reader = (struct Reader*)malloc(sizeof(struct Reader) + READER_BUFFER_SIZE);
+  if (!reader) return NULL;
+
+  reader->fd = fd;
+  reader->data = reader->buffer;
+  reader->pos = 0;
+  reader->len = 0;
+  reader->eof = 0;
+  reader->mapped = 0;
+  return reader;
+}
+
+struct Reader* create_mapped_reader(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return NULL;
+
+  struct Reader* reader = (struct Reader*)malloc(sizeof(struct Reader));
+  if (!reader) return NULL;
+
+  reader->fd = fd;
+  reader->data = NULL;
+  reader->pos = 0;
+  reader->len = (size_t)st.st_size;
+  reader->eof = 1;
+  reader->mapped = reader->len > 0;
+
+  // an empty file can not be mapped, it is simply a reader with nothing left
+  if (reader->mapped) {
+    void* data = mmap(NULL, reader->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      free(reader);
+      return NULL;
+    }
+    posix_madvise(data, reader->len, POSIX_MADV_SEQUENTIAL);
+    reader->data = (char*)data;
+  }
+  return reader;
+}
+
+void free_reader(struct Reader* reader) {
+  if (reader && reader->mapped) munmap(reader->data, reader->len);
+  free(reader);
+}
+
+size_t reader_fill(struct Reader* reader) {
+  if (reader->pos < reader->len) return reader->len - reader->pos;
+  if (reader->eof) return 0;
+
+  ssize_t read_bytes;
+  do {
+    read_bytes = read(reader->fd, reader->buffer, READER_BUFFER_SIZE);
+  } while (read_bytes == -1 && errno == EINTR);
+
+  // an error ends the input like the end of the file does
+  reader->pos = 0;
+  reader->len = read_bytes > 0 ? (size_t)read_bytes : 0;
+  if (read_bytes <= 0) reader->eof = 1;
+  return reader->len;
+}
+
+int reader_peek(struct Reader* reader) {
+  if (reader->pos == reader->len && reader_fill(reader) == 0) return -1;
+  return (unsigned char)reader->data[reader->pos];
+}
+
+int reader_getc(struct Reader* reader) {
+  if (reader->pos == reader->len && reader_fill(reader) == 0) return -1;
+  return (unsigned char)reader->data[reader->pos++];
+}
+
+size_t reader_read(struct Reader* reader, char* buf, size_t n) {
+  size_t copied = 0;
+  while (copied < n && reader_fill(reader) > 0) {
+    size_t chunk = reader->len - reader->pos;
+    if (chunk > n - copied) chunk = n - copied;
+    memcpy(buf + copied, reader->data + reader->pos, chunk);
+    reader->pos += chunk;
+    copied += chunk;
+  }
+  return copied;
+}
+
+const char* reader_span(struct Reader* reader, size_t* n) {
+  *n = reader_fill(reader);
+  return reader->data + reader->pos;
+}
+
+void reader_consume(struct Reader* reader, size_t n) { reader->pos += n; }
+
+void reader_skip_line(struct Reader* reader) {
+  while (reader_fill(reader) > 0) {
+    char* newline = memchr(reader->data + reader->pos, '\n', reader->len - reader->pos);
+    if (newline) {
+      reader->pos = (size_t)(newline - reader->data) + 1;
+      return;
+    }
+    reader->pos = reader->len;
+  }
+}
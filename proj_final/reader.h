@@ -0,0 +1,72 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stddef.h>
+
+#define READER_BUFFER_SIZE 65536  // Bytes read from the file at once
+
+// Buffered reader over a file descriptor, so parsing a command costs no system call per character. A mapped
+// reader scans the whole file in place instead, without ever calling read
+struct Reader {
+  int fd;
+  char* data;  // Bytes being scanned, either the buffer or the mapped file
+  size_t pos;  // Next byte to be consumed
+  size_t len;  // Number of valid bytes in data
+  int eof;     // Set once the file has no bytes left to be read into the buffer
+  int mapped;  // Whether data is a mapping of the whole file
+  char buffer[];
+};
+
+/// Creates a reader over a file descriptor.
+/// @param fd File descriptor to read from, still owned by the caller.
+/// @return Newly created reader, NULL on failure.
+struct Reader* create_reader(int fd);
+
+/// Creates a reader that maps the whole file and scans it in place.
+/// @note Only works for regular files, the file must not shrink while it is mapped.
+/// @param fd File descriptor of the file to map, still owned by the caller.
+/// @return Newly created reader, NULL if the file can not be mapped.
+struct Reader* create_mapped_reader(int fd);
+
+/// Frees a reader, unmapping its file, without closing its file descriptor.
+/// @param reader Reader to be freed.
+void free_reader(struct Reader* reader);
+
+/// Refills the buffer once every byte in it was consumed.
+/// @param reader Reader to be refilled.
+/// @return Number of bytes ready to be consumed, 0 at the end of the file or on error.
+size_t reader_fill(struct Reader* reader);
+
+/// Gets the next byte without consuming it.
+/// @param reader Reader to get the byte from.
+/// @return The byte, -1 at the end of the file.
+int reader_peek(struct Reader* reader);
+
+/// Consumes the next byte.
+/// @param reader Reader to get the byte from.
+/// @return The byte, -1 at the end of the file.
+int reader_getc(struct Reader* reader);
+
+/// Consumes up to n bytes, like read but refilling the buffer as many times as needed.
+/// @param reader Reader to get the bytes from.
+/// @param buf Buffer to store the bytes in.
+/// @param n Number of bytes to get.
+/// @return Number of bytes stored, less than n only at the end of the file.
+size_t reader_read(struct Reader* reader, char* buf, size_t n);
+
+/// Gets the bytes ready to be consumed without consuming them, refilling the buffer if it is empty.
+/// @param reader Reader to get the bytes from.
+/// @param n Receives the number of bytes ready, 0 at the end of the file.
+/// @return Pointer to the next byte, the bytes before it in data stay valid too.
+const char* reader_span(struct Reader* reader, size_t* n);
+
+/// Consumes bytes that were looked at through reader_span.
+/// @param reader Reader to be moved.
+/// @param n Number of bytes to consume, at most the number reader_span gave.
+void reader_consume(struct Reader* reader, size_t n);
+
+/// Moves the cursor past the next newline, or to the end of the file if there is none.
+/// @param reader Reader to be moved.
+void reader_skip_line(struct Reader* reader);
+
+#endif  // READER_H
@@ -0,0 +1,350 @@
+// differential test of the RESERVE parser: the in place scan and its SSE2 helpers are checked against the byte by byte
+// parser they sit in front of, on random and malformed lines read through both readers and across the buffer edges.
+// parser.c is included whole so its static helpers can be called directly
+#include "../parser.c"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../output.h"
+
+#define NUM_FILES 40
+#define LINES_PER_FILE 3000
+#define HELPER_ROUNDS 200000
+#define MAX_DIGITS 25  // longest number written, well past UINT_MAX
+#define MAX_PAIRS (MAX_RESERVATION_SIZE + 40)
+
+static unsigned long long random_state;
+
+// xorshift, so a failure can be replayed from the seed it prints
+static unsigned int next_random(void) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return (unsigned int)(random_state >> 32);
+}
+
+static size_t random_below(size_t n) { return (size_t)next_random() % n; }
+
+// the RESERVE parser as it was before the in place scan, the reference every result is compared with
+static size_t old_parse_reserve(struct Reader *reader, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (read_uint(reader, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(reader);
+    return 0;
+  }
+
+  if (reader_read(reader, &ch, 1) != 1 || ch != '[') {
+    cleanup(reader);
+    return 0;
+  }
+
+  size_t num_coords = 0;
+  while (num_coords < max) {
+    if (reader_read(reader, &ch, 1) != 1 || ch != '(') {
+      cleanup(reader);
+      return 0;
+    }
+
+    unsigned int x;
+    if (read_uint(reader, &x, &ch) != 0 || ch != ',') {
+      cleanup(reader);
+      return 0;
+    }
+    xs[num_coords] = (size_t)x;
+
+    unsigned int y;
+    if (read_uint(reader, &y, &ch) != 0 || ch != ')') {
+      cleanup(reader);
+      return 0;
+    }
+    ys[num_coords] = (size_t)y;
+
+    num_coords++;
+
+    if (reader_read(reader, &ch, 1) != 1 || (ch != ' ' && ch != ']')) {
+      cleanup(reader);
+      return 0;
+    }
+
+    if (ch == ']') {
+      break;
+    }
+  }
+
+  if (num_coords == max) {
+    cleanup(reader);
+    return 0;
+  }
+
+  if (reader_read(reader, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
+    cleanup(reader);
+    return 0;
+  }
+
+  return num_coords;
+}
+
+// checks digit_run and digits_value against plain loops, on runs of every length at every offset from the buffer start
+static int check_helpers(void) {
+  // bytes next to the digits, including the ones a signed compare could mistake for digits
+  static const char others[] = {'/', ':', ' ', ',', ')', ']', '\0', '\n', (char)0x80, (char)0xB0, (char)0xFF};
+  char buf[96];
+
+  for (size_t round = 0; round < HELPER_ROUNDS; round++) {
+    size_t len = random_below(sizeof(buf)) + 1;
+    size_t odds = random_below(2) ? 64 : 3;  // one in odds bytes is not a digit
+    for (size_t i = 0; i < len; i++) {
+      buf[i] = random_below(odds) == 0 ? others[random_below(sizeof(others))] : (char)('0' + random_below(10));
+    }
+
+    size_t start = random_below(len);
+    const char *end = buf + len;
+
+    size_t expected_run = 0;
+    while (start + expected_run < len && buf[start + expected_run] >= '0' && buf[start + expected_run] <= '9') {
+      expected_run++;
+    }
+
+    size_t run = digit_run(buf + start, end);
+    if (run != expected_run) {
+      fprintf(stderr, "digit_run: %zu instead of %zu at %zu of %zu bytes\n", run, expected_run, start, len);
+      return 1;
+    }
+
+    // any prefix of the run, the value only has to agree up to UINT_MAX
+    size_t n = random_below(run + 1);
+    unsigned long long expected = 0;
+    for (size_t i = 0; i < n; i++) {
+      expected = expected * 10 + (unsigned long long)(buf[start + i] - '0');
+      if (expected > UINT_MAX) expected = (unsigned long long)UINT_MAX + 1;
+    }
+
+    unsigned long long value = digits_value(buf + start, n, buf);
+    if (expected > UINT_MAX ? value <= UINT_MAX : value != expected) {
+      fprintf(stderr, "digits_value: %llu instead of %llu for %zu digits at %zu\n", value, expected, n, start);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// a number as it may show up in a RESERVE, a broken one may also overflow or have no digits at all
+static void write_number(struct Output *text, int broken) {
+  char digits[MAX_DIGITS + 1];
+  size_t n;
+
+  switch (random_below(broken ? 10 : 4)) {
+    case 0:
+      n = (size_t)snprintf(digits, sizeof(digits), "%u", next_random());
+      break;
+    case 1:
+      // leading zeros in front of a small value, longer than any value that fits
+      n = 11 + random_below(MAX_DIGITS - 10);
+      memset(digits, '0', n - 2);
+      digits[n - 2] = (char)('0' + random_below(10));
+      digits[n - 1] = (char)('0' + random_below(10));
+      break;
+    case 4:
+      n = (size_t)snprintf(digits, sizeof(digits), "%s", random_below(2) ? "4294967295" : "4294967296");
+      break;
+    case 5:
+    case 6:
+      n = 11 + random_below(MAX_DIGITS - 10);
+      for (size_t i = 0; i < n; i++) {
+        digits[i] = (char)('0' + random_below(10));
+      }
+      digits[0] = (char)('1' + random_below(9));
+      break;
+    case 7:
+      n = 0;
+      break;
+    default:
+      n = (size_t)snprintf(digits, sizeof(digits), "%zu", random_below(1000));
+      break;
+  }
+  output_write(text, digits, n);
+}
+
+// a RESERVE line, valid unless it is meant to be broken in one of the ways the parser has to reject
+static void write_reserve(struct Output *text) {
+  int broken = random_below(3) == 0;
+  output_print(text, "RESERVE ");
+  size_t arguments = text->len;
+
+  write_number(text, broken);
+  output_print(text, " [");
+
+  // mostly short lists, but also lists around MAX_RESERVATION_SIZE and past it
+  size_t num_pairs;
+  switch (random_below(8)) {
+    case 0:
+      num_pairs = MAX_RESERVATION_SIZE - 2 + random_below(4);
+      break;
+    case 1:
+      num_pairs = 1 + random_below(MAX_PAIRS);
+      break;
+    default:
+      num_pairs = 1 + random_below(12);
+      break;
+  }
+
+  for (size_t i = 0; i < num_pairs; i++) {
+    if (!broken || random_below(100) != 0) output_print(text, "(");
+    write_number(text, broken);
+    output_print(text, !broken || random_below(100) != 0 ? "," : " ");
+    write_number(text, broken);
+    if (!broken || random_below(50) != 0) output_print(text, ")");
+    if (i + 1 < num_pairs) output_print(text, !broken || random_below(100) != 0 ? " " : ",");
+  }
+
+  size_t ending = random_below(8);
+  if (ending == 0) {
+    output_write(text, "]\0", 2);  // a '\0' ends the line as well
+  } else if (broken && ending == 1) {
+    output_print(text, "\n");  // missing ']'
+  } else if (broken && ending == 2) {
+    output_print(text, "] x\n");
+  } else {
+    output_print(text, "]\n");
+  }
+
+  if (!broken || text->failed) return;
+
+  // the line is also cut short or has a byte replaced, anywhere after the command
+  size_t len = text->len - arguments;
+  switch (random_below(4)) {
+    case 0:
+      text->len = arguments + random_below(len);
+      output_print(text, "\n");
+      break;
+    case 1:
+      text->data[arguments + random_below(len)] = "0123456789()[], x\n"[random_below(18)];
+      break;
+    default:
+      break;
+  }
+}
+
+// a comment that ends the given number of bytes before the next buffer edge, so the line after it crosses the edge
+static void write_padding(struct Output *text, size_t before_edge) {
+  size_t edge = (text->len / READER_BUFFER_SIZE + 1) * READER_BUFFER_SIZE;
+  if (edge - text->len <= before_edge) return;
+
+  size_t n = edge - text->len - before_edge;
+  if (n == 1) {
+    output_print(text, "\n");
+    return;
+  }
+  char *space = output_space(text, n);
+  if (space == NULL) return;
+  space[0] = '#';
+  memset(space + 1, 'x', n - 2);
+  space[n - 1] = '\n';
+  output_commit_space(text, n);
+}
+
+static int write_file(const char *path, const struct Output *text) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) return 1;
+
+  size_t done = 0;
+  while (done < text->len) {
+    ssize_t written = write(fd, text->data + done, text->len - done);
+    if (written <= 0) {
+      close(fd);
+      return 1;
+    }
+    done += (size_t)written;
+  }
+  return close(fd);
+}
+
+// parses the file with the old parser and with the new one through both readers, in step, command by command
+static int compare_file(const char *path, size_t file) {
+  int fds[3];
+  struct Reader *readers[3];
+  for (size_t r = 0; r < 3; r++) {
+    fds[r] = open(path, O_RDONLY);
+    if (fds[r] < 0) return 1;
+    readers[r] = r == 2 ? create_mapped_reader(fds[r]) : create_reader(fds[r]);
+    if (readers[r] == NULL) return 1;
+  }
+  static const char *names[3] = {"old", "buffered", "mapped"};
+
+  static size_t xs[3][MAX_RESERVATION_SIZE], ys[3][MAX_RESERVATION_SIZE];
+  int status = 0;
+  for (size_t command = 1; status == 0; command++) {
+    enum Command expected = get_next(readers[0]);
+    for (size_t r = 1; r < 3; r++) {
+      if (get_next(readers[r]) != expected) {
+        fprintf(stderr, "file %zu, command %zu: %s reader reads another command\n", file, command, names[r]);
+        status = 1;
+      }
+    }
+    if (status != 0 || expected == EOC) break;
+    if (expected != CMD_RESERVE) continue;
+
+    unsigned int event_ids[3] = {0, 0, 0};
+    size_t num_coords = old_parse_reserve(readers[0], MAX_RESERVATION_SIZE, &event_ids[0], xs[0], ys[0]);
+    for (size_t r = 1; r < 3; r++) {
+      size_t n = parse_reserve(readers[r], MAX_RESERVATION_SIZE, &event_ids[r], xs[r], ys[r]);
+      if (n != num_coords) {
+        fprintf(stderr, "file %zu, command %zu: %s parser read %zu coordinates instead of %zu\n", file, command,
+                names[r], n, num_coords);
+        status = 1;
+      } else if (n > 0 && (event_ids[r] != event_ids[0] || memcmp(xs[r], xs[0], n * sizeof(size_t)) != 0 ||
+                           memcmp(ys[r], ys[0], n * sizeof(size_t)) != 0)) {
+        fprintf(stderr, "file %zu, command %zu: %s parser read other values\n", file, command, names[r]);
+        status = 1;
+      }
+    }
+  }
+
+  for (size_t r = 0; r < 3; r++) {
+    free_reader(readers[r]);
+    close(fds[r]);
+  }
+  return status;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned long long seed = argc > 1 ? strtoull(argv[1], NULL, 0) : 0x2545F4914F6CDD1DULL;
+  random_state = seed != 0 ? seed : 1;
+
+  if (check_helpers() != 0) {
+    fprintf(stderr, "seed %llu\n", seed);
+    return 1;
+  }
+
+  char path[] = "/tmp/parser_diff_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) return 1;
+  close(fd);
+
+  struct Output text;
+  init_output(&text);
+
+  int status = 0;
+  for (size_t file = 0; file < NUM_FILES && status == 0; file++) {
+    reset_output(&text);
+    for (size_t line = 0; line < LINES_PER_FILE && !text.failed; line++) {
+      if (random_below(16) == 0) write_padding(&text, random_below(MAX_DIGITS + 16));
+      if (random_below(32) == 0) output_print(&text, random_below(2) ? "\n" : "# comment\n");
+      write_reserve(&text);
+    }
+
+    // the last line may end the file without a newline
+    if (!text.failed && random_below(2) && text.len > 0 && text.data[text.len - 1] == '\n') text.len--;
+
+    status = text.failed || write_file(path, &text) != 0 || compare_file(path, file) != 0;
+  }
+
+  if (status != 0) fprintf(stderr, "seed %llu\n", seed);
+  free_output(&text);
+  unlink(path);
+  return status;
+}